@@ -47,6 +47,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/subsurfacestartup.c \
 	core/pref.c \
 	core/profile.c \
+	core/plotinfocache.cpp \
 	core/device.cpp \
 	core/dive.c \
 	core/divecomputer.c \
@@ -89,6 +90,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/membuffer.c \
 	core/selection.cpp \
 	core/sha1.c \
+	core/snapshot.c \
 	core/string-format.cpp \
 	core/strtod.c \
 	core/tag.c \
@@ -103,6 +105,7 @@ SOURCES += subsurface-mobile-main.cpp \
 	core/uploadDiveShare.cpp \
 	core/uploadDiveLogsDE.cpp \
 	core/save-profiledata.c \
+	core/xmlfields.cpp \
 	core/xmlparams.cpp \
 	core/settings/qPref.cpp \
 	core/settings/qPrefCloudStorage.cpp \
@@ -208,6 +211,7 @@ HEADERS += \
 	core/gpslocation.h \
 	core/pref.h \
 	core/profile.h \
+	core/plotinfocache.h \
 	core/qthelper.h \
 	core/save-html.h \
 	core/statistics.h \
@@ -242,6 +246,7 @@ HEADERS += \
 	core/sample.h \
 	core/selection.h \
 	core/sha1.h \
+	core/snapshot.h \
 	core/strndup.h \
 	core/string-format.h \
 	core/subsurfacestartup.h \
@@ -259,6 +264,7 @@ HEADERS += \
 	core/save-profiledata.h \
 	core/uploadDiveShare.h \
 	core/uploadDiveLogsDE.h \
+	core/xmlfields.h \
 	core/xmlparams.h \
 	core/settings/qPref.h \
 	core/settings/qPrefCloudStorage.h \
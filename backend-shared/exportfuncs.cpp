@@ -4,6 +4,7 @@
 #include <QtConcurrent>
 #include "core/membuffer.h"
 #include "core/dive.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/gettextfromc.h"
 #include "core/tag.h"
@@ -14,7 +15,6 @@
 #include "core/divesite.h"
 #include "core/picture.h"
 #include "core/pref.h"
-#include "core/sample.h"
 #include "core/selection.h"
 #include "exportfuncs.h"
 
@@ -271,14 +271,10 @@ void export_depths(const char *filename, bool selected_only)
 		if (selected_only && !dive->selected)
 			continue;
 
+		if (dive->pictures.nr)
+			load_dive_samples(dive);
 		FOR_EACH_PICTURE (dive) {
-			int n = dive->dc.samples;
-			struct sample *s = dive->dc.sample;
-			depth.mm = 0;
-			while (--n >= 0 && (int32_t)s->time.seconds <= picture->offset.seconds) {
-				depth.mm = s->depth.mm;
-				s++;
-			}
+			depth.mm = picture->offset.seconds >= 0 ? get_depth_at_time(&dive->dc, picture->offset.seconds) : 0;
 			put_format(&buf, "%s\t%.1f", picture->filename, get_depth_units(depth.mm, NULL, &unit));
 			put_format(&buf, "%s\n", unit);
 		}
@@ -333,5 +329,7 @@ std::vector<const dive_site *> getDiveSitesToExport(bool selectedOnly)
 QFuture<int> exportUsingStyleSheet(QString filename, bool doExport, int units,
 	QString stylesheet, bool anonymize)
 {
+	// The samples can't be loaded from git in the worker thread
+	load_all_dive_samples(doExport);
 	return QtConcurrent::run(export_dives_xslt, filename.toUtf8(), doExport, units, stylesheet.toUtf8(), anonymize);
 }
@@ -78,9 +78,8 @@ dive *DiveListBase::addDive(DiveToAdd &d)
 	// dives have been added, their status will be updated.
 	res->hidden_by_filter = true;
 
-	int idx = dive_table_get_insertion_index(&dive_table, res);
 	fulltext_register(res);				// Register the dive's fulltext cache
-	add_to_dive_table(&dive_table, idx, res);	// Return ownership to backend
+	insert_dive(&dive_table, res);			// Return ownership to backend
 	invalidate_dive_cache(res);		// Ensure that dive is written in git_save()
 
 	return res;
@@ -872,10 +871,11 @@ void SplitDivesBase::undoit()
 	setSelection(diveToSplit.dives, diveToSplit.dives[0] );
 }
 
-static std::array<dive *, 2> doSplitDives(const dive *d, duration_t time)
+static std::array<dive *, 2> doSplitDives(dive *d, duration_t time)
 {
 	// Split the dive
 	dive *new1, *new2;
+	unpack_dive_samples(d);
 	if (time.seconds < 0)
 		split_dive(d, &new1, &new2);
 	else
@@ -980,6 +980,9 @@ MergeDives::MergeDives(const QVector <dive *> &dives)
 		return;
 	}
 
+	for (dive *d: dives)
+		unpack_dive_samples(d);
+
 	dive_trip *preferred_trip;
 	dive_site *preferred_site;
 	OwningDivePtr d(merge_dives(dives[0], dives[1], dives[1]->when - dives[0]->when, false, &preferred_trip, &preferred_site));
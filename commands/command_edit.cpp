@@ -305,7 +305,7 @@ void EditDuration::set(struct dive *d, int value) const
 	d->dc.duration.seconds = value;
 	d->duration = d->dc.duration;
 	d->dc.meandepth.mm = 0;
-	d->dc.samples = 0;
+	free_samples(&d->dc);
 }
 
 int EditDuration::data(struct dive *d) const
@@ -324,7 +324,7 @@ void EditDepth::set(struct dive *d, int value) const
 	d->dc.maxdepth.mm = value;
 	d->maxdepth = d->dc.maxdepth;
 	d->dc.meandepth.mm = 0;
-	d->dc.samples = 0;
+	free_samples(&d->dc);
 }
 
 int EditDepth::data(struct dive *d) const
@@ -433,6 +433,7 @@ EditMode::EditMode(int indexIn, int newValue, bool currentDiveOnly)
 
 void EditMode::set(struct dive *d, int i) const
 {
+	load_dive_samples(d);
 	get_dive_dc(d, index)->divemode = (enum divemode_t)i;
 	update_setpoint_events(d, get_dive_dc(d, index));
 }
@@ -758,6 +759,7 @@ void PasteDives::undo()
 	for (PasteState &state: dives) {
 		divesToNotify.push_back(state.d);
 		state.swap(what);
+		fulltext_register(state.d); // Update the fulltext cache
 		invalidate_dive_cache(state.d); // Ensure that dive is written in git_save()
 	}
 
@@ -848,6 +850,7 @@ void ReplanDive::undo()
 	std::swap(d->duration, duration);
 	std::swap(d->salinity, salinity);
 	fixup_dive(d);
+	fulltext_register(d); // Update the fulltext cache
 	invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 
 	QVector<dive *> divesToNotify = { d };
@@ -885,6 +888,7 @@ void AddWeight::undo()
 		if (d->weightsystems.nr <= 0)
 			continue;
 		remove_weightsystem(d, d->weightsystems.nr - 1);
+		fulltext_register(d); // Update the fulltext cache
 		emit diveListNotifier.weightRemoved(d, d->weightsystems.nr);
 		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 	}
@@ -894,6 +898,7 @@ void AddWeight::redo()
 {
 	for (dive *d: dives) {
 		add_cloned_weightsystem(&d->weightsystems, empty_weightsystem);
+		fulltext_register(d); // Update the fulltext cache
 		emit diveListNotifier.weightAdded(d, d->weightsystems.nr - 1);
 		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 	}
@@ -966,6 +971,7 @@ void RemoveWeight::undo()
 {
 	for (size_t i = 0; i < dives.size(); ++i) {
 		add_to_weightsystem_table(&dives[i]->weightsystems, indices[i], clone_weightsystem(ws));
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.weightAdded(dives[i], indices[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -975,6 +981,7 @@ void RemoveWeight::redo()
 {
 	for (size_t i = 0; i < dives.size(); ++i) {
 		remove_weightsystem(dives[i], indices[i]);
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.weightRemoved(dives[i], indices[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -1026,6 +1033,7 @@ void EditWeight::redo()
 {
 	for (size_t i = 0; i < dives.size(); ++i) {
 		set_weightsystem(dives[i], indices[i], new_ws);
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.weightEdited(dives[i], indices[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -1069,6 +1077,7 @@ void AddCylinder::undo()
 			continue;
 		remove_cylinder(d, d->cylinders.nr - 1);
 		update_cylinder_related_info(d);
+		fulltext_register(d); // Update the fulltext cache
 		emit diveListNotifier.cylinderRemoved(d, d->cylinders.nr);
 		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 	}
@@ -1079,6 +1088,7 @@ void AddCylinder::redo()
 	for (dive *d: dives) {
 		add_cloned_cylinder(&d->cylinders, cyl);
 		update_cylinder_related_info(d);
+		fulltext_register(d); // Update the fulltext cache
 		emit diveListNotifier.cylinderAdded(d, d->cylinders.nr - 1);
 		invalidate_dive_cache(d); // Ensure that dive is written in git_save()
 	}
@@ -1178,6 +1188,7 @@ void RemoveCylinder::undo()
 		std::vector<int> mapping = get_cylinder_map_for_add(dives[i]->cylinders.nr, indexes[i]);
 		add_cylinder(&dives[i]->cylinders, indexes[i], clone_cylinder(cyl[i]));
 		update_cylinder_related_info(dives[i]);
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.cylinderAdded(dives[i], indexes[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -1187,9 +1198,11 @@ void RemoveCylinder::redo()
 {
 	for (size_t i = 0; i < dives.size(); ++i) {
 		std::vector<int> mapping = get_cylinder_map_for_remove(dives[i]->cylinders.nr, indexes[i]);
+		load_dive_samples(dives[i]); // the sensors of the samples are renumbered
 		remove_cylinder(dives[i], indexes[i]);
 		cylinder_renumber(dives[i], &mapping[0]);
 		update_cylinder_related_info(dives[i]);
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.cylinderRemoved(dives[i], indexes[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -1268,6 +1281,7 @@ void EditCylinder::redo()
 	for (size_t i = 0; i < dives.size(); ++i) {
 		std::swap(*get_cylinder(dives[i], indexes[i]), cyl[i]);
 		update_cylinder_related_info(dives[i]);
+		fulltext_register(dives[i]); // Update the fulltext cache
 		emit diveListNotifier.cylinderEdited(dives[i], indexes[i]);
 		invalidate_dive_cache(dives[i]); // Ensure that dive is written in git_save()
 	}
@@ -10,8 +10,10 @@
  *
  * add_segment()	- add <seconds> at the given pressure, breathing gasmix
  * deco_allowed_depth() - ceiling based on lead tissue, surface pressure, 3m increments or smooth
- * set_gf()		- set Buehlmann gradient factors
- * set_vpmb_conservatism() - set VPM-B conservatism value
+ * set_gf()		- set default Buehlmann gradient factors
+ * set_vpmb_conservatism() - set default VPM-B conservatism value
+ * get_deco_config()	- get the default settings for a new calculation
+ * init_deco_config()	- set up the settings for a new calculation
  * clear_deco()
  * cache_deco_state()
  * restore_deco_state()
@@ -42,8 +44,8 @@ struct buehlmann_config {
 	double satmult;			//! safety at inert gas accumulation as percentage of effect (more than 100).
 	double desatmult;		//! safety at inert gas depletion as percentage of effect (less than 100).
 	int last_deco_stop_in_mtr;	//! depth of last_deco_stop.
-	double gf_high;			//! gradient factor high (at surface).
-	double gf_low;			//! gradient factor low (at bottom/start of deco calculation).
+	double gf_high;			//! default gradient factor high (at surface).
+	double gf_low;			//! default gradient factor low (at bottom/start of deco calculation).
 	double gf_low_position_min;	//! gf_low_position below surface_min_shallow.
 };
 
@@ -155,17 +157,17 @@ static const double vpmb_conservatism_lvls[] = { 1.0, 1.05, 1.12, 1.22, 1.35 };
 
 #define TISSUE_ARRAY_SZ sizeof(ds->tissue_n2_sat)
 
-static double get_crit_radius_He()
+static double get_crit_radius_He(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->config.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_He * vpmb_conservatism_lvls[ds->config.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_He;
 }
 
-static double get_crit_radius_N2()
+static double get_crit_radius_N2(const struct deco_state *ds)
 {
-	if (vpmb_config.conservatism <= 4)
-		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[vpmb_config.conservatism] * subsurface_conservatism_factor;
+	if (ds->config.vpmb_conservatism <= 4)
+		return vpmb_config.crit_radius_N2 * vpmb_conservatism_lvls[ds->config.vpmb_conservatism] * subsurface_conservatism_factor;
 	return vpmb_config.crit_radius_N2;
 }
 
@@ -221,43 +223,55 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 {
 	int ci = -1;
 	double ret_tolerance_limit_ambient_pressure = 0.0;
-	double gf_high = buehlmann_config.gf_high;
-	double gf_low = buehlmann_config.gf_low;
+	double gf_high = ds->config.gf_high;
+	double gf_low = ds->config.gf_low;
 	double surface = get_surface_pressure_in_mbar(dive, true) / 1000.0;
 	double lowest_ceiling = 0.0;
 	double tissue_lowest_ceiling[16];
+	double tolerated_if_below[16];
+	bool below[16];
+	UNUSED(in_planner);
 
 	for (ci = 0; ci < 16; ci++) {
 		ds->buehlmann_inertgas_a[ci] = ((buehlmann_N2_a[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_a[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
 		ds->buehlmann_inertgas_b[ci] = ((buehlmann_N2_b[ci] * ds->tissue_n2_sat[ci]) + (buehlmann_He_b[ci] * ds->tissue_he_sat[ci])) / ds->tissue_inertgas_saturation[ci];
 	}
 
-	if (decoMode(in_planner) != VPMB) {
+	if (ds->config.mode != VPMB) {
+		const double *a = ds->buehlmann_inertgas_a;
+		const double *b = ds->buehlmann_inertgas_b;
+		const double *saturation = ds->tissue_inertgas_saturation;
+		double gf_low_pressure;
+
+		/* The per-compartment calculations are done in branch-free loops,
+		 * only the search for the leading compartment is sequential. */
 		for (ci = 0; ci < 16; ci++) {
 
 			/* tolerated = (tissue_inertgas_saturation - buehlmann_inertgas_a) * buehlmann_inertgas_b; */
 
-			tissue_lowest_ceiling[ci] = (ds->buehlmann_inertgas_b[ci] * ds->tissue_inertgas_saturation[ci] - gf_low * ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci]) /
-						     ((1.0 - ds->buehlmann_inertgas_b[ci]) * gf_low + ds->buehlmann_inertgas_b[ci]);
+			tissue_lowest_ceiling[ci] = (b[ci] * saturation[ci] - gf_low * a[ci] * b[ci]) /
+						     ((1.0 - b[ci]) * gf_low + b[ci]);
+		}
+		for (ci = 0; ci < 16; ci++) {
 			if (tissue_lowest_ceiling[ci] > lowest_ceiling)
 				lowest_ceiling = tissue_lowest_ceiling[ci];
-			if (lowest_ceiling > ds->gf_low_pressure_this_dive)
-				ds->gf_low_pressure_this_dive = lowest_ceiling;
 		}
-		for (ci = 0; ci < 16; ci++) {
-			double tolerated;
-
-			if ((surface / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - surface) * gf_high + surface <
-			    (ds->gf_low_pressure_this_dive / ds->buehlmann_inertgas_b[ci] + ds->buehlmann_inertgas_a[ci] - ds->gf_low_pressure_this_dive) * gf_low + ds->gf_low_pressure_this_dive)
-				tolerated = (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high * ds->gf_low_pressure_this_dive - gf_low * surface) -
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_high - gf_low) * ds->gf_low_pressure_this_dive * surface +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface) * ds->tissue_inertgas_saturation[ci]) /
-					    (-ds->buehlmann_inertgas_a[ci] * ds->buehlmann_inertgas_b[ci] * (gf_high - gf_low) +
-					     (1.0 - ds->buehlmann_inertgas_b[ci]) * (gf_low * ds->gf_low_pressure_this_dive - gf_high * surface) +
-					     ds->buehlmann_inertgas_b[ci] * (ds->gf_low_pressure_this_dive - surface));
-			else
-				tolerated = ret_tolerance_limit_ambient_pressure;
+		if (lowest_ceiling > ds->gf_low_pressure_this_dive)
+			ds->gf_low_pressure_this_dive = lowest_ceiling;
 
+		gf_low_pressure = ds->gf_low_pressure_this_dive;
+		for (ci = 0; ci < 16; ci++) {
+			below[ci] = (surface / b[ci] + a[ci] - surface) * gf_high + surface <
+				    (gf_low_pressure / b[ci] + a[ci] - gf_low_pressure) * gf_low + gf_low_pressure;
+			tolerated_if_below[ci] = (-a[ci] * b[ci] * (gf_high * gf_low_pressure - gf_low * surface) -
+						  (1.0 - b[ci]) * (gf_high - gf_low) * gf_low_pressure * surface +
+						  b[ci] * (gf_low_pressure - surface) * saturation[ci]) /
+						 (-a[ci] * b[ci] * (gf_high - gf_low) +
+						  (1.0 - b[ci]) * (gf_low * gf_low_pressure - gf_high * surface) +
+						  b[ci] * (gf_low_pressure - surface));
+		}
+		for (ci = 0; ci < 16; ci++) {
+			double tolerated = below[ci] ? tolerated_if_below[ci] : ret_tolerance_limit_ambient_pressure;
 
 			ds->tolerated_by_tissue[ci] = tolerated;
 
@@ -289,6 +303,11 @@ double tissue_tolerance_calc(struct deco_state *ds, const struct dive *dive, dou
 	return ret_tolerance_limit_ambient_pressure;
 }
 
+/* Cache the factors of the recently used periods. Only switched off by
+ * the tests, to compare against the uncached calculation. Therefore, this
+ * is not declared in a header. */
+bool deco_factor_cache = true;
+
 /*
  * Return Buehlmann factor for a particular period and tissue index.
  */
@@ -308,9 +327,42 @@ static double factor(int period_in_seconds, int ci, enum gas_component gas)
 		return 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_He_t_halflife[ci]);
 }
 
-static double calc_surface_phase(double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant, bool in_planner)
+/* The planner uses the Schreiner value for VPM-B, see above */
+static double water_vapor_pressure(const struct deco_state *ds, bool in_planner)
+{
+	return in_planner && ds->config.mode == VPMB ? WV_PRESSURE_SCHREINER : WV_PRESSURE;
+}
+
+/*
+ * Get the Buehlmann factors of all compartments for a period. One second
+ * is tabulated, other periods are cached in the deco state.
+ */
+static void get_factors(struct deco_state *ds, int period_in_seconds, const double **n2_f, const double **he_f)
 {
-	double inspired_n2 = (surface_pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * NITROGEN_FRACTION;
+	struct deco_factors *f;
+	int ci;
+
+	if (period_in_seconds == 1) {
+		*n2_f = buehlmann_N2_factor_expositon_one_second;
+		*he_f = buehlmann_He_factor_expositon_one_second;
+		return;
+	}
+
+	f = &ds->factor_cache[(unsigned int)period_in_seconds % DECO_FACTOR_CACHE_SIZE];
+	if (f->period != period_in_seconds || !deco_factor_cache) {
+		for (ci = 0; ci < 16; ci++) {
+			f->n2[ci] = factor(period_in_seconds, ci, N2);
+			f->he[ci] = factor(period_in_seconds, ci, HE);
+		}
+		f->period = period_in_seconds;
+	}
+	*n2_f = f->n2;
+	*he_f = f->he;
+}
+
+static double calc_surface_phase(const struct deco_state *ds, double surface_pressure, double he_pressure, double n2_pressure, double he_time_constant, double n2_time_constant, bool in_planner)
+{
+	double inspired_n2 = (surface_pressure - water_vapor_pressure(ds, in_planner)) * NITROGEN_FRACTION;
 
 	if (n2_pressure > inspired_n2)
 		return (he_pressure / he_time_constant + (n2_pressure - inspired_n2) / n2_time_constant) / (he_pressure + n2_pressure - inspired_n2);
@@ -343,7 +395,7 @@ void vpmb_next_gradient(struct deco_state *ds, double deco_time, double surface_
 	deco_time /= 60.0;
 
 	for (ci = 0; ci < 16; ++ci) {
-		desat_time = deco_time + calc_surface_phase(surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci], in_planner);
+		desat_time = deco_time + calc_surface_phase(ds, surface_pressure, ds->tissue_he_sat[ci], ds->tissue_n2_sat[ci], log(2.0) / buehlmann_He_t_halflife[ci], log(2.0) / buehlmann_N2_t_halflife[ci], in_planner);
 
 		n2_b = ds->initial_n2_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
 		he_b = ds->initial_he_gradient[ci] + (vpmb_config.crit_volume_lambda * vpmb_config.surface_tension_gamma) / (vpmb_config.skin_compression_gammaC * desat_time);
@@ -387,11 +439,11 @@ void nuclear_regeneration(struct deco_state *ds, double time)
 	double crushing_radius_N2, crushing_radius_He;
 	for (ci = 0; ci < 16; ++ci) {
 		//rm
-		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2());
-		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He());
+		crushing_radius_N2 = 1.0 / (ds->max_n2_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_N2(ds));
+		crushing_radius_He = 1.0 / (ds->max_he_crushing_pressure[ci] / (2.0 * (vpmb_config.skin_compression_gammaC - vpmb_config.surface_tension_gamma)) + 1.0 / get_crit_radius_He(ds));
 		//rs
-		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2() - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
-		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He() - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->n2_regen_radius[ci] = crushing_radius_N2 + (get_crit_radius_N2(ds) - crushing_radius_N2) * (1.0 - exp (-time / vpmb_config.regeneration_time));
+		ds->he_regen_radius[ci] = crushing_radius_He + (get_crit_radius_He(ds) - crushing_radius_He) * (1.0 - exp (-time / vpmb_config.regeneration_time));
 	}
 }
 
@@ -431,8 +483,8 @@ void calc_crushing_pressure(struct deco_state *ds, double pressure)
 			if (ds->max_ambient_pressure >= pressure)
 				return;
 
-			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(), ds->crushing_onset_tension[ci], pressure);
-			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(), ds->crushing_onset_tension[ci], pressure);
+			n2_inner_pressure = calc_inner_pressure(get_crit_radius_N2(ds), ds->crushing_onset_tension[ci], pressure);
+			he_inner_pressure = calc_inner_pressure(get_crit_radius_He(ds), ds->crushing_onset_tension[ci], pressure);
 
 			n2_crushing_pressure = pressure - n2_inner_pressure;
 			he_crushing_pressure = pressure - he_inner_pressure;
@@ -450,28 +502,40 @@ void add_segment(struct deco_state *ds, double pressure, struct gasmix gasmix, i
 	int ci;
 	struct gas_pressures pressures;
 	bool icd = false;
-	fill_pressures(&pressures, pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE),
+	const double *n2_f, *he_f;
+	double *n2_sat = ds->tissue_n2_sat;
+	double *he_sat = ds->tissue_he_sat;
+	double *saturation = ds->tissue_inertgas_saturation;
+	double satmult = buehlmann_config.satmult;
+	double desatmult = buehlmann_config.desatmult;
+
+	fill_pressures(&pressures, pressure - water_vapor_pressure(ds, in_planner),
 		       gasmix, (double) ccpo2 / 1000.0, divemode);
+	get_factors(ds, period_in_seconds, &n2_f, &he_f);
+
+	// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
+	ci = ds->ci_pointing_to_guiding_tissue;
+	if (ci >= 0) {
+		double pn2_oversat = pressures.n2 - n2_sat[ci];
+		double phe_oversat = pressures.he - he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? satmult : desatmult;
+		double he_satmult = phe_oversat > 0 ? satmult : desatmult;
+		icd = pn2_oversat > 0.0 && phe_oversat < 0.0 &&
+		      pn2_oversat * n2_satmult * n2_f[ci] + phe_oversat * he_satmult * he_f[ci] > 0;
+	}
 
+	// Branch-free, so that the compiler can vectorize it
 	for (ci = 0; ci < 16; ci++) {
-		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
-		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
-		double n2_f = factor(period_in_seconds, ci, N2);
-		double he_f = factor(period_in_seconds, ci, HE);
-		double n2_satmult = pn2_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
-		double he_satmult = phe_oversat > 0 ? buehlmann_config.satmult : buehlmann_config.desatmult;
-
-		// Report ICD if N2 is more on-gasing than He off-gasing in leading tissue
-		if (ci == ds->ci_pointing_to_guiding_tissue && pn2_oversat > 0.0 && phe_oversat < 0.0 &&
-		    pn2_oversat * n2_satmult * n2_f + phe_oversat * he_satmult * he_f > 0)
-			icd = true;
-
-		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
-		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
-		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
-
+		double pn2_oversat = pressures.n2 - n2_sat[ci];
+		double phe_oversat = pressures.he - he_sat[ci];
+		double n2_satmult = pn2_oversat > 0 ? satmult : desatmult;
+		double he_satmult = phe_oversat > 0 ? satmult : desatmult;
+
+		n2_sat[ci] += n2_satmult * pn2_oversat * n2_f[ci];
+		he_sat[ci] += he_satmult * phe_oversat * he_f[ci];
+		saturation[ci] = n2_sat[ci] + he_sat[ci];
 	}
-	if (decoMode(in_planner) == VPMB)
+	if (ds->config.mode == VPMB)
 		calc_crushing_pressure(ds, pressure);
 	ds->icd_warning = icd;
 	return;
@@ -503,19 +567,22 @@ void clear_vpmb_state(struct deco_state *ds)
 	ds->max_bottom_ceiling_pressure.mbar = 0;
 }
 
-void clear_deco(struct deco_state *ds, double surface_pressure, bool in_planner)
+/* Note: config may point into ds */
+void clear_deco(struct deco_state *ds, double surface_pressure, const struct deco_config *config, bool in_planner)
 {
 	int ci;
+	struct deco_config new_config = *config;
 
 	memset(ds, 0, sizeof(*ds));
+	ds->config = new_config;
 	clear_vpmb_state(ds);
 	for (ci = 0; ci < 16; ci++) {
-		ds->tissue_n2_sat[ci] = (surface_pressure - ((in_planner && (decoMode(true) == VPMB)) ? WV_PRESSURE_SCHREINER : WV_PRESSURE)) * N2_IN_AIR / 1000;
+		ds->tissue_n2_sat[ci] = (surface_pressure - water_vapor_pressure(ds, in_planner)) * N2_IN_AIR / 1000;
 		ds->tissue_he_sat[ci] = 0.0;
 		ds->max_n2_crushing_pressure[ci] = 0.0;
 		ds->max_he_crushing_pressure[ci] = 0.0;
-		ds->n2_regen_radius[ci] = get_crit_radius_N2();
-		ds->he_regen_radius[ci] = get_crit_radius_He();
+		ds->n2_regen_radius[ci] = get_crit_radius_N2(ds);
+		ds->he_regen_radius[ci] = get_crit_radius_He(ds);
 	}
 	ds->gf_low_pressure_this_dive = surface_pressure + buehlmann_config.gf_low_position_min;
 	ds->max_ambient_pressure = 0.0;
@@ -569,6 +636,17 @@ int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const
 	return depth;
 }
 
+static int clamp_vpmb_conservatism(short conservatism)
+{
+	if (conservatism < 0)
+		return 0;
+	else if (conservatism > 4)
+		return 4;
+	else
+		return conservatism;
+}
+
+/* The global settings are only the defaults for new calculations, see get_deco_config() */
 void set_gf(short gflow, short gfhigh)
 {
 	if (gflow != -1)
@@ -579,19 +657,30 @@ void set_gf(short gflow, short gfhigh)
 
 void set_vpmb_conservatism(short conservatism)
 {
-	if (conservatism < 0)
-		vpmb_config.conservatism = 0;
-	else if (conservatism > 4)
-		vpmb_config.conservatism = 4;
-	else
-		vpmb_config.conservatism = conservatism;
+	vpmb_config.conservatism = clamp_vpmb_conservatism(conservatism);
+}
+
+void get_deco_config(struct deco_config *config, bool in_planner)
+{
+	config->mode = decoMode(in_planner);
+	config->gf_low = buehlmann_config.gf_low;
+	config->gf_high = buehlmann_config.gf_high;
+	config->vpmb_conservatism = vpmb_config.conservatism;
+}
+
+void init_deco_config(struct deco_config *config, enum deco_mode mode, short gflow, short gfhigh, short conservatism)
+{
+	config->mode = mode;
+	config->gf_low = (double)gflow / 100.0;
+	config->gf_high = (double)gfhigh / 100.0;
+	config->vpmb_conservatism = clamp_vpmb_conservatism(conservatism);
 }
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive)
 {
 	double surface_pressure_bar = get_surface_pressure_in_mbar(dive, true) / 1000.0;
-	double gf_low = buehlmann_config.gf_low;
-	double gf_high = buehlmann_config.gf_high;
+	double gf_low = ds->config.gf_low;
+	double gf_high = ds->config.gf_high;
 	double gf;
 	if (ds->gf_low_pressure_this_dive > surface_pressure_bar)
 		gf = MAX((double)gf_low, (ambpressure_bar - surface_pressure_bar) /
@@ -5,6 +5,7 @@
 #include "units.h"
 #include "gas.h"
 #include "divemode.h"
+#include "pref.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -14,7 +15,27 @@ struct dive;
 struct divecomputer;
 struct decostop;
 
+/* The settings of the decompression model. Every deco_state carries its own
+ * copy, so that calculations with different settings can run concurrently. */
+struct deco_config {
+	enum deco_mode mode;
+	double gf_low;				// gradient factor low (at bottom/start of deco calculation)
+	double gf_high;				// gradient factor high (at surface)
+	int vpmb_conservatism;			// 0 (least conservative) to 4
+};
+
+/* Buehlmann factors of all compartments for a time period */
+#define DECO_FACTOR_CACHE_SIZE 4
+struct deco_factors {
+	int period;				// in seconds, 0 if unused
+	double n2[16];
+	double he[16];
+};
+
+/* The per-compartment values are kept in separate arrays, so that
+ * the compiler can vectorize the loops over the compartments. */
 struct deco_state {
+	struct deco_config config;
 	double tissue_n2_sat[16];
 	double tissue_he_sat[16];
 	double tolerated_by_tissue[16];
@@ -45,6 +66,7 @@ struct deco_state {
 	long sumx, sumxx;
 	double sumy, sumxy;
 	int plot_depth;
+	struct deco_factors factor_cache[DECO_FACTOR_CACHE_SIZE]; // indexed by period modulo cache size
 };
 
 extern const double buehlmann_N2_t_halflife[];
@@ -52,10 +74,12 @@ extern const double buehlmann_N2_t_halflife[];
 extern int deco_allowed_depth(double tissues_tolerance, double surface_pressure, const struct dive *dive, bool smooth);
 
 double get_gf(struct deco_state *ds, double ambpressure_bar, const struct dive *dive);
-extern void clear_deco(struct deco_state *ds, double surface_pressure, bool in_planner);
+extern void clear_deco(struct deco_state *ds, double surface_pressure, const struct deco_config *config, bool in_planner);
 extern void dump_tissues(struct deco_state *ds);
 extern void set_gf(short gflow, short gfhigh);
 extern void set_vpmb_conservatism(short conservatism);
+extern void get_deco_config(struct deco_config *config, bool in_planner);
+extern void init_deco_config(struct deco_config *config, enum deco_mode mode, short gflow, short gfhigh, short conservatism);
 extern void cache_deco_state(struct deco_state *source, struct deco_state **datap);
 extern void restore_deco_state(struct deco_state *data, struct deco_state *target, bool keep_vpmb_state);
 extern void nuclear_regeneration(struct deco_state *ds, double time);
@@ -10,6 +10,8 @@ extern "C" {
 
 /* Plot info with smoothing, velocity indication
  * and one-, two- and three-minute minimums and maximums */
+struct deco_checkpoints;
+
 struct plot_info {
 	int nr;
 	int nr_cylinders;
@@ -24,6 +26,10 @@ struct plot_info {
 	bool waypoint_above_ceiling;
 	struct plot_data *entry;
 	struct plot_pressure_data *pressures; /* cylinders.nr blocks of nr entries. */
+	int columns; /* the optional columns that were calculated */
+	int *tissue_ceilings; /* nr blocks of 16 entries or NULL */
+	int *tissue_percentages; /* nr blocks of 16 entries or NULL */
+	struct deco_checkpoints *deco_checkpoints; /* to recalculate only the changed part of the profile */
 };
 
 extern struct divecomputer *select_dc(struct dive *);
@@ -24,6 +24,7 @@
 #include "trip.h"
 #include "structured_list.h"
 #include "fulltext.h"
+#include "git-access.h"
 
 /* one could argue about the best place to have this variable -
  * it's used in the UI, but it seems to make the most sense to have it
@@ -545,13 +546,15 @@ void per_cylinder_mean_depth(const struct dive *dive, struct divecomputer *dc, i
 		return;
 	}
 	free(used_cylinders);
-	if (!dc->samples)
+	if (!get_sample_count(dc))
 		fake_dc(dc);
+	struct divecomputer tmp;
+	const struct divecomputer *unpacked = get_unpacked_dc(dc, &tmp);
 	const struct event *ev = get_next_event(dc->events, "gaschange");
 	depthtime = malloc(dive->cylinders.nr * sizeof(*depthtime));
 	memset(depthtime, 0, dive->cylinders.nr * sizeof(*depthtime));
-	for (i = 0; i < dc->samples; i++) {
-		struct sample *sample = dc->sample + i;
+	for (i = 0; i < unpacked->samples; i++) {
+		const struct sample *sample = unpacked->sample + i;
 		uint32_t time = sample->time.seconds;
 		int depth = sample->depth.mm;
 
@@ -583,6 +586,7 @@ void per_cylinder_mean_depth(const struct dive *dive, struct divecomputer *dc, i
 			mean[i] = (depthtime[i] + duration[i] / 2) / duration[i];
 	}
 	free(depthtime);
+	release_unpacked_dc(&tmp);
 }
 
 static void update_min_max_temperatures(struct dive *dive, temperature_t temperature)
@@ -618,7 +622,8 @@ int explicit_first_cylinder(const struct dive *dive, const struct divecomputer *
 		return -1;
 	if (dc) {
 		const struct event *ev = get_next_event(dc->events, "gaschange");
-		if (ev && ((dc->sample && ev->time.seconds == dc->sample[0].time.seconds) || ev->time.seconds <= 1))
+		duration_t first_time;
+		if (ev && ((get_first_sample_time(dc, &first_time) && ev->time.seconds == first_time.seconds) || ev->time.seconds <= 1))
 			res = get_cylinder_index(dive, ev);
 		else if (dc->divemode == CCR)
 			res = MAX(get_cylinder_idx_by_use(dive, DILUENT), 0);
@@ -646,6 +651,7 @@ void update_setpoint_events(const struct dive *dive, struct divecomputer *dc)
 		// by mistake when it's actually CCR is _bad_
 		// So we make sure, this comes from a Predator or Petrel and we only remove
 		// pO2 values we would have computed anyway.
+		unpack_samples(dc);
 		const struct event *ev = get_next_event(dc->events, "gaschange");
 		struct gasmix gasmix = get_gasmix_from_event(dive, ev);
 		const struct event *next = get_next_event(ev, "gaschange");
@@ -1252,7 +1258,15 @@ struct dive *fixup_dive(struct dive *dive)
 {
 	int i;
 	struct divecomputer *dc;
+	bool packed = false;
 
+	/* The dive computers are fixed up from their samples. Samples that
+	 * are not loaded from git yet are left alone, see load_dive_samples(). */
+	for_each_dc (dive, dc) {
+		if (dc->packed_samples)
+			packed = true;
+		unpack_samples(dc);
+	}
 	sanitize_cylinder_info(dive);
 	dive->maxcns = dive->cns;
 
@@ -1290,10 +1304,57 @@ struct dive *fixup_dive(struct dive *dive)
 	 * but we want to make sure... */
 	if (!dive->id)
 		dive->id = dive_getUniqID();
+	if (packed)
+		pack_dive_samples(dive);
 
 	return dive;
 }
 
+/*
+ * The samples of a dive computer are not necessarily in memory: they
+ * may not be loaded from a git repository yet. This loads them and
+ * updates the values calculated from them, i.e. it changes the dive.
+ * Therefore it must only be called on the main thread, before the
+ * samples are used, and not on dives that other threads are working
+ * with.
+ */
+void load_dive_samples(struct dive *dive)
+{
+	/* Values calculated from the samples have to be updated */
+	if (dive && load_git_dive_samples(dive))
+		fixup_dive(dive);
+}
+
+/*
+ * Code that changes the samples needs them loaded and unpacked (see
+ * pack_samples()). The same restrictions as for load_dive_samples()
+ * apply. Returns true if any samples were packed, so that callers
+ * which only need them for a while can pack them again.
+ */
+bool unpack_dive_samples(struct dive *dive)
+{
+	struct divecomputer *dc;
+	bool packed = false;
+
+	if (!dive)
+		return false;
+	load_dive_samples(dive);
+	for_each_dc (dive, dc) {
+		if (dc->packed_samples)
+			packed = true;
+		unpack_samples(dc);
+	}
+	return packed;
+}
+
+void pack_dive_samples(struct dive *dive)
+{
+	struct divecomputer *dc;
+
+	for_each_dc (dive, dc)
+		pack_samples(dc);
+}
+
 /* Don't pick a zero for MERGE_MIN() */
 #define MERGE_MAX(res, a, b, n) res->n = MAX(a->n, b->n)
 #define MERGE_MIN(res, a, b, n) res->n = (a->n) ? (b->n) ? MIN(a->n, b->n) : (a->n) : (b->n)
@@ -1715,6 +1776,7 @@ static void dc_cylinder_renumber(struct dive *dive, struct divecomputer *dc, con
 	struct event *ev;
 
 	/* Remap or delete the sensor indices */
+	unpack_samples(dc);
 	for (i = 0; i < dc->samples; i++)
 		sample_renumber(dc->sample + i, i, mapping);
 
@@ -2352,6 +2414,8 @@ struct dive *try_to_merge(struct dive *a, struct dive *b, bool prefer_downloaded
 	if (!likely_same_dive(a, b))
 		return NULL;
 
+	unpack_dive_samples(a);
+	unpack_dive_samples(b);
 	res = merge_dives(a, b, 0, prefer_downloaded, NULL, &site);
 	res->dive_site = site; /* Caller has to call add_dive_to_dive_site()! */
 	return res;
@@ -2582,6 +2646,8 @@ bool has_planned(const struct dive *dive, bool planned)
  *
  * The dive site the new dive should be added to (if any) is returned
  * in the "dive_site" output parameter.
+ *
+ * The samples of both dives must be loaded and unpacked, see unpack_dive_samples().
  */
 struct dive *merge_dives(const struct dive *a, const struct dive *b, int offset, bool prefer_downloaded, struct dive_trip **trip, struct dive_site **site)
 {
@@ -2842,6 +2908,7 @@ static bool should_split(const struct divecomputer *dc, int t1, int t2)
  * The surface interval points are determined using the first dive computer.
  *
  * In other words, this is a (simplified) reversal of the dive merging.
+ * As for merging, the samples must have been loaded.
  */
 int split_dive(const struct dive *dive, struct dive **new1, struct dive **new2)
 {
@@ -2904,28 +2971,6 @@ int split_dive_at_time(const struct dive *dive, duration_t time, struct dive **n
 	return split_dive_at(dive, i, i - 1, new1, new2);
 }
 
-/*
- * "dc_maxtime()" is how much total time this dive computer
- * has for this dive. Note that it can differ from "duration"
- * if there are surface events in the middle.
- *
- * Still, we do ignore all but the last surface samples from the
- * end, because some divecomputers just generate lots of them.
- */
-static inline int dc_totaltime(const struct divecomputer *dc)
-{
-	int time = dc->duration.seconds;
-	int nr = dc->samples;
-
-	while (nr--) {
-		struct sample *s = dc->sample + nr;
-		time = s->time.seconds;
-		if (s->depth.mm >= SURFACE_THRESHOLD)
-			break;
-	}
-	return time;
-}
-
 /*
  * The end of a dive is actually not trivial, because "duration"
  * is not the duration until the end, but the time we spend under
@@ -3339,42 +3384,6 @@ const struct divecomputer *get_dive_dc_const(const struct dive *dive, int nr)
 	return get_dive_dc((struct dive *)dive, nr);
 }
 
-struct dive *get_dive_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return dive;
-}
-
-int get_idx_by_uniq_id(int id)
-{
-	int i;
-	struct dive *dive = NULL;
-
-	for_each_dive (i, dive) {
-		if (dive->id == id)
-			break;
-	}
-#ifdef DEBUG
-	if (dive == NULL) {
-		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
-		exit(1);
-	}
-#endif
-	return i;
-}
-
 bool dive_site_has_gps_location(const struct dive_site *ds)
 {
 	return ds && has_location(&ds->location);
@@ -178,6 +178,9 @@ extern int legacy_format_o2pressures(const struct dive *dive, const struct divec
 extern bool dive_less_than(const struct dive *a, const struct dive *b);
 extern bool dive_or_trip_less_than(struct dive_or_trip a, struct dive_or_trip b);
 extern struct dive *fixup_dive(struct dive *dive);
+extern void load_dive_samples(struct dive *dive);
+extern bool unpack_dive_samples(struct dive *dive);
+extern void pack_dive_samples(struct dive *dive);
 extern pressure_t calculate_surface_pressure(const struct dive *dive);
 extern pressure_t un_fixup_surface_pressure(const struct dive *d);
 extern int get_dive_salinity(const struct dive *dive);
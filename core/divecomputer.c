@@ -10,6 +10,7 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 /*
  * Good fake dive profiles are hard.
@@ -220,16 +221,21 @@ enum divemode_t get_current_divemode(const struct divecomputer *dc, int time, co
 
 
 /* helper function to make it easier to work with our structures
- * we don't interpolate here, just use the value from the last sample up to that time */
+ * we don't interpolate here, just use the value from the last sample up to that time.
+ * Samples that are not loaded from git yet are not seen, see load_dive_samples(). */
 int get_depth_at_time(const struct divecomputer *dc, unsigned int time)
 {
+	struct divecomputer tmp;
 	int depth = 0;
+
+	dc = get_unpacked_dc(dc, &tmp);
 	if (dc && dc->sample)
 		for (int i = 0; i < dc->samples; i++) {
 			if (dc->sample[i].time.seconds > time)
 				break;
 			depth = dc->sample[i].depth.mm;
 		}
+	release_unpacked_dc(&tmp);
 	return depth;
 }
 
@@ -254,6 +260,17 @@ void alloc_samples(struct divecomputer *dc, int num)
 	}
 }
 
+/* Like alloc_samples(), but without headroom, for when the number of samples is known */
+void reserve_samples(struct divecomputer *dc, int num)
+{
+	if (num > dc->alloc_samples) {
+		dc->alloc_samples = num;
+		dc->sample = realloc(dc->sample, dc->alloc_samples * sizeof(struct sample));
+		if (!dc->sample)
+			dc->samples = dc->alloc_samples = 0;
+	}
+}
+
 void free_samples(struct divecomputer *dc)
 {
 	if (dc) {
@@ -261,7 +278,302 @@ void free_samples(struct divecomputer *dc)
 		dc->sample = 0;
 		dc->samples = 0;
 		dc->alloc_samples = 0;
+		free(dc->packed_samples);
+		dc->packed_samples = NULL;
+		dc->samples_repo = NULL;
+		memset(&dc->unloaded_samples, 0, sizeof(dc->unloaded_samples));
+	}
+}
+
+/*
+ * Compact sample storage.
+ *
+ * Most dive computers only record a handful of the values in struct
+ * sample, so storing every field of every sample wastes a lot of
+ * memory. A packed dive computer stores its samples column by column:
+ * only the channels that are non-zero in at least one sample are kept
+ * and every value is stored as the zig-zag encoded difference to the
+ * value of the previous sample, using 7 bits per byte. Time and depth
+ * change slowly, so most values take a single byte.
+ *
+ * Code that changes the samples unpacks them into the normal array
+ * first, see unpack_dive_samples(). Code that only reads them uses a
+ * temporary copy, see get_unpacked_dc(). The number of samples, the
+ * time of the first sample and the total time are kept along with
+ * the packed data, so that get_sample_count(), get_first_sample_time()
+ * and dc_totaltime() don't have to decode anything.
+ */
+struct packed_samples {
+	struct samples_summary summary;
+	uint32_t channels;	// bit mask of the stored channels
+	int size;
+	unsigned char data[];
+};
+
+struct sample_channel {
+	unsigned short offset, size;
+	bool is_signed;
+};
+
+#define CHANNEL(field, is_signed) { offsetof(struct sample, field), sizeof(((struct sample *)0)->field), is_signed }
+static const struct sample_channel sample_channels[] = {
+	CHANNEL(time, true), CHANNEL(stoptime, true), CHANNEL(ndl, true), CHANNEL(tts, true),
+	CHANNEL(rbt, true), CHANNEL(depth, true), CHANNEL(stopdepth, true), CHANNEL(temperature, false),
+	CHANNEL(pressure[0], true), CHANNEL(pressure[1], true), CHANNEL(setpoint, false),
+	CHANNEL(o2sensor[0], false), CHANNEL(o2sensor[1], false), CHANNEL(o2sensor[2], false),
+	CHANNEL(bearing, true), CHANNEL(sensor[0], false), CHANNEL(sensor[1], false),
+	CHANNEL(cns, false), CHANNEL(heartbeat, false), CHANNEL(sac, true),
+	CHANNEL(in_deco, false), CHANNEL(manually_entered, false)
+};
+#undef CHANNEL
+#define NR_SAMPLE_CHANNELS (sizeof(sample_channels) / sizeof(sample_channels[0]))
+
+static int64_t get_channel(const struct sample *s, const struct sample_channel *c)
+{
+	const char *p = (const char *)s + c->offset;
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+
+	switch (c->size) {
+	case 1:
+		memcpy(&u8, p, 1);
+		return c->is_signed ? (int8_t)u8 : u8;
+	case 2:
+		memcpy(&u16, p, 2);
+		return c->is_signed ? (int16_t)u16 : u16;
+	default:
+		memcpy(&u32, p, 4);
+		return c->is_signed ? (int32_t)u32 : u32;
+	}
+}
+
+static void set_channel(struct sample *s, const struct sample_channel *c, int64_t val)
+{
+	char *p = (char *)s + c->offset;
+	uint8_t u8 = (uint8_t)val;
+	uint16_t u16 = (uint16_t)val;
+	uint32_t u32 = (uint32_t)val;
+
+	switch (c->size) {
+	case 1:
+		memcpy(p, &u8, 1);
+		break;
+	case 2:
+		memcpy(p, &u16, 2);
+		break;
+	default:
+		memcpy(p, &u32, 4);
+		break;
+	}
+}
+
+static unsigned char *put_varint(unsigned char *p, int64_t delta)
+{
+	uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+
+	while (v >= 0x80) {
+		*p++ = (v & 0x7f) | 0x80;
+		v >>= 7;
+	}
+	*p++ = v;
+	return p;
+}
+
+static const unsigned char *get_varint(const unsigned char *p, int64_t *delta)
+{
+	uint64_t v = 0;
+	int shift = 0;
+
+	do {
+		v |= (uint64_t)(*p & 0x7f) << shift;
+		shift += 7;
+	} while (*p++ & 0x80);
+	*delta = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+	return p;
+}
+
+/*
+ * The total time of a dive computer is the time of its last sample that is
+ * not at the surface, see dc_totaltime(). Without samples, it's the duration.
+ */
+static int samples_totaltime(const struct sample *sample, int nr, int duration)
+{
+	int time = duration;
+
+	while (nr--) {
+		const struct sample *s = sample + nr;
+		time = s->time.seconds;
+		if (s->depth.mm >= SURFACE_THRESHOLD)
+			break;
+	}
+	return time;
+}
+
+void pack_samples(struct divecomputer *dc)
+{
+	struct packed_samples *packed;
+	unsigned char *p;
+	uint32_t channels = 0;
+	int i, nr = dc->samples, nr_channels = 0;
+	unsigned int c;
+
+	if (!nr || dc->packed_samples)
+		return;
+
+	for (c = 0; c < NR_SAMPLE_CHANNELS; c++) {
+		for (i = 0; i < nr; i++) {
+			if (get_channel(dc->sample + i, sample_channels + c)) {
+				channels |= 1u << c;
+				nr_channels++;
+				break;
+			}
+		}
+	}
+
+	/* Differences of 32-bit values take at most 5 bytes */
+	packed = malloc(sizeof(*packed) + (size_t)nr * nr_channels * 5);
+	if (!packed)
+		return;
+	p = packed->data;
+	for (c = 0; c < NR_SAMPLE_CHANNELS; c++) {
+		int64_t last = 0;
+		if (!(channels & (1u << c)))
+			continue;
+		for (i = 0; i < nr; i++) {
+			int64_t val = get_channel(dc->sample + i, sample_channels + c);
+			p = put_varint(p, val - last);
+			last = val;
+		}
+	}
+	packed->summary.nr = nr;
+	packed->summary.first_time = dc->sample[0].time.seconds;
+	packed->summary.totaltime = samples_totaltime(dc->sample, nr, dc->duration.seconds);
+	packed->channels = channels;
+	packed->size = p - packed->data;
+	dc->packed_samples = realloc(packed, sizeof(*packed) + packed->size);
+	if (!dc->packed_samples)
+		dc->packed_samples = packed;
+
+	free(dc->sample);
+	dc->sample = NULL;
+	dc->samples = dc->alloc_samples = 0;
+}
+
+static void decode_samples(const struct packed_samples *packed, struct sample *sample)
+{
+	const unsigned char *p = packed->data;
+	unsigned int c;
+	int i;
+
+	for (c = 0; c < NR_SAMPLE_CHANNELS; c++) {
+		int64_t val = 0;
+		if (!(packed->channels & (1u << c)))
+			continue;
+		for (i = 0; i < packed->summary.nr; i++) {
+			int64_t delta;
+			p = get_varint(p, &delta);
+			val += delta;
+			set_channel(sample + i, sample_channels + c, val);
+		}
+	}
+}
+
+void unpack_samples(struct divecomputer *dc)
+{
+	struct packed_samples *packed = dc->packed_samples;
+
+	if (!packed)
+		return;
+
+	free(dc->sample);
+	dc->sample = calloc(packed->summary.nr, sizeof(struct sample));
+	if (!dc->sample) {
+		dc->samples = dc->alloc_samples = 0;
+		return;
 	}
+	decode_samples(packed, dc->sample);
+	dc->samples = dc->alloc_samples = packed->summary.nr;
+	dc->packed_samples = NULL;
+	free(packed);
+}
+
+/* Samples that are packed or not loaded from git yet, see load_dive_samples() */
+static const struct samples_summary *get_samples_summary(const struct divecomputer *dc)
+{
+	if (dc->packed_samples)
+		return &dc->packed_samples->summary;
+	if (dc->samples_repo)
+		return &dc->unloaded_samples;
+	return NULL;
+}
+
+int get_sample_count(const struct divecomputer *dc)
+{
+	const struct samples_summary *summary = get_samples_summary(dc);
+
+	return summary ? summary->nr : dc->samples;
+}
+
+/* Returns false if the dive computer has no samples */
+bool get_first_sample_time(const struct divecomputer *dc, duration_t *time)
+{
+	const struct samples_summary *summary = get_samples_summary(dc);
+
+	if (summary) {
+		time->seconds = summary->first_time;
+		return summary->nr > 0;
+	}
+	if (!dc->samples)
+		return false;
+	*time = dc->sample[0].time;
+	return true;
+}
+
+/*
+ * The time that the dive computer was actually recording this dive. Note
+ * that it can differ from "duration" if there are surface events in the
+ * middle.
+ *
+ * Still, we do ignore all but the last surface samples from the end,
+ * because some divecomputers just generate lots of them.
+ */
+int dc_totaltime(const struct divecomputer *dc)
+{
+	const struct samples_summary *summary = get_samples_summary(dc);
+
+	if (summary)
+		return summary->nr ? summary->totaltime : dc->duration.seconds;
+	return samples_totaltime(dc->sample, dc->samples, dc->duration.seconds);
+}
+
+/*
+ * Readers that only need the samples for a moment use this instead of
+ * unpack_samples(), which changes the dive computer. For a packed dive
+ * computer, tmp is filled with a shallow copy that owns the decoded
+ * samples, otherwise dc itself is returned. Either way, the caller
+ * passes tmp to release_unpacked_dc() when done. This doesn't modify
+ * dc and can be used from worker threads.
+ */
+const struct divecomputer *get_unpacked_dc(const struct divecomputer *dc, struct divecomputer *tmp)
+{
+	tmp->sample = NULL;
+	if (!dc || !dc->packed_samples)
+		return dc;
+
+	*tmp = *dc;
+	tmp->packed_samples = NULL;
+	tmp->sample = calloc(dc->packed_samples->summary.nr, sizeof(struct sample));
+	tmp->samples = tmp->alloc_samples = tmp->sample ? dc->packed_samples->summary.nr : 0;
+	if (tmp->sample)
+		decode_samples(dc->packed_samples, tmp->sample);
+	return tmp;
+}
+
+void release_unpacked_dc(struct divecomputer *tmp)
+{
+	free(tmp->sample);
+	tmp->sample = NULL;
 }
 
 struct sample *prepare_sample(struct divecomputer *dc)
@@ -411,6 +723,14 @@ void copy_samples(const struct divecomputer *s, struct divecomputer *d)
 	// if its a valid pointer, so don't expect malloc() to return NULL for
 	// zero-sized malloc, do it ourselves.
 	d->sample = NULL;
+	d->packed_samples = NULL;
+
+	if (s->packed_samples) {
+		size_t size = sizeof(struct packed_samples) + s->packed_samples->size;
+		d->packed_samples = malloc(size);
+		if (d->packed_samples)
+			memcpy(d->packed_samples, s->packed_samples, size);
+	}
 
 	if(!nr)
 		return;
@@ -528,6 +848,7 @@ static void free_extra_data(struct extra_data *ed)
 void free_dc_contents(struct divecomputer *dc)
 {
 	free(dc->sample);
+	free(dc->packed_samples);
 	free((void *)dc->model);
 	free((void *)dc->serial);
 	free((void *)dc->fw_version);
@@ -11,6 +11,7 @@ extern "C" {
 
 struct extra_data;
 struct sample;
+struct packed_samples;
 
 /* Is this header the correct place? */
 #define SURFACE_THRESHOLD 750 /* somewhat arbitrary: only below 75cm is it really diving */
@@ -28,6 +29,16 @@ struct sample;
  *
  * A deviceid or diveid of zero is assumed to be "no ID".
  */
+
+/*
+ * What is known about samples that are not in the sample array, because
+ * they are packed or not loaded yet. See get_sample_count().
+ */
+struct samples_summary {
+	int nr;
+	int first_time, totaltime;
+};
+
 struct divecomputer {
 	timestamp_t when;
 	duration_t duration, surfacetime, last_manual_time;
@@ -44,6 +55,10 @@ struct divecomputer {
 	struct event *events;
 	struct extra_data *extra_data;
 	struct divecomputer *next;
+	const char *samples_repo;		// samples not yet loaded from this git repository
+	unsigned char samples_git_id[20];	// git blob containing the samples
+	struct samples_summary unloaded_samples; // what is known about them until then
+	struct packed_samples *packed_samples;	// samples in compact form, see pack_samples()
 };
 
 extern void fake_dc(struct divecomputer *dc);
@@ -53,7 +68,15 @@ extern enum divemode_t get_current_divemode(const struct divecomputer *dc, int t
 extern int get_depth_at_time(const struct divecomputer *dc, unsigned int time);
 extern void free_dive_dcs(struct divecomputer *dc);
 extern void alloc_samples(struct divecomputer *dc, int num);
+extern void reserve_samples(struct divecomputer *dc, int num);
 extern void free_samples(struct divecomputer *dc);
+extern void pack_samples(struct divecomputer *dc);
+extern void unpack_samples(struct divecomputer *dc);
+extern int get_sample_count(const struct divecomputer *dc);
+extern bool get_first_sample_time(const struct divecomputer *dc, duration_t *time);
+extern int dc_totaltime(const struct divecomputer *dc);
+extern const struct divecomputer *get_unpacked_dc(const struct divecomputer *dc, struct divecomputer *tmp);
+extern void release_unpacked_dc(struct divecomputer *tmp);
 extern struct sample *prepare_sample(struct divecomputer *dc);
 extern void finish_sample(struct divecomputer *dc);
 extern struct sample *add_sample(const struct sample *sample, int time, struct divecomputer *dc);
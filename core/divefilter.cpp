@@ -92,17 +92,17 @@ ShownChange DiveFilter::updateAll() const
 			bool newStatus = dive_sites.contains(d->dive_site);
 			updateDiveStatus(d, newStatus, res);
 		}
-	} else if (filterData.fullText.doit()) {
-		FullTextResult ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
-		for_each_dive(i, d) {
-			bool newStatus = ft.dive_matches(d) && showDive(d);
-			updateDiveStatus(d, newStatus, res);
-		}
 	} else {
-		for_each_dive(i, d) {
-			bool newStatus = showDive(d);
-			updateDiveStatus(d, newStatus, res);
-		}
+		// The per-dive checks only read the dives, therefore they are run on all cores.
+		// The results are applied on the calling thread, because that changes the selection.
+		FullTextResult ft;
+		bool doFullText = filterData.fullText.doit();
+		if (doFullText)
+			ft = fulltext_find_dives(filterData.fullText, filterData.fulltextStringMode);
+		std::vector<char> shown = filter_constraints_match_dives(constraints, doFullText ? &ft : nullptr,
+									 prefs.display_invalid_dives);
+		for_each_dive(i, d)
+			updateDiveStatus(d, shown[i], res);
 	}
 	res.currentChanged = old_current != current_dive;
 	return res;
@@ -134,8 +134,8 @@ bool DiveFilter::showDive(const struct dive *d) const
 	if (!filterData.validFilter())
 		return true;
 
-	return std::all_of(filterData.constraints.begin(), filterData.constraints.end(),
-			   [d] (const filter_constraint &c) { return filter_constraint_match_dive(c, d); });
+	return std::all_of(constraints.begin(), constraints.end(),
+			   [d] (const compiled_filter_constraint &c) { return filter_constraint_match_dive(c, d); });
 }
 
 #if !defined(SUBSURFACE_MOBILE) && !defined(SUBSURFACE_DOWNLOADER)
@@ -209,6 +209,7 @@ int DiveFilter::shownDives() const
 void DiveFilter::setFilter(const FilterData &data)
 {
 	filterData = data;
+	constraints.assign(filterData.constraints.begin(), filterData.constraints.end());
 	emit diveListNotifier.filterReset();
 }
 
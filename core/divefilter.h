@@ -62,6 +62,7 @@ private:
 
 	QVector<dive_site *> dive_sites;
 	FilterData filterData;
+	std::vector<compiled_filter_constraint> constraints; // Constraints of filterData, compiled in setFilter()
 	mutable int shown_dives;
 
 	// We use ref-counting for the dive site mode. The reason is that when switching
@@ -96,7 +96,8 @@ static int calculate_otu(const struct dive *dive)
 {
 	int i;
 	double otu = 0.0;
-	const struct divecomputer *dc = &dive->dc;
+	struct divecomputer tmp;
+	const struct divecomputer *dc = get_unpacked_dc(&dive->dc, &tmp);
 	for (i = 1; i < dc->samples; i++) {
 		int t;
 		int po2i, po2f;
@@ -141,6 +142,7 @@ static int calculate_otu(const struct dive *dive)
 			otu += t / 60.0 * pow(pm, 5.0/6.0) * (1.0 - 5.0 * (po2f - po2i) * (po2f - po2i) / 216000000.0 / (pm * pm));
 		}
 	}
+	release_unpacked_dc(&tmp);
 	return lrint(otu);
 }
 
@@ -156,7 +158,8 @@ static int calculate_otu(const struct dive *dive)
 static double calculate_cns_dive(const struct dive *dive)
 {
 	int n;
-	const struct divecomputer *dc = &dive->dc;
+	struct divecomputer tmp;
+	const struct divecomputer *dc = get_unpacked_dc(&dive->dc, &tmp);
 	double cns = 0.0;
 	double rate;
 	/* Calculate the CNS for each sample in this dive and sum them */
@@ -200,6 +203,7 @@ static double calculate_cns_dive(const struct dive *dive)
 		rate = po2i <= 1500 ? exp(-11.7853 + 0.00193873 * po2avg) : exp(-23.6349 + 0.00980829 * po2avg);
 		cns += (double) t * rate * 100.0;
 	}
+	release_unpacked_dc(&tmp);
 	return cns;
 }
 
@@ -300,6 +304,12 @@ static int calculate_cns(struct dive *dive)
 		printf("Yes\n");
 #endif
 
+		/* Without the samples of a previous dive the result would be
+		 * wrong and stick, since it is stored in the dive. Leave it to
+		 * a later call, when the samples are loaded. */
+		if (pdive->dc.samples_repo)
+			return 0;
+
 		/* CNS reduced with 90min halftime during surface interval */
 		if (last_endtime)
 			cns /= pow(2, (pdive->when - last_endtime) / (90.0 * 60.0));
@@ -392,15 +402,20 @@ static int calculate_sac(const struct dive *dive)
 /* for now we do this based on the first divecomputer */
 static void add_dive_to_deco(struct deco_state *ds, struct dive *dive, bool in_planner)
 {
-	struct divecomputer *dc = &dive->dc;
+	struct divecomputer tmp;
+	const struct divecomputer *dc;
 	struct gasmix gasmix = gasmix_air;
 	int i;
 	const struct event *ev = NULL, *evd = NULL;
 	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
 
-	if (!dc)
+	/* This may run in a worker thread, which must not load the samples.
+	 * That was done by load_deco_dive_samples(), if the caller wanted it. */
+	if (!dive || dive->dc.samples_repo)
 		return;
 
+	dc = get_unpacked_dc(&dive->dc, &tmp);
+
 	for (i = 1; i < dc->samples; i++) {
 		struct sample *psample = dc->sample + i - 1;
 		struct sample *sample = dc->sample + i;
@@ -416,19 +431,18 @@ static void add_dive_to_deco(struct deco_state *ds, struct dive *dive, bool in_p
 				    in_planner);
 		}
 	}
+	release_unpacked_dc(&tmp);
 }
 
+static int find_dive_by_uniq_id(int id);
+
 int get_divenr(const struct dive *dive)
 {
-	int i;
-	const struct dive *d;
 	// tempting as it may be, don't die when called with dive=NULL
-	if (dive)
-		for_each_dive(i, d) {
-			if (d->id == dive->id) // don't compare pointers, we could be passing in a copy of the dive
-				return i;
-		}
-	return -1;
+	// don't compare pointers, we could be passing in a copy of the dive
+	// this is called by the deco calculations on worker threads, so the
+	// lookup must only read the dive table and the id index
+	return dive ? find_dive_by_uniq_id(dive->id) : -1;
 }
 
 static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
@@ -438,7 +452,8 @@ static struct gasmix air = { .o2.permille = O2_IN_AIR, .he.permille = 0 };
 /* return negative surface time if dives are overlapping */
 /* The place you call this function is likely the place where you want
  * to create the deco_state */
-int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_planner)
+/* The settings of the calculation are taken from config, which may point into ds */
+int init_decompression(struct deco_state *ds, const struct dive *dive, const struct deco_config *config, bool in_planner)
 {
 	int i, divenr = -1;
 	int surface_time = 48 * 60 * 60;
@@ -539,7 +554,7 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #if DECO_CALC_DEBUG & 2
 			printf("Init deco\n");
 #endif
-			clear_deco(ds, surface_pressure, in_planner);
+			clear_deco(ds, surface_pressure, config, in_planner);
 			deco_init = true;
 #if DECO_CALC_DEBUG & 2
 			printf("Tissues after init:\n");
@@ -577,7 +592,7 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 #if DECO_CALC_DEBUG & 2
 		printf("Init deco\n");
 #endif
-		clear_deco(ds, surface_pressure, in_planner);
+		clear_deco(ds, surface_pressure, config, in_planner);
 #if DECO_CALC_DEBUG & 2
 		printf("Tissues after no previous dive, surface time set to 48h:\n");
 		dump_tissues(ds);
@@ -602,16 +617,63 @@ int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_p
 	return surface_time;
 }
 
+/* The OTU and CNS of a dive whose samples are not loaded yet are kept as they were read */
 void update_cylinder_related_info(struct dive *dive)
 {
 	if (dive != NULL) {
 		dive->sac = calculate_sac(dive);
+		if (dive->dc.samples_repo)
+			return;
 		dive->otu = calculate_otu(dive);
 		if (dive->maxcns == 0)
 			dive->maxcns = calculate_cns(dive);
 	}
 }
 
+/*
+ * The deco calculation and the CNS of a dive take the previous dives
+ * into account, until there is a gap of 48 hours. This loads the samples
+ * of those and of the dive itself (see load_dive_samples()), which need
+ * not be in the dive table, e.g. a copy that is being edited. Call this
+ * on the main thread, before the profile or a plan of the dive are
+ * calculated, maybe in other threads.
+ */
+void load_deco_dive_samples(const struct dive *dive)
+{
+	int i;
+	timestamp_t last_starttime;
+
+	if (!dive)
+		return;
+	/* As far as the callers are concerned, loading the samples doesn't change the dive */
+	load_dive_samples((struct dive *)dive);
+	i = get_divenr(dive);
+	if (i < 0)
+		i = dive_table.nr;
+	last_starttime = dive->when;
+	while (--i >= 0) {
+		struct dive *pdive = get_dive(i);
+		if (pdive->when >= dive->when)
+			continue;
+		if (dive_endtime(pdive) + 48 * 60 * 60 < last_starttime)
+			break;
+		load_dive_samples(pdive);
+		last_starttime = pdive->when;
+	}
+}
+
+/* For code that works with all (or the selected) dives in another thread */
+void load_all_dive_samples(bool selected_only)
+{
+	int i;
+	struct dive *dive;
+
+	for_each_dive (i, dive) {
+		if (!selected_only || dive->selected)
+			load_dive_samples(dive);
+	}
+}
+
 #define MAX_GAS_STRING 80
 
 /* callers needs to free the string */
@@ -716,6 +778,7 @@ int comp_dives(const struct dive *a, const struct dive *b)
 static MAKE_GROW_TABLE(dive_table, struct dive *, dives)
 MAKE_GET_INSERTION_INDEX(dive_table, struct dive *, dives, dive_less_than)
 MAKE_ADD_TO(dive_table, struct dive *, dives)
+static MAKE_ADD_BATCH_TO(dive_table, struct dive *, dives, dive_less_than)
 static MAKE_REMOVE_FROM(dive_table, dives)
 static MAKE_GET_IDX(dive_table, struct dive *, dives)
 MAKE_SORT(dive_table, struct dive *, dives, comp_dives)
@@ -723,10 +786,197 @@ MAKE_REMOVE(dive_table, struct dive *, dive)
 MAKE_CLEAR_TABLE(dive_table, dives, dive)
 MAKE_MOVE_TABLE(dive_table, dives)
 
+/*
+ * Dives are referred to by their unique id from the undo commands,
+ * the models and the selection code, so we keep a hash index from
+ * the ids to the dives of the global dive table.
+ *
+ * The index is only changed where dives enter or leave the table:
+ * insert_dive(), insert_dives(), delete_dive_from_table() and
+ * unregister_dive(). Dives that are added otherwise, for example by
+ * parsing a file into the table, are indexed by process_loaded_dives().
+ * Therefore, the index never points to a freed dive. Lookups don't
+ * change anything, so they can be done from the worker threads that
+ * run the deco calculations. Dives that the index doesn't know, for
+ * example copies of dives, are found by a linear search.
+ */
+struct dive_id_entry {
+	int id;
+	struct dive *dive;	/* NULL for empty slots */
+};
+
+static struct {
+	int nr, allocated;	/* allocated is a power of two */
+	struct dive_id_entry *entries;
+} dive_id_index;
+
+static unsigned int dive_id_hash(int id)
+{
+	return (unsigned int)id * 2654435761u;
+}
+
+static struct dive_id_entry *find_dive_id_slot(int id)
+{
+	unsigned int mask = dive_id_index.allocated - 1;
+	unsigned int i = dive_id_hash(id) & mask;
+
+	while (dive_id_index.entries[i].dive && dive_id_index.entries[i].id != id)
+		i = (i + 1) & mask;
+	return dive_id_index.entries + i;
+}
+
+static void index_dive(struct dive *d)
+{
+	struct dive_id_entry *e;
+
+	if ((dive_id_index.nr + 1) * 2 > dive_id_index.allocated) {
+		struct dive_id_entry *old = dive_id_index.entries;
+		int i, old_allocated = dive_id_index.allocated;
+
+		dive_id_index.allocated = old_allocated ? old_allocated * 2 : 256;
+		dive_id_index.entries = calloc(dive_id_index.allocated, sizeof(struct dive_id_entry));
+		if (!dive_id_index.entries)
+			exit(1);
+		for (i = 0; i < old_allocated; i++) {
+			if (old[i].dive)
+				*find_dive_id_slot(old[i].id) = old[i];
+		}
+		free(old);
+	}
+
+	e = find_dive_id_slot(d->id);
+	if (!e->dive)
+		dive_id_index.nr++;
+	e->id = d->id;
+	e->dive = d;
+}
+
+static void remove_dive_id_slot(struct dive_id_entry *e)
+{
+	unsigned int mask = dive_id_index.allocated - 1;
+	unsigned int i = e - dive_id_index.entries, j = i;
+
+	/* Move up the following entries of the probe sequence that may fill the hole */
+	for (;;) {
+		unsigned int k;
+
+		j = (j + 1) & mask;
+		if (!dive_id_index.entries[j].dive)
+			break;
+		k = dive_id_hash(dive_id_index.entries[j].id) & mask;
+		if (i <= j ? (k <= i || k > j) : (k <= i && k > j)) {
+			dive_id_index.entries[i] = dive_id_index.entries[j];
+			i = j;
+		}
+	}
+	dive_id_index.entries[i].dive = NULL;
+	dive_id_index.nr--;
+}
+
+static void unindex_dive(const struct dive *d)
+{
+	struct dive_id_entry *e;
+
+	if (!dive_id_index.nr)
+		return;
+	e = find_dive_id_slot(d->id);
+	if (e->dive == d)
+		remove_dive_id_slot(e);
+}
+
+static void rebuild_dive_id_index(void)
+{
+	int i;
+
+	if (dive_id_index.entries)
+		memset(dive_id_index.entries, 0, dive_id_index.allocated * sizeof(struct dive_id_entry));
+	dive_id_index.nr = 0;
+	for (i = 0; i < dive_table.nr; i++)
+		index_dive(dive_table.dives[i]);
+}
+
+/* The position of a dive in the sorted dive table, or -1 if it isn't in the table */
+static int get_dive_table_idx(const struct dive *d)
+{
+	int i = dive_table_get_insertion_index(&dive_table, (struct dive *)d) - 1;
+
+	if (i >= 0 && dive_table.dives[i] == d)
+		return i;
+	/* The table may be unsorted for a moment, e.g. while a dive is edited */
+	for (i = 0; i < dive_table.nr; i++) {
+		if (dive_table.dives[i] == d)
+			return i;
+	}
+	return -1;
+}
+
+/* Returns the index of the dive with the given id, or -1. This doesn't change anything. */
+static int find_dive_by_uniq_id(int id)
+{
+	int i;
+
+	if (dive_id_index.nr) {
+		const struct dive_id_entry *e = find_dive_id_slot(id);
+		if (e->dive && e->dive->id == id) {
+			i = get_dive_table_idx(e->dive);
+			if (i >= 0)
+				return i;
+		}
+	}
+	for (i = 0; i < dive_table.nr; i++) {
+		if (dive_table.dives[i]->id == id)
+			return i;
+	}
+	return -1;
+}
+
+struct dive *get_dive_by_uniq_id(int id)
+{
+	int idx = find_dive_by_uniq_id(id);
+#ifdef DEBUG
+	if (idx < 0) {
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+	}
+#endif
+	return idx >= 0 ? dive_table.dives[idx] : NULL;
+}
+
+int get_idx_by_uniq_id(int id)
+{
+	int idx = find_dive_by_uniq_id(id);
+
+	if (idx < 0) {
+#ifdef DEBUG
+		fprintf(stderr, "Invalid id %x passed to get_dive_by_diveid, try to fix the code\n", id);
+		exit(1);
+#endif
+		return dive_table.nr;
+	}
+	return idx;
+}
+
 void insert_dive(struct dive_table *table, struct dive *d)
 {
 	int idx = dive_table_get_insertion_index(table, d);
 	add_to_dive_table(table, idx, d);
+	if (table == &dive_table)
+		index_dive(d);
+}
+
+/* Insert all dives of a table, the source table is empty afterwards */
+void insert_dives(struct dive_table *table, struct dive_table *dives)
+{
+	int i;
+
+	if (!dives->nr)
+		return;
+	sort_dive_table(dives);
+	if (table == &dive_table) {
+		for (i = 0; i < dives->nr; i++)
+			index_dive(dives->dives[i]);
+	}
+	add_batch_to_dive_table(table, dives);
 }
 
 /*
@@ -761,6 +1011,8 @@ static void autogroup_dives(struct dive_table *table, struct trip_table *trip_ta
  * It simply shrinks the table and frees the trip */
 void delete_dive_from_table(struct dive_table *table, int idx)
 {
+	if (table == &dive_table)
+		unindex_dive(table->dives[idx]);
 	free_dive(table->dives[idx]);
 	remove_from_dive_table(table, idx);
 }
@@ -784,6 +1036,7 @@ struct dive *unregister_dive(int idx)
 	/* When removing a dive from the global dive table,
 	 * we also have to unregister its fulltext cache. */
 	fulltext_unregister(dive);
+	unindex_dive(dive);
 	remove_from_dive_table(&dive_table, idx);
 	if (dive->selected)
 		amount_selected--;
@@ -816,10 +1069,17 @@ void process_loaded_dives()
 
 	sort_dive_table(&dive_table);
 	sort_trip_table(&trip_table);
+	rebuild_dive_id_index();
 
 	/* Autogroup dives if desired by user. */
 	autogroup_dives(&dive_table, &trip_table);
 
+	/* Keep the samples in compact form until they are needed. */
+	if (prefs.compact_samples) {
+		for_each_dive(i, dive)
+			pack_dive_samples(dive);
+	}
+
 	fulltext_populate();
 
 	/* Inform frontend of reset data. This should reset all the models. */
@@ -1027,14 +1287,10 @@ void add_imported_dives(struct dive_table *import_table, struct trip_table *impo
 	dives_to_remove.nr = 0;
 
 	/* Add new dives */
-	for (i = 0; i < dives_to_add.nr; i++)
-		insert_dive(&dive_table, dives_to_add.dives[i]);
-	dives_to_add.nr = 0;
+	insert_dives(&dive_table, &dives_to_add);
 
 	/* Add new trips */
-	for (i = 0; i < trips_to_add.nr; i++)
-		insert_trip(trips_to_add.trips[i], &trip_table);
-	trips_to_add.nr = 0;
+	insert_trips(&trips_to_add, &trip_table);
 
 	/* Add new dive sites */
 	for (i = 0; i < dive_sites_to_add.nr; i++)
@@ -1133,6 +1389,7 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 {
 	int i, j, nr, start_renumbering_at = 0;
 	struct dive_trip *trip_import, *new_trip;
+	struct dive_site_index *site_index;
 	bool sequence_changed = false;
 	bool new_dive_has_number = false;
 	bool last_old_dive_is_numbered;
@@ -1193,9 +1450,10 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		autogroup_dives(import_table, import_trip_table);
 
 	/* If dive sites already exist, use the existing versions. */
+	site_index = create_dive_site_index(&dive_site_table);
 	for (i = 0; i  < import_sites_table->nr; i++) {
 		struct dive_site *new_ds = import_sites_table->dive_sites[i];
-		struct dive_site *old_ds = get_same_dive_site(new_ds);
+		struct dive_site *old_ds = dive_site_index_find_same(site_index, new_ds);
 
 		/* Check if it dive site is actually used by new dives. */
 		for (j = 0; j < import_table->nr; j++) {
@@ -1222,6 +1480,7 @@ void process_imported_dives(struct dive_table *import_table, struct trip_table *
 		}
 		free_dive_site(new_ds);
 	}
+	free_dive_site_index(site_index);
 	import_sites_table->nr = 0; /* All dive sites were consumed */
 
 	/* Merge overlapping trips. Since both trip tables are sorted, we
@@ -13,6 +13,7 @@ struct trip_table;
 struct dive_site_table;
 struct device_table;
 struct deco_state;
+struct deco_config;
 
 struct dive_table {
 	int nr, allocated;
@@ -26,7 +27,9 @@ extern struct dive_table dive_table;
 
 extern void sort_dive_table(struct dive_table *table);
 extern void update_cylinder_related_info(struct dive *);
-extern int init_decompression(struct deco_state *ds, const struct dive *dive, bool in_planner);
+extern void load_deco_dive_samples(const struct dive *dive);
+extern void load_all_dive_samples(bool selected_only);
+extern int init_decompression(struct deco_state *ds, const struct dive *dive, const struct deco_config *config, bool in_planner);
 
 /* divelist core logic functions */
 extern void process_loaded_dives();
@@ -49,6 +52,7 @@ extern char *get_dive_gas_string(const struct dive *dive);
 extern int dive_table_get_insertion_index(struct dive_table *table, struct dive *dive);
 extern void add_to_dive_table(struct dive_table *table, int idx, struct dive *dive);
 extern void insert_dive(struct dive_table *table, struct dive *d);
+extern void insert_dives(struct dive_table *table, struct dive_table *dives);
 extern void get_dive_gas(const struct dive *dive, int *o2_p, int *he_p, int *o2low_p);
 extern int get_divenr(const struct dive *dive);
 extern int remove_dive(const struct dive *dive, struct dive_table *table);
@@ -8,6 +8,7 @@
 #include "table.h"
 #include "sha1.h"
 
+#include <limits.h>
 #include <math.h>
 
 struct dive_site_table dive_site_table;
@@ -108,6 +109,262 @@ struct dive_site *get_dive_site_by_gps_proximity(const location_t *loc, int dist
 	return res;
 }
 
+static bool same_dive_site(const struct dive_site *a, const struct dive_site *b)
+{
+	return same_string(a->name, b->name)
+	    && same_location(&a->location, &b->location)
+	    && same_string(a->description, b->description)
+	    && same_string(a->notes, b->notes);
+}
+
+/*
+ * A spatial index of the dive sites of a table for when many queries
+ * are done at once, such as when importing dives or showing the map.
+ * The sites are sorted into a grid of cells of GRID_CELL micro-degrees
+ * and the entries are sorted by cell, so that all sites of a range of
+ * cells in one row of the grid can be found by binary search.
+ *
+ * The locations of the dive sites are changed in place in many places,
+ * so the index is not kept alongside the table, but has to be created
+ * for a batch of queries during which the table doesn't change.
+ *
+ * The queries give the same results as the linear searches above,
+ * in particular the first matching site of the table is returned.
+ */
+#define GRID_CELL 100000
+#define EARTH_RADIUS 6371000.0
+
+struct dive_site_index_entry {
+	int lat_cell, lon_cell;
+	int idx;
+	struct dive_site *ds;
+};
+
+struct dive_site_index {
+	int nr;
+	struct dive_site_index_entry *entries;
+};
+
+static int grid_cell(int udeg)
+{
+	return udeg >= 0 ? udeg / GRID_CELL : -((-udeg + GRID_CELL - 1) / GRID_CELL);
+}
+
+static int compare_index_entries(const void *_a, const void *_b)
+{
+	const struct dive_site_index_entry *a = _a, *b = _b;
+	if (a->lat_cell != b->lat_cell)
+		return a->lat_cell < b->lat_cell ? -1 : 1;
+	if (a->lon_cell != b->lon_cell)
+		return a->lon_cell < b->lon_cell ? -1 : 1;
+	return a->idx - b->idx;
+}
+
+struct dive_site_index *create_dive_site_index(struct dive_site_table *ds_table)
+{
+	struct dive_site_index *index = calloc(1, sizeof(*index));
+	int i;
+
+	if (!index)
+		exit(1);
+	index->entries = malloc((ds_table->nr + 1) * sizeof(*index->entries));
+	if (!index->entries)
+		exit(1);
+	for (i = 0; i < ds_table->nr; i++) {
+		struct dive_site *ds = ds_table->dive_sites[i];
+		struct dive_site_index_entry *e = index->entries + index->nr++;
+
+		e->lat_cell = grid_cell(ds->location.lat.udeg);
+		e->lon_cell = grid_cell(ds->location.lon.udeg);
+		e->idx = i;
+		e->ds = ds;
+	}
+	qsort(index->entries, index->nr, sizeof(*index->entries), compare_index_entries);
+	return index;
+}
+
+void free_dive_site_index(struct dive_site_index *index)
+{
+	if (!index)
+		return;
+	free(index->entries);
+	free(index);
+}
+
+/* call fn for all entries in the given row of cells from lon_cell "from" to "to" */
+static void for_each_entry_in_cells(const struct dive_site_index *index, int lat_cell, int from, int to,
+				    void (*fn)(const struct dive_site_index_entry *e, void *data), void *data)
+{
+	int lo = 0, hi = index->nr;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		const struct dive_site_index_entry *e = index->entries + mid;
+		if (e->lat_cell < lat_cell || (e->lat_cell == lat_cell && e->lon_cell < from))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	for (; lo < index->nr; lo++) {
+		const struct dive_site_index_entry *e = index->entries + lo;
+		if (e->lat_cell != lat_cell || e->lon_cell > to)
+			break;
+		fn(e, data);
+	}
+}
+
+/* call fn for all entries in the area, which may cross the antimeridian (west > east) */
+static void for_each_entry_in_area(const struct dive_site_index *index, int south, int west, int north, int east,
+				   void (*fn)(const struct dive_site_index_entry *e, void *data), void *data)
+{
+	int lat_cell, first = grid_cell(south), last = grid_cell(north);
+
+	for (lat_cell = first; lat_cell <= last; lat_cell++) {
+		if (west <= east) {
+			for_each_entry_in_cells(index, lat_cell, grid_cell(west), grid_cell(east), fn, data);
+		} else {
+			for_each_entry_in_cells(index, lat_cell, grid_cell(west), INT_MAX, fn, data);
+			for_each_entry_in_cells(index, lat_cell, INT_MIN, grid_cell(east), fn, data);
+		}
+	}
+}
+
+struct index_search {
+	const location_t *loc;
+	const struct dive_site *site;
+	unsigned int min_distance;
+	int idx;
+	struct dive_site *res;
+};
+
+static void check_same_location(const struct dive_site_index_entry *e, void *data)
+{
+	struct index_search *search = data;
+	if ((!search->res || e->idx < search->idx) && same_location(search->loc, &e->ds->location)) {
+		search->res = e->ds;
+		search->idx = e->idx;
+	}
+}
+
+struct dive_site *dive_site_index_find_gps(const struct dive_site_index *index, const location_t *loc)
+{
+	struct index_search search = { .loc = loc };
+	int lat = loc->lat.udeg, lon = loc->lon.udeg;
+
+	for_each_entry_in_area(index, lat, lon, lat, lon, check_same_location, &search);
+	return search.res;
+}
+
+static void check_same_site(const struct dive_site_index_entry *e, void *data)
+{
+	struct index_search *search = data;
+	if ((!search->res || e->idx < search->idx) && same_dive_site(search->site, e->ds)) {
+		search->res = e->ds;
+		search->idx = e->idx;
+	}
+}
+
+struct dive_site *dive_site_index_find_same(const struct dive_site_index *index, const struct dive_site *site)
+{
+	struct index_search search = { .site = site };
+	int lat = site->location.lat.udeg, lon = site->location.lon.udeg;
+
+	for_each_entry_in_area(index, lat, lon, lat, lon, check_same_site, &search);
+	return search.res;
+}
+
+static void check_distance(const struct dive_site_index_entry *e, void *data)
+{
+	struct index_search *search = data;
+	unsigned int distance;
+
+	if (!dive_site_has_gps_location(e->ds))
+		return;
+	distance = get_distance(&e->ds->location, search->loc);
+	if (distance < search->min_distance || (distance == search->min_distance && search->res && e->idx < search->idx)) {
+		search->min_distance = distance;
+		search->res = e->ds;
+		search->idx = e->idx;
+	}
+}
+
+static struct dive_site *find_gps_proximity(const struct dive_site_index *index, const location_t *loc, unsigned int distance)
+{
+	struct index_search search = { .loc = loc, .min_distance = distance };
+	/* one metre of slack for the rounding in get_distance() */
+	double angle = (distance + 1.0) / EARTH_RADIUS;
+	double max_lat = fabs(udeg_to_radians(loc->lat.udeg)) + angle;
+	int i, dlat, dlon, west, east;
+
+	if (angle >= M_PI / 2 || max_lat >= M_PI / 2 || sin(angle / 2) >= cos(max_lat)) {
+		/* Close to the poles or far away, everything is a candidate */
+		for (i = 0; i < index->nr; i++)
+			check_distance(index->entries + i, &search);
+		return search.res;
+	}
+
+	/* Bound the latitude and longitude differences of all points within the given angle */
+	dlat = (int)ceil(angle * 180.0 / M_PI * 1000000.0);
+	dlon = (int)ceil(2 * asin(sin(angle / 2) / cos(max_lat)) * 180.0 / M_PI * 1000000.0);
+	if (dlon >= 180000000) {
+		west = -180000000;
+		east = 180000000;
+	} else {
+		west = loc->lon.udeg - dlon;
+		east = loc->lon.udeg + dlon;
+		if (west < -180000000)
+			west += 360000000;
+		if (east > 180000000)
+			east -= 360000000;
+	}
+	for_each_entry_in_area(index, loc->lat.udeg - dlat, west, loc->lat.udeg + dlat, east, check_distance, &search);
+	return search.res;
+}
+
+/* find the closest one, no more than distance meters away - if more than one at same distance, pick the first */
+struct dive_site *dive_site_index_find_gps_proximity(const struct dive_site_index *index, const location_t *loc, int distance)
+{
+	struct dive_site *res;
+	unsigned int d;
+
+	/* If there is a site within a smaller distance, it is the closest one */
+	for (d = 1000; d < (unsigned int)distance; d *= 4) {
+		if ((res = find_gps_proximity(index, loc, d)) != NULL)
+			return res;
+	}
+	return find_gps_proximity(index, loc, distance);
+}
+
+struct area_search {
+	int south, west, north, east;
+	void (*fn)(struct dive_site *ds, void *data);
+	void *data;
+};
+
+static void check_area(const struct dive_site_index_entry *e, void *data)
+{
+	struct area_search *search = data;
+	int lat = e->ds->location.lat.udeg, lon = e->ds->location.lon.udeg;
+
+	if (!dive_site_has_gps_location(e->ds) || lat < search->south || lat > search->north)
+		return;
+	if (search->west <= search->east ? (lon < search->west || lon > search->east)
+					 : (lon < search->west && lon > search->east))
+		return;
+	search->fn(e->ds, search->data);
+}
+
+/* call fn for all sites with a location in the area, which may cross the antimeridian (west > east) */
+void dive_site_index_for_each_in_area(const struct dive_site_index *index, const location_t *south_west, const location_t *north_east,
+				      void (*fn)(struct dive_site *ds, void *data), void *data)
+{
+	struct area_search search = {
+		south_west->lat.udeg, south_west->lon.udeg, north_east->lat.udeg, north_east->lon.udeg, fn, data
+	};
+
+	for_each_entry_in_area(index, search.south, search.west, search.north, search.east, check_area, &search);
+}
+
 int register_dive_site(struct dive_site *ds)
 {
 	return add_dive_site_to_table(ds, &dive_site_table);
@@ -307,14 +564,6 @@ static void merge_string(char **a, char **b)
  * Taxonomy is not compared, as no taxonomy is generated on
  * import.
  */
-static bool same_dive_site(const struct dive_site *a, const struct dive_site *b)
-{
-	return same_string(a->name, b->name)
-	    && same_location(&a->location, &b->location)
-	    && same_string(a->description, b->description)
-	    && same_string(a->notes, b->notes);
-}
-
 struct dive_site *get_same_dive_site(const struct dive_site *site)
 {
 	int i;
@@ -26,6 +26,8 @@ struct dive_site
 	struct taxonomy_data taxonomy;
 };
 
+struct dive_site_index;
+
 typedef struct dive_site_table {
 	int nr, allocated;
 	struct dive_site **dive_sites;
@@ -67,6 +69,13 @@ struct dive_site *get_dive_site_by_gps(const location_t *, struct dive_site_tabl
 struct dive_site *get_dive_site_by_gps_and_name(char *name, const location_t *, struct dive_site_table *ds_table);
 struct dive_site *get_dive_site_by_gps_proximity(const location_t *, int distance, struct dive_site_table *ds_table);
 struct dive_site *get_same_dive_site(const struct dive_site *);
+struct dive_site_index *create_dive_site_index(struct dive_site_table *ds_table);
+void free_dive_site_index(struct dive_site_index *index);
+struct dive_site *dive_site_index_find_gps(const struct dive_site_index *index, const location_t *);
+struct dive_site *dive_site_index_find_gps_proximity(const struct dive_site_index *index, const location_t *, int distance);
+struct dive_site *dive_site_index_find_same(const struct dive_site_index *index, const struct dive_site *);
+void dive_site_index_for_each_in_area(const struct dive_site_index *index, const location_t *south_west, const location_t *north_east,
+				      void (*fn)(struct dive_site *ds, void *data), void *data);
 bool dive_site_is_empty(struct dive_site *ds);
 void copy_dive_site_taxonomy(struct dive_site *orig, struct dive_site *copy);
 void copy_dive_site(struct dive_site *orig, struct dive_site *copy);
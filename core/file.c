@@ -16,6 +16,7 @@
 #include "file.h"
 #include "git-access.h"
 #include "qthelper.h"
+#include "snapshot.h"
 #include "import-csv.h"
 #include "parse.h"
 
@@ -311,7 +312,7 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 	struct git_repository *git;
 	const char *branch = NULL;
 	struct memblock mem;
-	char *fmt;
+	char *fmt, *snapshot_key = NULL;
 	int ret;
 
 	git = is_git_repository(filename, &branch, NULL, false);
@@ -374,7 +375,19 @@ int parse_file(const char *filename, struct dive_table *table, struct trip_table
 		return 0;
 	}
 
+	if (snapshot_applies(table, trips, sites, devices, filter_presets)) {
+		snapshot_key = snapshot_key_from_buffer(mem.buffer, mem.size);
+		if (!load_snapshot(filename, snapshot_key, NULL, table, trips, sites, devices)) {
+			free(snapshot_key);
+			free(mem.buffer);
+			return 0;
+		}
+	}
+
 	ret = parse_file_buffer(filename, &mem, table, trips, sites, devices, filter_presets);
+	if (snapshot_key && !ret)
+		save_snapshot(filename, snapshot_key, table, trips, sites, devices, filter_presets);
+	free(snapshot_key);
 	free(mem.buffer);
 	return ret;
 }
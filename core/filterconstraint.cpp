@@ -1,8 +1,10 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "filterconstraint.h"
 #include "dive.h"
+#include "divelist.h"
 #include "divesite.h"
 #include "errorhelper.h"
+#include "fulltext.h"
 #include "gettextfromc.h"
 #include "qthelper.h"
 #include "tag.h"
@@ -819,97 +821,126 @@ uint64_t filter_constraint_get_multiple_choice(const filter_constraint &c)
 	return c.data.multiple_choice;
 }
 
-// Pointer to function that takes two strings and returns whether
-// the first matches the second according to a criterion (substring, starts-with, exact).
-using StrCheck = bool (*) (const QString &s1, const QString &s2);
-
-// Check if a string-list contains at least one string containing the second argument.
-// Comparison is non case sensitive and removes white space.
-static bool listContainsSuperstring(const QStringList &list, const QString &s, StrCheck strchk)
+// Check whether a string matches a search string according to the string mode
+// of a constraint. Both strings have to be case folded.
+static bool check_string(enum filter_constraint_string_mode mode, const QString &s, const QString &search)
 {
-	return std::any_of(list.begin(), list.end(), [&s,strchk](const QString &s2)
-			   { return strchk(s2, s); } );
+	switch (mode) {
+	case FILTER_CONSTRAINT_SUBSTRING:
+		return s.contains(search);
+	case FILTER_CONSTRAINT_STARTS_WITH:
+		return s.startsWith(search);
+	case FILTER_CONSTRAINT_EXACT:
+		return s == search;
+	}
+	return false;
 }
 
-// Check whether any of the items of the first list is in the second list as a super string.
-// The mode is controlled by the second argument
-static bool check(const filter_constraint &c, const QStringList &list)
+// Check whether any of the search strings matches any of the items of the list.
+// Note: the negation of the constraint is not applied.
+static bool check(const compiled_filter_constraint &c, const std::vector<QString> &list)
 {
-	StrCheck strchk =
-		c.string_mode == FILTER_CONSTRAINT_SUBSTRING ?
-			[](const QString &s1, const QString &s2) { return s1.contains(s2, Qt::CaseInsensitive); } :
-		c.string_mode == FILTER_CONSTRAINT_STARTS_WITH ?
-			[](const QString &s1, const QString &s2) { return s1.startsWith(s2, Qt::CaseInsensitive); } :
-		/* FILTER_CONSTRAINT_EXACT */
-			[](const QString &s1, const QString &s2) { return s1.compare(s2, Qt::CaseInsensitive) == 0; };
-	return std::any_of(c.data.string_list->begin(), c.data.string_list->end(),
-			   [&list, strchk](const QString &item)
-			   { return listContainsSuperstring(list, item, strchk); }) != c.negate;
+	for (const QString &search: c.strings) {
+		if (std::any_of(list.begin(), list.end(), [&c, &search](const QString &s)
+				{ return check_string(c.c.string_mode, s, search); }))
+			return true;
+	}
+	return false;
 }
 
-static bool has_tags(const filter_constraint &c, const struct dive *d)
+static void add_folded(std::vector<QString> &list, const char *s)
 {
-	QStringList dive_tags;
-	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next)
-		dive_tags.push_back(QString(tag->tag->name).trimmed());
-	dive_tags.append(gettextFromC::tr(divemode_text_ui[d->dc.divemode]).trimmed());
-	return check(c, dive_tags);
+	list.push_back(QString(s).toCaseFolded());
 }
 
-static bool has_people(const filter_constraint &c, const struct dive *d)
+static void add_folded_trimmed(std::vector<QString> &list, const char *s)
 {
-	QStringList dive_people;
-	for (const QString &s: QString(d->buddy).split(",", SKIP_EMPTY))
-		dive_people.push_back(s.trimmed());
-	for (const QString &s: QString(d->divemaster).split(",", SKIP_EMPTY))
-		dive_people.push_back(s.trimmed());
-	return check(c, dive_people);
+	list.push_back(QString(s).trimmed().toCaseFolded());
 }
 
-static bool has_locations(const filter_constraint &c, const struct dive *d)
+static void add_folded_list(std::vector<QString> &list, const char *s)
 {
-	QStringList diveLocations;
-	if (d->divetrip)
-		diveLocations.push_back(QString(d->divetrip->location).trimmed());
-
-	if (d->dive_site)
-		diveLocations.push_back(QString(d->dive_site->name).trimmed());
-
-	return check(c, diveLocations);
+	for (const QString &item: QString(s).split(",", SKIP_EMPTY))
+		list.push_back(item.trimmed().toCaseFolded());
 }
 
-static bool has_weight_type(const filter_constraint &c, const struct dive *d)
+filter_dive_strings filter_constraint_get_dive_strings(const struct dive *d)
 {
-	QStringList weightsystemTypes;
+	filter_dive_strings res;
+	for (const tag_entry *tag = d->tag_list; tag; tag = tag->next)
+		add_folded_trimmed(res.tags, tag->tag->name);
+	add_folded_list(res.people, d->buddy);
+	add_folded_list(res.people, d->divemaster);
 	for (int i = 0; i < d->weightsystems.nr; ++i)
-		weightsystemTypes.push_back(d->weightsystems.weightsystems[i].description);
-
-	return check(c, weightsystemTypes);
+		add_folded(res.weight_types, d->weightsystems.weightsystems[i].description);
+	for (int i = 0; i < d->cylinders.nr; ++i)
+		add_folded(res.cylinder_types, d->cylinders.cylinders[i].type.description);
+	if (d->suit)
+		add_folded(res.suits, d->suit);
+	if (d->notes)
+		add_folded(res.notes, d->notes);
+	return res;
 }
 
-static bool has_cylinder_type(const filter_constraint &c, const struct dive *d)
+compiled_filter_constraint::compiled_filter_constraint(const filter_constraint &c_in) :
+	c(c_in), divemode_mask(0)
 {
-	QStringList cylinderTypes;
-	for (int i = 0; i < d->cylinders.nr; ++i)
-		cylinderTypes.push_back(d->cylinders.cylinders[i].type.description);
-
-	return check(c, cylinderTypes);
+	if (!filter_constraint_is_string(c.type))
+		return;
+	for (const QString &s: *c.data.string_list)
+		strings.push_back(s.toCaseFolded());
+
+	// The tags constraint also checks the dive mode. Translate the names only once.
+	if (c.type == FILTER_CONSTRAINT_TAGS) {
+		for (int i = 0; i < NUM_DIVEMODE; ++i) {
+			std::vector<QString> name { gettextFromC::tr(divemode_text_ui[i]).trimmed().toCaseFolded() };
+			if (check(*this, name))
+				divemode_mask |= 1ULL << i;
+		}
+	}
 }
 
-static bool has_suits(const filter_constraint &c, const struct dive *d)
+// Check the string constraints. The strings of the dive are taken from
+// the fulltext cache if available, otherwise they are generated.
+static bool check_strings(const compiled_filter_constraint &c, const struct dive *d)
 {
-	QStringList diveSuits;
-	if (d->suit)
-		diveSuits.push_back(QString(d->suit));
-	return check(c, diveSuits);
+	filter_dive_strings generated;
+	const filter_dive_strings *strings = fulltext_filter_strings(d);
+	if (!strings) {
+		generated = filter_constraint_get_dive_strings(d);
+		strings = &generated;
+	}
+
+	switch (c.c.type) {
+	case FILTER_CONSTRAINT_TAGS:
+		return ((c.divemode_mask & (1ULL << d->dc.divemode)) || check(c, strings->tags)) != c.c.negate;
+	case FILTER_CONSTRAINT_PEOPLE:
+		return check(c, strings->people) != c.c.negate;
+	case FILTER_CONSTRAINT_WEIGHT_TYPE:
+		return check(c, strings->weight_types) != c.c.negate;
+	case FILTER_CONSTRAINT_CYLINDER_TYPE:
+		return check(c, strings->cylinder_types) != c.c.negate;
+	case FILTER_CONSTRAINT_SUIT:
+		return check(c, strings->suits) != c.c.negate;
+	case FILTER_CONSTRAINT_NOTES:
+		return check(c, strings->notes) != c.c.negate;
+	default:
+		return false;
+	}
 }
 
-static bool has_notes(const filter_constraint &c, const struct dive *d)
+// Locations are not cached, since dive sites and trips can be edited
+// without touching the dive.
+static bool has_locations(const compiled_filter_constraint &c, const struct dive *d)
 {
-	QStringList diveNotes;
-	if (d->notes)
-		diveNotes.push_back(QString(d->notes));
-	return check(c, diveNotes);
+	std::vector<QString> diveLocations;
+	if (d->divetrip)
+		add_folded_trimmed(diveLocations, d->divetrip->location);
+
+	if (d->dive_site)
+		add_folded_trimmed(diveLocations, d->dive_site->name);
+
+	return check(c, diveLocations) != c.c.negate;
 }
 
 static bool check_numerical_range(const filter_constraint &c, int v)
@@ -1063,9 +1094,10 @@ static bool check_multiple_choice(const filter_constraint &c, int v)
 	return has_bit != c.negate;
 }
 
-bool filter_constraint_match_dive(const filter_constraint &c, const struct dive *d)
+bool filter_constraint_match_dive(const compiled_filter_constraint &cc, const struct dive *d)
 {
-	if (filter_constraint_is_string(c.type) && c.data.string_list->isEmpty())
+	const filter_constraint &c = cc.c;
+	if (filter_constraint_is_string(c.type) && cc.strings.empty())
 		return true;
 
 	switch (c.type) {
@@ -1112,15 +1144,14 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 	case FILTER_CONSTRAINT_DIVE_MODE:
 		return check_multiple_choice(c, (int)d->dc.divemode); // should we be smarter and check all DCs?
 	case FILTER_CONSTRAINT_TAGS:
-		return has_tags(c, d);
 	case FILTER_CONSTRAINT_PEOPLE:
-		return has_people(c, d);
-	case FILTER_CONSTRAINT_LOCATION:
-		return has_locations(c, d);
 	case FILTER_CONSTRAINT_WEIGHT_TYPE:
-		return has_weight_type(c, d);
 	case FILTER_CONSTRAINT_CYLINDER_TYPE:
-		return has_cylinder_type(c, d);
+	case FILTER_CONSTRAINT_SUIT:
+	case FILTER_CONSTRAINT_NOTES:
+		return check_strings(cc, d);
+	case FILTER_CONSTRAINT_LOCATION:
+		return has_locations(cc, d);
 	case FILTER_CONSTRAINT_CYLINDER_SIZE:
 		return check_cylinder_size(c, d);
 	case FILTER_CONSTRAINT_CYLINDER_N2:
@@ -1129,10 +1160,34 @@ bool filter_constraint_match_dive(const filter_constraint &c, const struct dive
 		return check_gas_range(c, d, O2);
 	case FILTER_CONSTRAINT_CYLINDER_HE:
 		return check_gas_range(c, d, HE);
-	case FILTER_CONSTRAINT_SUIT:
-		return has_suits(c, d);
-	case FILTER_CONSTRAINT_NOTES:
-		return has_notes(c, d);
 	}
 	return false;
 }
+
+struct match_dives_job {
+	const std::vector<compiled_filter_constraint> &constraints;
+	const FullTextResult *ft;
+	bool show_invalid;
+	std::vector<char> matches;
+};
+
+// Called by the worker threads of filter_constraints_match_dives()
+static void match_dives_range(int begin, int end, void *data)
+{
+	match_dives_job *job = (match_dives_job *)data;
+	for (int i = begin; i < end; ++i) {
+		const dive *d = dive_table.dives[i];
+		job->matches[i] = (job->show_invalid || !d->invalid) &&
+				  (!job->ft || job->ft->dive_matches(d)) &&
+				  std::all_of(job->constraints.begin(), job->constraints.end(),
+					      [d] (const compiled_filter_constraint &c) { return filter_constraint_match_dive(c, d); });
+	}
+}
+
+std::vector<char> filter_constraints_match_dives(const std::vector<compiled_filter_constraint> &constraints,
+						 const FullTextResult *ft, bool show_invalid)
+{
+	match_dives_job job { constraints, ft, show_invalid, std::vector<char>(dive_table.nr) };
+	parallel_for_ranges(dive_table.nr, &match_dives_range, &job);
+	return std::move(job.matches);
+}
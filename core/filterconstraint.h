@@ -10,6 +10,7 @@ struct dive;
 
 #ifdef __cplusplus
 #include <QStringList>
+#include <vector>
 extern "C" {
 #else
 typedef void QStringList;
@@ -151,7 +152,37 @@ void filter_constraint_set_float_to(filter_constraint &c, double to); // convert
 void filter_constraint_set_timestamp_from(filter_constraint &c, timestamp_t from); // convert according to current units (metric or imperial)
 void filter_constraint_set_timestamp_to(filter_constraint &c, timestamp_t to); // convert according to current units (metric or imperial)
 void filter_constraint_set_multiple_choice(filter_constraint &c, uint64_t);
-bool filter_constraint_match_dive(const filter_constraint &c, const struct dive *d);
+
+// The strings of a dive that are checked by the string constraints, case folded.
+// Tags and people are trimmed. For dives that are registered in the fulltext
+// index, these are cached with the fulltext words (see fulltext.h).
+struct filter_dive_strings {
+	std::vector<QString> tags;
+	std::vector<QString> people;
+	std::vector<QString> weight_types;
+	std::vector<QString> cylinder_types;
+	std::vector<QString> suits;
+	std::vector<QString> notes;
+};
+filter_dive_strings filter_constraint_get_dive_strings(const struct dive *d);
+
+// A filter constraint prepared for matching against many dives:
+// The search strings are case folded once and the dive modes matching
+// a tags constraint are collected in a bit-field.
+struct compiled_filter_constraint {
+	filter_constraint c;
+	std::vector<QString> strings; // case folded search strings
+	uint64_t divemode_mask; // for tags constraints: dive modes whose name matches
+	compiled_filter_constraint(const filter_constraint &c);
+};
+bool filter_constraint_match_dive(const compiled_filter_constraint &c, const struct dive *d);
+
+// Match all dives of the dive table against the constraints and, if given, the
+// result of a fulltext search. Invalid dives only match if show_invalid is set.
+// The dives are checked on all cores; returns one flag per dive.
+struct FullTextResult;
+std::vector<char> filter_constraints_match_dives(const std::vector<compiled_filter_constraint> &constraints,
+						 const FullTextResult *ft, bool show_invalid);
 #endif
 
 #endif
@@ -15,6 +15,11 @@ extern "C" int filter_presets_count(void)
 	return (int)filter_preset_table.size();
 }
 
+extern "C" int nr_filter_presets(const struct filter_preset_table *table)
+{
+	return (int)table->size();
+}
+
 extern "C" char *filter_preset_name(int preset)
 {
 	return copy_qstring(filter_preset_name_qstring(preset));
@@ -105,6 +110,22 @@ extern "C" void add_filter_preset_to_table(const struct filter_preset *preset, s
 	filter_preset_add_to_table(name, preset->data, *table);
 }
 
+extern "C" void add_filter_presets_to_table(const struct filter_preset_table *presets, struct filter_preset_table *table)
+{
+	for (const filter_preset &preset: *presets)
+		add_filter_preset_to_table(&preset, table);
+}
+
+extern "C" struct filter_preset_table *alloc_filter_preset_table()
+{
+	return new struct filter_preset_table;
+}
+
+extern "C" void free_filter_preset_table(struct filter_preset_table *table)
+{
+	delete table;
+}
+
 extern "C" void filter_preset_add_constraint(struct filter_preset *preset, const char *type, const char *string_mode,
 					     const char *range_mode, bool negate, const char *data)
 {
@@ -46,6 +46,7 @@ extern "C" {
 // The C IO code accesses the filter presets via integer indices.
 extern void clear_filter_presets(void);
 extern int filter_presets_count(void);
+extern int nr_filter_presets(const struct filter_preset_table *table);
 extern char *filter_preset_name(int preset); // name of filter preset - caller must free the result.
 extern char *filter_preset_fulltext_query(int preset); // fulltext query of filter preset - caller must free the result.
 extern const char *filter_preset_fulltext_mode(int preset); // string mode of fulltext query. ownership is *not* passed to caller.
@@ -56,6 +57,9 @@ extern void free_filter_preset(const struct filter_preset *preset);
 extern void filter_preset_set_name(struct filter_preset *preset, const char *name);
 extern void filter_preset_set_fulltext(struct filter_preset *preset, const char *fulltext, const char *fulltext_string_mode);
 extern void add_filter_preset_to_table(const struct filter_preset *preset, struct filter_preset_table *table);
+extern void add_filter_presets_to_table(const struct filter_preset_table *presets, struct filter_preset_table *table);
+extern struct filter_preset_table *alloc_filter_preset_table();
+extern void free_filter_preset_table(struct filter_preset_table *table);
 extern void filter_preset_add_constraint(struct filter_preset *preset, const char *type, const char *string_mode,
 					 const char *range_mode, bool negate, const char *data); // called by the parser, therefore data passed as strings.
 
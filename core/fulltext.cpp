@@ -3,20 +3,33 @@
 #include "fulltext.h"
 #include "dive.h"
 #include "divesite.h"
+#include "filterconstraint.h"
 #include "tag.h"
 #include "trip.h"
 #include "qthelper.h"
 #include <QLocale>
+#include <algorithm>
+#include <functional>
+#include <iterator>
 #include <map>
+#include <unordered_map>
 
-// This class caches each dives words, so that we can unregister a dive from the full text search
+// This class caches each dives words, so that we can unregister a dive from the full text search.
+// It also caches the strings checked by the filter constraints.
 struct full_text_cache {
 	std::vector<QString> words;
+	filter_dive_strings filter_strings;
 };
 
 // The FullText-search class
+// The dives of each word are kept sorted by address, so that the results for
+// the words of a query can be combined in linear time.
+// For substring searches, we also keep the words that contain each trigram
+// (three consecutive characters). Only the words that contain all trigrams
+// of the searched string have to be checked.
 class FullText {
 	std::map<QString, std::vector<dive *>> words; // Dives that belong to each word
+	std::unordered_map<uint64_t, std::vector<const QString *>> trigrams; // Words that contain each trigram, sorted by address
 public:
 	void populate(); // Rebuild from current dive_table
 	void registerDive(struct dive *d); // Note: can be called repeatedly
@@ -26,6 +39,9 @@ public:
 private:
 	void registerWords(struct dive *d, const std::vector<QString> &w);
 	void unregisterWords(struct dive *d, const std::vector<QString> &w);
+	void registerTrigrams(const QString *word);
+	void unregisterTrigrams(const QString *word);
+	std::vector<const QString *> findSubstringCandidates(const QString &s) const;
 	std::vector<dive *> findDives(const QString &s, StringFilterMode mode) const; // Find dives matching a given word.
 };
 
@@ -83,6 +99,11 @@ bool fulltext_dive_matches(const struct dive *d, const FullTextQuery &q, StringF
 	return false;
 }
 
+const filter_dive_strings *fulltext_filter_strings(const struct dive *d)
+{
+	return d->full_text ? &d->full_text->filter_strings : nullptr;
+}
+
 // Class implementation
 
 // Take a text and tokenize it into words. Normalize the words to upper case
@@ -163,6 +184,7 @@ void FullText::registerDive(struct dive *d)
 		d->full_text = new full_text_cache;
 	}
 	d->full_text->words = getWords(d);
+	d->full_text->filter_strings = filter_constraint_get_dive_strings(d);
 	registerWords(d, d->full_text->words);
 }
 
@@ -184,15 +206,63 @@ void FullText::unregisterAll()
 		d->full_text = nullptr;
 	}
 	words.clear();
+	trigrams.clear();
+}
+
+// Get the distinct trigrams of a string
+static std::vector<uint64_t> getTrigrams(const QString &s)
+{
+	std::vector<uint64_t> res;
+	for (int i = 0; i + 3 <= s.size(); ++i)
+		res.push_back(((uint64_t)s[i].unicode() << 32) | ((uint64_t)s[i + 1].unicode() << 16) | s[i + 2].unicode());
+	std::sort(res.begin(), res.end());
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+// The word lists of the trigrams are sorted by address, too
+static const std::less<const QString *> wordLess {};
+
+// Register a new word of the word-map. The map doesn't move its keys, so we can store pointers.
+void FullText::registerTrigrams(const QString *word)
+{
+	for (uint64_t trigram: getTrigrams(*word)) {
+		std::vector<const QString *> &entry = trigrams[trigram];
+		entry.insert(std::lower_bound(entry.begin(), entry.end(), word, wordLess), word);
+	}
+}
+
+void FullText::unregisterTrigrams(const QString *word)
+{
+	for (uint64_t trigram: getTrigrams(*word)) {
+		auto it = trigrams.find(trigram);
+		if (it == trigrams.end())
+			continue;
+		std::vector<const QString *> &entry = it->second;
+		auto it2 = std::lower_bound(entry.begin(), entry.end(), word, wordLess);
+		if (it2 != entry.end() && *it2 == word)
+			entry.erase(it2);
+		if (entry.empty())
+			trigrams.erase(it);
+	}
 }
 
+// The dive lists are sorted by address. Unlike <, std::less gives a total order of pointers.
+static const std::less<const dive *> diveLess {};
+
 // Register words of a dive.
 void FullText::registerWords(struct dive *d, const std::vector<QString> &w)
 {
 	for (const QString &word: w) {
-		std::vector<dive *> &entry = words[word];
-		if (std::find(entry.begin(), entry.end(), d) == entry.end())
-			entry.push_back(d);
+		auto wordIt = words.find(word);
+		if (wordIt == words.end()) {
+			wordIt = words.emplace(word, std::vector<dive *>()).first;
+			registerTrigrams(&wordIt->first);
+		}
+		std::vector<dive *> &entry = wordIt->second;
+		auto it = std::lower_bound(entry.begin(), entry.end(), d, diveLess);
+		if (it == entry.end() || *it != d)
+			entry.insert(it, d);
 	}
 }
 
@@ -206,19 +276,56 @@ void FullText::unregisterWords(struct dive *d, const std::vector<QString> &w)
 			continue;
 		}
 		std::vector<dive *> &entry = it->second;
-		entry.erase(std::remove(entry.begin(), entry.end(), d));
-		if (entry.empty())
+		auto it2 = std::lower_bound(entry.begin(), entry.end(), d, diveLess);
+		if (it2 != entry.end() && *it2 == d)
+			entry.erase(it2);
+		if (entry.empty()) {
+			unregisterTrigrams(&it->first);
 			words.erase(it);
+		}
 	}
 }
 
-// Add dives from second array to first, if not yet there
-void combineDives(std::vector<dive *> &to, const std::vector<dive *> &from)
+// Combine sorted lists of dives into one sorted list without duplicates
+static std::vector<dive *> combineDives(const std::vector<const std::vector<dive *> *> &lists)
+{
+	if (lists.empty())
+		return {};
+	if (lists.size() == 1)
+		return *lists[0];
+	size_t size = 0;
+	for (const std::vector<dive *> *list: lists)
+		size += list->size();
+	std::vector<dive *> res;
+	res.reserve(size);
+	for (const std::vector<dive *> *list: lists)
+		res.insert(res.end(), list->begin(), list->end());
+	std::sort(res.begin(), res.end(), diveLess);
+	res.erase(std::unique(res.begin(), res.end()), res.end());
+	return res;
+}
+
+// Find the words that contain all trigrams of a string of at least three characters
+std::vector<const QString *> FullText::findSubstringCandidates(const QString &s) const
 {
-	for (dive *d: from) {
-		if (std::find(to.begin(), to.end(), d) == to.end())
-			to.push_back(d);
+	std::vector<const std::vector<const QString *> *> lists;
+	for (uint64_t trigram: getTrigrams(s)) {
+		auto it = trigrams.find(trigram);
+		if (it == trigrams.end())
+			return {};
+		lists.push_back(&it->second);
+	}
+
+	// Start with the shortest list, to keep the intermediate results small
+	std::sort(lists.begin(), lists.end(), [](const std::vector<const QString *> *l1, const std::vector<const QString *> *l2)
+		  { return l1->size() < l2->size(); });
+	std::vector<const QString *> res = *lists[0];
+	for (size_t i = 1; i < lists.size() && !res.empty(); ++i) {
+		std::vector<const QString *> both;
+		std::set_intersection(res.begin(), res.end(), lists[i]->begin(), lists[i]->end(), std::back_inserter(both), wordLess);
+		res = std::move(both);
 	}
+	return res;
 }
 
 std::vector<dive *> FullText::findDives(const QString &s, StringFilterMode mode) const
@@ -236,25 +343,26 @@ std::vector<dive *> FullText::findDives(const QString &s, StringFilterMode mode)
 		// Find all words that start with a substring. We use the fact
 		// that these words must form a contiguous block, since the words are
 		// ordered lexicographically.
-		auto it = words.lower_bound(s);
-		if (it == words.end() || !it->first.startsWith(s))
-			return {};
-		std::vector<dive *> res = it->second;
-		++it;
-		while (it != words.end() && it->first.startsWith(s)) {
-			combineDives(res, it->second);
-			++it;
-		}
-		return res;
+		std::vector<const std::vector<dive *> *> lists;
+		for (auto it = words.lower_bound(s); it != words.end() && it->first.startsWith(s); ++it)
+			lists.push_back(&it->second);
+		return combineDives(lists);
 	}
 	case StringFilterMode::SUBSTRING: {
-		// Find all words that contain a substring. Here, we have to check all words!
-		std::vector<dive *> res;
-		for (auto it = words.begin(); it != words.end(); ++it) {
-			if (it->first.contains(s))
-				combineDives(res, it->second);
+		// Find all words that contain a substring. For short substrings, we have to check all words!
+		std::vector<const std::vector<dive *> *> lists;
+		if (s.size() < 3) {
+			for (auto it = words.begin(); it != words.end(); ++it) {
+				if (it->first.contains(s))
+					lists.push_back(&it->second);
+			}
+		} else {
+			for (const QString *word: findSubstringCandidates(s)) {
+				if (word->contains(s))
+					lists.push_back(&words.find(*word)->second);
+			}
 		}
-		return res;
+		return combineDives(lists);
 	}
 	}
 }
@@ -265,11 +373,12 @@ FullTextResult FullText::find(const FullTextQuery &q, StringFilterMode mode) con
 		return FullTextResult();
 
 	std::vector<dive *> res = findDives(q.words[0], mode);
-	for (size_t i = 1; i < q.words.size(); ++i) {
+	for (size_t i = 1; i < q.words.size() && !res.empty(); ++i) {
 		std::vector<dive *> res2 = findDives(q.words[i], mode);
-		// Remove dives from res that are not in res2
-		res.erase(std::remove_if(res.begin(), res.end(),
-				[&res2] (dive *d) { return std::find(res2.begin(), res2.end(), d) == res2.end(); }), res.end());
+		// Keep only the dives that are in both lists
+		std::vector<dive *> both;
+		std::set_intersection(res.begin(), res.end(), res2.begin(), res2.end(), std::back_inserter(both), diveLess);
+		res = std::move(both);
 	}
 
 	return { res };
@@ -290,5 +399,5 @@ bool FullTextQuery::doit() const
 
 bool FullTextResult::dive_matches(const struct dive *d) const
 {
-	return std::find(dives.begin(), dives.end(), d) != dives.end();
+	return std::binary_search(dives.begin(), dives.end(), d, diveLess);
 }
@@ -52,7 +52,7 @@ struct FullTextQuery {
 
 // Describes the result of a fulltext search
 struct FullTextResult {
-	std::vector<dive *> dives;
+	std::vector<dive *> dives; // sorted by address
 	bool dive_matches(const struct dive *d) const;
 };
 
@@ -62,5 +62,11 @@ struct FullTextResult {
 FullTextResult fulltext_find_dives(const FullTextQuery &q, StringFilterMode);
 bool fulltext_dive_matches(const struct dive *d, const FullTextQuery &q, StringFilterMode);
 
+// The cache is updated whenever a dive is edited. Therefore, it also keeps
+// the normalized strings used by the filter constraints.
+// Returns null if the dive is not registered.
+struct filter_dive_strings;
+const filter_dive_strings *fulltext_filter_strings(const struct dive *d);
+
 #endif
 #endif
@@ -5,6 +5,8 @@
 #include "git2.h"
 #include "filterpreset.h"
 
+struct dive;
+struct dive_trip;
 struct dive_table;
 struct dive_site_table;
 struct trip_table;
@@ -35,10 +37,13 @@ extern int git_save_dives(struct git_repository *, const char *, const char *rem
 extern int git_load_dives(struct git_repository *repo, const char *branch, struct dive_table *table, struct trip_table *trips,
 			  struct dive_site_table *sites, struct device_table *devices,
 			  struct filter_preset_table *filter_presets);
+extern bool load_git_dive_samples(struct dive *dive);
+extern void update_trip_git_sig(struct dive_trip *trip);
 extern const char *get_sha(git_repository *repo, const char *branch);
 extern int do_git_save(git_repository *repo, const char *branch, const char *remote, bool select_only, bool create_empty);
 extern const char *saved_git_id;
 extern bool git_local_only;
+extern bool git_parallel_load;
 extern bool git_remote_sync_successful;
 extern void clear_git_id(void);
 extern void set_git_id(const struct git_oid *);
@@ -25,11 +25,36 @@
 #include "membuffer.h"
 #include "git-access.h"
 #include "picture.h"
+#include "pref.h"
 #include "qthelper.h"
+#include "snapshot.h"
 #include "tag.h"
 #include "subsurface-time.h"
 
 const char *saved_git_id = NULL;
+bool git_parallel_load = true;
+
+/*
+ * When loading in parallel, the tree walk doesn't parse the
+ * divecomputer blobs (which contain the samples and make up
+ * the bulk of the data), but only queues them up. They are
+ * parsed after the walk by a number of worker threads.
+ */
+struct dc_load_job {
+	struct dive *dive;
+	struct divecomputer *dc;
+	git_oid id;
+	int o2pressure_sensor;
+	bool done;
+};
+
+struct dc_load_queue {
+	int nr, allocated;
+	struct dc_load_job *jobs;
+	struct device_table *devices;
+	const char *repo_path;
+	const char *samples_repo;
+};
 
 struct git_parser_state {
 	git_repository *repo;
@@ -52,6 +77,10 @@ struct git_parser_state {
 	struct device_table *devices;
 	struct filter_preset_table *filter_presets;
 	int o2pressure_sensor;
+	struct dc_load_queue *dc_queue;
+	struct dive_table pending_dives;
+	const char *samples_repo;
+	int summary_depth;
 };
 
 struct keyword_action {
@@ -531,85 +560,202 @@ report_error("Unmatched action '%s'", line);
 	return -1;
 }
 
-/* FIXME! We should do the array thing here too. */
-static void parse_sample_keyvalue(void *_sample, const char *key, const char *value)
+/*
+ * Sample lines make up most of a git repository, so they get a parser
+ * of their own: the numbers are plain ASCII, written by put_milli() and
+ * put_format(), and are parsed without going through strtod() or sscanf().
+ */
+static const char *parse_sample_int(const char *p, int *res)
 {
-	struct sample *sample = _sample;
+	unsigned int v = 0;
+	bool negative = *p == '-';
 
-	if (!strcmp(key, "sensor")) {
-		sample->sensor[0] = atoi(value);
-		return;
-	}
-	if (!strcmp(key, "ndl")) {
-		sample->ndl = get_duration(value);
-		return;
-	}
-	if (!strcmp(key, "tts")) {
-		sample->tts = get_duration(value);
-		return;
-	}
-	if (!strcmp(key, "in_deco")) {
-		sample->in_deco = atoi(value);
-		return;
-	}
-	if (!strcmp(key, "stoptime")) {
-		sample->stoptime = get_duration(value);
-		return;
-	}
-	if (!strcmp(key, "stopdepth")) {
-		sample->stopdepth = get_depth(value);
-		return;
-	}
-	if (!strcmp(key, "cns")) {
-		sample->cns = atoi(value);
-		return;
-	}
+	if (negative)
+		p++;
+	while (*p >= '0' && *p <= '9')
+		v = v * 10 + *p++ - '0';
+	*res = negative ? -v : v;
+	return p;
+}
 
-	if (!strcmp(key, "rbt")) {
-		sample->rbt = get_duration(value);
-		return;
-	}
+/* "m:ss", as in get_duration(). Negative values were saved as unsigned. */
+static const char *parse_sample_duration(const char *p, duration_t *res)
+{
+	unsigned int m = 0, s = 0;
 
-	if (!strcmp(key, "po2")) {
-		pressure_t p = get_pressure(value);
-		sample->setpoint.mbar = p.mbar;
-		return;
-	}
-	if (!strcmp(key, "sensor1")) {
-		pressure_t p = get_pressure(value);
-		sample->o2sensor[0].mbar = p.mbar;
-		return;
-	}
-	if (!strcmp(key, "sensor2")) {
-		pressure_t p = get_pressure(value);
-		sample->o2sensor[1].mbar = p.mbar;
-		return;
-	}
-	if (!strcmp(key, "sensor3")) {
-		pressure_t p = get_pressure(value);
-		sample->o2sensor[2].mbar = p.mbar;
-		return;
+	while (*p >= '0' && *p <= '9')
+		m = m * 10 + *p++ - '0';
+	if (*p == ':') {
+		p++;
+		while (*p >= '0' && *p <= '9')
+			s = s * 10 + *p++ - '0';
 	}
-	if (!strcmp(key, "o2pressure")) {
-		pressure_t p = get_pressure(value);
-		sample->pressure[1].mbar = p.mbar;
-		return;
+	res->seconds = m * 60 + s;
+	return p;
+}
+
+/*
+ * A value with at most three decimals, in thousandths. Returns NULL
+ * for anything that put_milli() doesn't write, which is left to
+ * ascii_strtod().
+ */
+static const char *parse_sample_milli(const char *p, int *res)
+{
+	unsigned int v = 0;
+	int digits = 0, decimals = 0;
+	bool negative = *p == '-';
+
+	if (negative)
+		p++;
+	while (*p >= '0' && *p <= '9') {
+		if (++digits > 6)
+			return NULL;
+		v = v * 10 + *p++ - '0';
+	}
+	if (*p == '.') {
+		p++;
+		while (*p >= '0' && *p <= '9') {
+			if (++decimals > 3)
+				return NULL;
+			v = v * 10 + *p++ - '0';
+		}
 	}
-	if (!strcmp(key, "heartbeat")) {
-		sample->heartbeat = atoi(value);
-		return;
+	if (!digits && !decimals)
+		return NULL;
+	if (*p == 'e' || *p == 'E')
+		return NULL;
+	while (decimals++ < 3)
+		v *= 10;
+	*res = negative ? -(int)v : (int)v;
+	return p;
+}
+
+static int get_sample_milli(const char *value)
+{
+	int milli;
+
+	if (!parse_sample_milli(value, &milli))
+		milli = lrint(1000 * ascii_strtod(value, NULL));
+	return milli;
+}
+
+static int get_sample_int(const char *value)
+{
+	int i;
+	parse_sample_int(value, &i);
+	return i;
+}
+
+static duration_t get_sample_duration(const char *value)
+{
+	duration_t d;
+	parse_sample_duration(value, &d);
+	return d;
+}
+
+static void parse_sample_bearing(const char *value, struct sample *sample)
+{ sample->bearing.degrees = get_sample_int(value); }
+
+static void parse_sample_cns(const char *value, struct sample *sample)
+{ sample->cns = get_sample_int(value); }
+
+static void parse_sample_heartbeat(const char *value, struct sample *sample)
+{ sample->heartbeat = get_sample_int(value); }
+
+static void parse_sample_in_deco(const char *value, struct sample *sample)
+{ sample->in_deco = get_sample_int(value); }
+
+static void parse_sample_ndl(const char *value, struct sample *sample)
+{ sample->ndl = get_sample_duration(value); }
+
+static void parse_sample_o2pressure(const char *value, struct sample *sample)
+{ sample->pressure[1].mbar = get_sample_milli(value); }
+
+static void parse_sample_po2(const char *value, struct sample *sample)
+{ sample->setpoint.mbar = get_sample_milli(value); }
+
+static void parse_sample_rbt(const char *value, struct sample *sample)
+{ sample->rbt = get_sample_duration(value); }
+
+static void parse_sample_sensor(const char *value, struct sample *sample)
+{ sample->sensor[0] = get_sample_int(value); }
+
+static void parse_sample_sensor1(const char *value, struct sample *sample)
+{ sample->o2sensor[0].mbar = get_sample_milli(value); }
+
+static void parse_sample_sensor2(const char *value, struct sample *sample)
+{ sample->o2sensor[1].mbar = get_sample_milli(value); }
+
+static void parse_sample_sensor3(const char *value, struct sample *sample)
+{ sample->o2sensor[2].mbar = get_sample_milli(value); }
+
+static void parse_sample_stopdepth(const char *value, struct sample *sample)
+{ sample->stopdepth.mm = get_sample_milli(value); }
+
+static void parse_sample_stoptime(const char *value, struct sample *sample)
+{ sample->stoptime = get_sample_duration(value); }
+
+static void parse_sample_tts(const char *value, struct sample *sample)
+{ sample->tts = get_sample_duration(value); }
+
+struct sample_keyword {
+	const char *keyword;
+	void (*fn)(const char *, struct sample *);
+};
+
+#define S(x) { #x, parse_sample_ ## x }
+/* These need to be sorted! */
+static const struct sample_keyword sample_keywords[] = {
+	S(bearing), S(cns), S(heartbeat), S(in_deco), S(ndl), S(o2pressure), S(po2), S(rbt),
+	S(sensor), S(sensor1), S(sensor2), S(sensor3), S(stopdepth), S(stoptime), S(tts)
+};
+#undef S
+
+/* Parse a key=val part of a sample, in place like parse_keyvalue_entry() */
+static char *parse_sample_keyvalue(struct sample *sample, char *line)
+{
+	char *key = line, *value, c;
+	unsigned low, high;
+
+	while ((c = *line) != 0) {
+		if (isspace(c) || c == '=')
+			break;
+		line++;
 	}
-	if (!strcmp(key, "bearing")) {
-		sample->bearing.degrees = atoi(value);
-		return;
+	if (c == '=')
+		*line++ = 0;
+	value = line;
+	while ((c = *line) != 0) {
+		if (isspace(c))
+			break;
+		line++;
 	}
+	if (c)
+		*line++ = 0;
 
+	/* Same binary search as in match_action() */
+	low = 0;
+	high = ARRAY_SIZE(sample_keywords);
+	while (low < high) {
+		unsigned mid = (low + high) / 2;
+		const struct sample_keyword *k = sample_keywords + mid;
+		int cmp = strcmp(key, k->keyword);
+		if (!cmp) {
+			k->fn(value, sample);
+			return line;
+		}
+		if (cmp < 0)
+			high = mid;
+		else
+			low = mid + 1;
+	}
 	report_error("Unexpected sample key/value pair (%s/%s)", key, value);
+	return line;
 }
 
-static char *parse_sample_unit(struct sample *sample, double val, char *unit)
+static char *parse_sample_unit(struct sample *sample, int milli, char *unit)
 {
-	unsigned int sensor;
+	int sensor;
 	char *end = unit, c;
 
 	/* Skip over the unit */
@@ -625,16 +771,16 @@ static char *parse_sample_unit(struct sample *sample, double val, char *unit)
 	/* The cylinder pressure may also be of the form '123.0bar:4' to indicate sensor */
 	switch (*unit) {
 	case 'm':
-		sample->depth.mm = lrint(1000 * val);
+		sample->depth.mm = milli;
 		break;
 	case 'b':
 		sensor = sample->sensor[0];
 		if (end > unit + 4 && unit[3] == ':')
-			sensor = atoi(unit + 4);
-		add_sample_pressure(sample, sensor, lrint(1000 * val));
+			parse_sample_int(unit + 4, &sensor);
+		add_sample_pressure(sample, sensor, milli);
 		break;
 	default:
-		sample->temperature.mkelvin = C_to_mkelvin(val);
+		sample->temperature.mkelvin = milli + ZERO_C_IN_MKELVIN;
 		break;
 	}
 
@@ -669,30 +815,37 @@ static uint8_t sanitize_sensor_id(const struct dive *d, int nr)
  */
 static struct sample *new_sample(struct git_parser_state *state)
 {
-	struct sample *sample = prepare_sample(state->active_dc);
-	if (sample != state->active_dc->sample) {
-		memcpy(sample, sample - 1, sizeof(struct sample));
-		sample->pressure[0].mbar = 0;
-		sample->pressure[1].mbar = 0;
-	} else {
+	struct divecomputer *dc = state->active_dc;
+	struct sample *sample;
+
+	if (!dc->samples) {
+		sample = prepare_sample(dc);
 		sample->sensor[0] = sanitize_sensor_id(state->active_dive, !state->o2pressure_sensor);
 		sample->sensor[1] = sanitize_sensor_id(state->active_dive, state->o2pressure_sensor);
+		return sample;
 	}
+
+	/* No need to let prepare_sample() initialize what we overwrite anyway */
+	alloc_samples(dc, dc->samples + 1);
+	sample = dc->sample + dc->samples;
+	*sample = sample[-1];
+	sample->pressure[0].mbar = 0;
+	sample->pressure[1].mbar = 0;
 	return sample;
 }
 
 static void sample_parser(char *line, struct git_parser_state *state)
 {
-	int m, s = 0;
 	struct sample *sample = new_sample(state);
 
-	m = strtol(line, &line, 10);
-	if (*line == ':')
-		s = strtol(line + 1, &line, 10);
-	sample->time.seconds = m * 60 + s;
+	while (isspace(*line))
+		line++;
+	line = (char *)parse_sample_duration(line, &sample->time);
 
 	for (;;) {
 		char c;
+		const char *end;
+		int milli;
 
 		while (isspace(c = *line))
 			line++;
@@ -700,21 +853,73 @@ static void sample_parser(char *line, struct git_parser_state *state)
 			break;
 		/* Less common sample entries have a name */
 		if (c >= 'a' && c <= 'z') {
-			line = parse_keyvalue_entry(parse_sample_keyvalue, sample, line, NULL);
-		} else {
-			const char *end;
+			line = parse_sample_keyvalue(sample, line);
+			continue;
+		}
+		end = parse_sample_milli(line, &milli);
+		if (!end) {
 			double val = ascii_strtod(line, &end);
 			if (end == line) {
 				report_error("Odd sample data: %s", line);
 				break;
 			}
-			line = (char *)end;
-			line = parse_sample_unit(sample, val, line);
+			milli = lrint(1000 * val);
 		}
+		line = parse_sample_unit(sample, milli, (char *)end);
 	}
 	finish_sample(state->active_dc);
 }
 
+/*
+ * When the samples are loaded lazily, only what get_sample_count(),
+ * get_first_sample_time() and dc_totaltime() need is taken from the
+ * sample lines: the time and, if it is given, the depth. Like the
+ * other values, the depth stays the same until a sample changes it.
+ */
+static void sample_summary_parser(const char *line, struct git_parser_state *state)
+{
+	struct samples_summary *summary = &state->active_dc->unloaded_samples;
+	duration_t time;
+	const char *end;
+	int milli;
+
+	while (isspace(*line))
+		line++;
+	line = parse_sample_duration(line, &time);
+	while (isspace(*line))
+		line++;
+	end = parse_sample_milli(line, &milli);
+	if (!end) {
+		double val = ascii_strtod(line, &end);
+		milli = lrint(1000 * val);
+	}
+	if (end != line && *end == 'm')
+		state->summary_depth = milli;
+
+	if (!summary->nr++)
+		summary->first_time = summary->totaltime = time.seconds;
+	if (state->summary_depth >= SURFACE_THRESHOLD)
+		summary->totaltime = time.seconds;
+}
+
+/*
+ * All lines of a dive computer file except for the few header lines are
+ * samples, so the number of lines is a close upper bound of the number of
+ * samples. Allocating them up front avoids growing the sample array.
+ */
+static void reserve_sample_lines(git_blob *blob, struct divecomputer *dc)
+{
+	const char *content = git_blob_rawcontent(blob);
+	const char *end = content + git_blob_rawsize(blob);
+	int lines = 0;
+
+	while ((content = memchr(content, '\n', end - content)) != NULL) {
+		content++;
+		lines++;
+	}
+	reserve_samples(dc, dc->samples + lines + 1);
+}
+
 static void parse_dc_airtemp(char *line, struct membuffer *str, struct git_parser_state *state)
 { UNUSED(str); state->active_dc->airtemp = get_temperature(line); }
 
@@ -1048,13 +1253,29 @@ struct keyword_action dc_action[] = {
 	D(salinity), D(surfacepressure), D(surfacetime), D(time), D(watertemp)
 };
 
-/* Sample lines start with a space or a number */
+/*
+ * Sample lines start with a space or a number.
+ * If the samples are loaded lazily, they are only summarized here.
+ */
 static void divecomputer_parser(char *line, struct membuffer *str, struct git_parser_state *state)
 {
+	char c = *line;
+	if (c < 'a' || c > 'z') {
+		if (state->samples_repo)
+			sample_summary_parser(line, state);
+		else
+			sample_parser(line, state);
+	}
+	match_action(line, str, state, dc_action, ARRAY_SIZE(dc_action));
+}
+
+/* When lazily loading the samples, we are only interested in sample lines */
+static void divecomputer_samples_parser(char *line, struct membuffer *str, struct git_parser_state *state)
+{
+	UNUSED(str);
 	char c = *line;
 	if (c < 'a' || c > 'z')
 		sample_parser(line, state);
-	match_action(line, str, state, dc_action, ARRAY_SIZE(dc_action));
 }
 
 /* These need to be sorted! */
@@ -1359,17 +1580,25 @@ static void finish_active_trip(struct git_parser_state *state)
 
 	if (trip) {
 		state->active_trip = NULL;
+		update_trip_git_sig(trip);
 		insert_trip(trip, state->trips);
 	}
 }
 
+/*
+ * If the divecomputers of the dive are still queued for parsing, we
+ * can't fix up the dive yet. Keep it around until the queue is done.
+ */
 static void finish_active_dive(struct git_parser_state *state)
 {
 	struct dive *dive = state->active_dive;
 
 	if (dive) {
 		state->active_dive = NULL;
-		record_dive_to_table(dive, state->table);
+		if (state->dc_queue)
+			add_to_dive_table(&state->pending_dives, state->pending_dives.nr, dive);
+		else
+			record_dive_to_table(dive, state->table);
 	}
 }
 
@@ -1401,7 +1630,7 @@ static bool validate_time(int h, int m, int s)
 /*
  * Dive trip directory, name is 'nn-alphabetic[~hex]'
  */
-static int dive_trip_directory(const char *root, const char *name, struct git_parser_state *state)
+static int dive_trip_directory(const char *root, const git_tree_entry *entry, const char *name, struct git_parser_state *state)
 {
 	int yyyy = -1, mm = -1, dd = -1;
 
@@ -1412,6 +1641,7 @@ static int dive_trip_directory(const char *root, const char *name, struct git_pa
 		return GIT_WALK_SKIP;
 	finish_active_trip(state);
 	state->active_trip = alloc_trip();
+	memcpy(state->active_trip->git_id, git_tree_entry_id(entry)->id, 20);
 	return GIT_WALK_OK;
 }
 
@@ -1608,7 +1838,7 @@ static int walk_tree_directory(const char *root, const git_tree_entry *entry, st
 	if (digits != 2)
 		return GIT_WALK_SKIP;
 
-	return dive_trip_directory(root, name, state);
+	return dive_trip_directory(root, entry, name, state);
 }
 
 static git_blob *git_tree_entry_blob(git_repository *repo, const git_tree_entry *entry)
@@ -1640,6 +1870,38 @@ static struct divecomputer *create_new_dc(struct dive *dive)
 	return dc;
 }
 
+/*
+ * Remember where the samples of a dive computer can be found,
+ * so that they can be loaded when they are needed.
+ */
+static void set_samples_blob(struct git_parser_state *state, struct divecomputer *dc, const git_oid *id)
+{
+	if (!state->samples_repo || !dc)
+		return;
+	dc->samples_repo = state->samples_repo;
+	memcpy(dc->samples_git_id, id->id, 20);
+}
+
+static void queue_divecomputer_entry(struct git_parser_state *state, const git_tree_entry *entry)
+{
+	struct dc_load_queue *queue = state->dc_queue;
+	struct dc_load_job *job;
+
+	if (queue->nr >= queue->allocated) {
+		queue->allocated = (queue->nr + 32) * 3 / 2;
+		queue->jobs = realloc(queue->jobs, queue->allocated * sizeof(struct dc_load_job));
+		if (!queue->jobs)
+			exit(1);
+	}
+	job = queue->jobs + queue->nr++;
+	job->dive = state->active_dive;
+	job->dc = create_new_dc(state->active_dive);
+	git_oid_cpy(&job->id, git_tree_entry_id(entry));
+	job->o2pressure_sensor = state->o2pressure_sensor;
+	job->done = false;
+	set_samples_blob(state, job->dc, &job->id);
+}
+
 /*
  * We should *really* try to delay the dive computer data parsing
  * until necessary, in order to reduce load-time. The parsing is
@@ -1649,18 +1911,92 @@ static struct divecomputer *create_new_dc(struct dive *dive)
 static int parse_divecomputer_entry(struct git_parser_state *state, const git_tree_entry *entry, const char *suffix)
 {
 	UNUSED(suffix);
-	git_blob *blob = git_tree_entry_blob(state->repo, entry);
+	git_blob *blob;
+
+	if (state->dc_queue) {
+		queue_divecomputer_entry(state, entry);
+		return 0;
+	}
 
+	blob = git_tree_entry_blob(state->repo, entry);
 	if (!blob)
 		return report_error("Unable to read divecomputer file");
 
 	state->active_dc = create_new_dc(state->active_dive);
+	set_samples_blob(state, state->active_dc, git_tree_entry_id(entry));
+	if (!state->samples_repo)
+		reserve_sample_lines(blob, state->active_dc);
+	state->summary_depth = 0;
 	for_each_line(blob, divecomputer_parser, state);
 	git_blob_free(blob);
 	state->active_dc = NULL;
 	return 0;
 }
 
+static void parse_queued_divecomputer(struct git_parser_state *state, struct dc_load_job *job)
+{
+	git_blob *blob;
+
+	if (git_blob_lookup(&blob, state->repo, &job->id)) {
+		report_error("Unable to read divecomputer file");
+	} else {
+		state->active_dive = job->dive;
+		state->active_dc = job->dc;
+		state->o2pressure_sensor = job->o2pressure_sensor;
+		if (!state->samples_repo)
+			reserve_sample_lines(blob, state->active_dc);
+		state->summary_depth = 0;
+		for_each_line(blob, divecomputer_parser, state);
+		git_blob_free(blob);
+		state->active_dive = NULL;
+		state->active_dc = NULL;
+	}
+	job->done = true;
+}
+
+/*
+ * Worker for a range of the divecomputer queue. libgit2 repository
+ * objects must not be shared between threads, therefore every worker
+ * opens the repository on its own and uses its own parser state.
+ * If that fails, the jobs are left for the main thread.
+ */
+static void parse_divecomputer_range(int begin, int end, void *data)
+{
+	struct dc_load_queue *queue = data;
+	struct git_parser_state state = { 0 };
+
+	if (git_repository_open(&state.repo, queue->repo_path))
+		return;
+	state.devices = queue->devices;
+	state.samples_repo = queue->samples_repo;
+	for (int i = begin; i < end; i++)
+		parse_queued_divecomputer(&state, queue->jobs + i);
+	git_repository_free(state.repo);
+}
+
+static void parse_divecomputer_queue(struct git_parser_state *state)
+{
+	struct dc_load_queue *queue = state->dc_queue;
+	int i;
+
+	queue->devices = state->devices;
+	queue->repo_path = git_repository_path(state->repo);
+	queue->samples_repo = state->samples_repo;
+	parallel_for_ranges(queue->nr, parse_divecomputer_range, queue);
+
+	/* Whatever the workers couldn't do, we do ourselves */
+	for (i = 0; i < queue->nr; i++) {
+		if (!queue->jobs[i].done)
+			parse_queued_divecomputer(state, queue->jobs + i);
+	}
+
+	/* Now the dives are complete and can be fixed up */
+	for (i = 0; i < state->pending_dives.nr; i++)
+		record_dive_to_table(state->pending_dives.dives[i], state->table);
+	free(state->pending_dives.dives);
+	memset(&state->pending_dives, 0, sizeof(state->pending_dives));
+}
+
 /*
  * NOTE! The "git_id" for the dive is the hash for the whole dive directory.
  * As such, it covers not just the dive, but the divecomputers and the
@@ -1822,7 +2158,17 @@ static int walk_tree_cb(const char *root, const git_tree_entry *entry, void *pay
 
 static int load_dives_from_tree(git_repository *repo, git_tree *tree, struct git_parser_state *state)
 {
+	struct dc_load_queue queue = { 0 };
+
+	if (git_parallel_load)
+		state->dc_queue = &queue;
 	git_tree_walk(tree, GIT_TREEWALK_PRE, walk_tree_cb, state);
+	if (state->dc_queue) {
+		finish_active_dive(state);
+		parse_divecomputer_queue(state);
+		state->dc_queue = NULL;
+	}
+	free(queue.jobs);
 	return 0;
 }
 
@@ -1884,6 +2230,96 @@ const char *get_sha(git_repository *repo, const char *branch)
 	return git_id_buffer;
 }
 
+/*
+ * Dive computers with lazily loaded samples remember the repository
+ * they came from. These strings are shared and never freed.
+ */
+static const char *intern_repo_path(const char *path)
+{
+	static char **paths;
+	static int nr;
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		if (!strcmp(paths[i], path))
+			return paths[i];
+	}
+	paths = realloc(paths, (nr + 1) * sizeof(char *));
+	if (!paths)
+		exit(1);
+	paths[nr] = strdup(path);
+	return paths[nr++];
+}
+
+/* Same logic as in parse_dive_cylinder(): the last oxygen cylinder wins */
+static int get_o2pressure_sensor(const struct dive *dive)
+{
+	int i, sensor = 1;
+
+	for (i = 0; i < dive->cylinders.nr; i++) {
+		if (dive->cylinders.cylinders[i].cylinder_use == OXYGEN)
+			sensor = i;
+	}
+	return sensor;
+}
+
+static bool load_dc_samples(git_repository *repo, struct dive *dive, struct divecomputer *dc)
+{
+	struct git_parser_state state = { 0 };
+	git_blob *blob;
+	git_oid id;
+
+	git_oid_fromraw(&id, dc->samples_git_id);
+	if (git_blob_lookup(&blob, repo, &id)) {
+		report_error("Unable to read divecomputer file");
+		return false;
+	}
+
+	/* Get rid of anything that was faked up in the meantime. This
+	 * also forgets about the repository and the samples summary. */
+	free_samples(dc);
+	state.repo = repo;
+	state.active_dive = dive;
+	state.active_dc = dc;
+	state.o2pressure_sensor = get_o2pressure_sensor(dive);
+	reserve_sample_lines(blob, dc);
+	for_each_line(blob, divecomputer_samples_parser, &state);
+	git_blob_free(blob);
+	return true;
+}
+
+/*
+ * With the lazy_samples preference, the samples of the dive computers are only
+ * read from the repository when they are first needed. Returns true
+ * if any samples were loaded, in which case the dive has to be fixed
+ * up again.
+ */
+bool load_git_dive_samples(struct dive *dive)
+{
+	git_repository *repo = NULL;
+	const char *repo_path = NULL;
+	struct divecomputer *dc;
+	bool loaded = false;
+
+	for_each_dc (dive, dc) {
+		if (!dc->samples_repo)
+			continue;
+		if (dc->samples_repo != repo_path) {
+			git_repository_free(repo);
+			repo = NULL;
+			repo_path = dc->samples_repo;
+			if (git_repository_open(&repo, repo_path)) {
+				report_error("Unable to open git repository at '%s'", repo_path);
+				repo = NULL;
+			}
+		}
+		if (repo && load_dc_samples(repo, dive, dc))
+			loaded = true;
+	}
+	git_repository_free(repo);
+	return loaded;
+}
+
 /*
  * Like git_save_dives(), this silently returns a negative
  * value if it's not a git repository at all (so that you
@@ -1896,6 +2332,7 @@ int git_load_dives(struct git_repository *repo, const char *branch, struct dive_
 		   struct dive_site_table *sites, struct device_table *devices, struct filter_preset_table *filter_presets)
 {
 	int ret;
+	char *snapshot_key = NULL, *snapshot_source = NULL;
 	struct git_parser_state state = { 0 };
 	state.repo = repo;
 	state.table = table;
@@ -1906,10 +2343,32 @@ int git_load_dives(struct git_repository *repo, const char *branch, struct dive_
 
 	if (repo == dummy_git_repository)
 		return report_error("Unable to open git repository at '%s'", branch);
-	ret = do_git_load(repo, branch, &state);
+	if (prefs.lazy_samples)
+		state.samples_repo = intern_repo_path(git_repository_path(repo));
+	if (snapshot_applies(table, trips, sites, devices, filter_presets)) {
+		const char *sha = get_sha(repo, branch);
+		if (sha) {
+			snapshot_key = strdup(sha);
+			snapshot_source = format_string("%s[%s]", git_repository_path(repo), branch);
+		}
+	}
+	if (snapshot_key && !load_snapshot(snapshot_source, snapshot_key, intern_repo_path(git_repository_path(repo)),
+					   table, trips, sites, devices)) {
+		git_oid id;
+		git_oid_fromstr(&id, snapshot_key);
+		set_git_id(&id);
+		git_storage_update_progress(translate("gettextFromC", "Successfully opened dive data"));
+		ret = 0;
+	} else {
+		ret = do_git_load(repo, branch, &state);
+		finish_active_dive(&state);
+		finish_active_trip(&state);
+		if (snapshot_key && !ret)
+			save_snapshot(snapshot_source, snapshot_key, table, trips, sites, devices, filter_presets);
+	}
+	free(snapshot_key);
+	free(snapshot_source);
 	git_repository_free(repo);
 	free((void *)branch);
-	finish_active_dive(&state);
-	finish_active_trip(&state);
 	return ret;
 }
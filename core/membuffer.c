@@ -4,13 +4,18 @@
 #pragma clang diagnostic ignored "-Wmissing-field-initializers"
 #endif
 
+#include <errno.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "units.h"
 #include "membuffer.h"
+#include "file.h"
+#include "errorhelper.h"
+#include "gettext.h"
 
 /* Only for internal use */
 static char *detach_buffer(struct membuffer *b)
@@ -62,6 +67,11 @@ static void oom(void)
 void make_room(struct membuffer *b, unsigned int size)
 {
 	unsigned int needed = b->len + size;
+	if (b->sink && b->len && needed > MEMBUFFER_SINK_SIZE) {
+		fwrite(b->buffer, 1, b->len, b->sink);
+		b->len = 0;
+		needed = size;
+	}
 	if (needed > b->alloc) {
 		char *n;
 		/* round it up to not reallocate all the time.. */
@@ -74,6 +84,75 @@ void make_room(struct membuffer *b, unsigned int size)
 	}
 }
 
+int mb_open_file(struct membuffer *b, const char *filename)
+{
+	char *tmp;
+
+	if (!strcmp(filename, "-")) {
+		b->sink = stdout;
+		return 0;
+	}
+	tmp = format_string("%s.tmp", filename);
+	b->sink = subsurface_fopen(tmp, "w");
+	free(tmp);
+	return b->sink ? 0 : -1;
+}
+
+int mb_close_file(struct membuffer *b, const char *filename, void (*backup)(const char *filename))
+{
+	FILE *f = b->sink;
+	char *tmp;
+	int error = 0, saved_errno;
+
+	b->sink = NULL;
+	if (!f) {
+		free_buffer(b);
+		return -1;
+	}
+	flush_buffer(b, f);
+	free_buffer(b);
+	if (ferror(f))
+		error = -1;
+	if (fclose(f))
+		error = -1;
+	if (f == stdout)
+		return error;
+
+	tmp = format_string("%s.tmp", filename);
+	if (!error) {
+		if (backup)
+			backup(filename);
+		if (!subsurface_rename(tmp, filename)) {
+			free(tmp);
+			return 0;
+		}
+#ifdef WIN32
+		/*
+		 * Windows doesn't replace existing files when renaming. If
+		 * the rename fails even without the old file, the temporary
+		 * file is all that's left, so keep it and tell the user.
+		 */
+		if (!unlink(filename)) {
+			if (!subsurface_rename(tmp, filename)) {
+				free(tmp);
+				return 0;
+			}
+			saved_errno = errno;
+			report_error(translate("gettextFromC", "Failed to replace %s, the data was saved to %s"), filename, tmp);
+			errno = saved_errno;
+			free(tmp);
+			return -1;
+		}
+#endif
+		error = -1;
+	}
+	saved_errno = errno;
+	unlink(tmp);
+	errno = saved_errno;
+	free(tmp);
+	return error;
+}
+
 const char *mb_cstring(struct membuffer *b)
 {
 	make_room(b, 1);
@@ -168,30 +247,84 @@ void put_format_loc(struct membuffer *b, const char *fmt, ...)
 	va_end(args);
 }
 
+/*
+ * Write the digits of a number backwards, ending at "end", and return
+ * the first character. The buffer must have room for at least 10 digits.
+ */
+static char *format_uint(char *end, unsigned int value)
+{
+	do {
+		*--end = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	return end;
+}
+
+void put_padded_uint(struct membuffer *b, unsigned int value, int width, char pad)
+{
+	char buf[32], *end = buf + sizeof(buf);
+	char *p = format_uint(end, value);
+
+	while (end - p < width && p > buf)
+		*--p = pad;
+	put_bytes(b, p, end - p);
+}
+
+void put_uint(struct membuffer *b, unsigned int value)
+{
+	char buf[16], *end = buf + sizeof(buf);
+	char *p = format_uint(end, value);
+
+	put_bytes(b, p, end - p);
+}
+
+void put_int(struct membuffer *b, int value)
+{
+	char buf[16], *end = buf + sizeof(buf);
+	char *p = format_uint(end, value < 0 ? 0u - value : (unsigned int)value);
+
+	if (value < 0)
+		*--p = '-';
+	put_bytes(b, p, end - p);
+}
+
+void put_min_sec(struct membuffer *b, const char *pre, unsigned int seconds, const char *post)
+{
+	char buf[16], *end = buf + sizeof(buf);
+	char *p = format_uint(end, seconds % 60);
+
+	if (seconds % 60 < 10)
+		*--p = '0';
+	*--p = ':';
+	p = format_uint(p, seconds / 60);
+	put_string(b, pre);
+	put_bytes(b, p, end - p);
+	put_string(b, post);
+}
+
 void put_milli(struct membuffer *b, const char *pre, int value, const char *post)
 {
-	int i;
-	char buf[4];
-	const char *sign = "";
-	unsigned v;
-
-	v = value;
-	if (value < 0) {
-		sign = "-";
-		v = -value;
-	}
-	for (i = 2; i >= 0; i--) {
-		buf[i] = (v % 10) + '0';
-		v /= 10;
+	char buf[16], *end = buf + sizeof(buf), *p = end;
+	unsigned int v = value < 0 ? 0u - value : (unsigned int)value;
+	unsigned int fraction = v % 1000;
+	int digits = 3;
+
+	/* Trailing zeroes are dropped, but there is at least one decimal */
+	while (digits > 1 && fraction % 10 == 0) {
+		fraction /= 10;
+		digits--;
 	}
-	buf[3] = 0;
-	if (buf[2] == '0') {
-		buf[2] = 0;
-		if (buf[1] == '0')
-			buf[1] = 0;
+	while (digits--) {
+		*--p = '0' + fraction % 10;
+		fraction /= 10;
 	}
-
-	put_format(b, "%s%s%u.%s%s", pre, sign, v, buf, post);
+	*--p = '.';
+	p = format_uint(p, v / 1000);
+	if (value < 0)
+		*--p = '-';
+	put_string(b, pre);
+	put_bytes(b, p, end - p);
+	put_string(b, post);
 }
 
 void put_temperature(struct membuffer *b, temperature_t temp, const char *pre, const char *post)
@@ -209,7 +342,7 @@ void put_depth(struct membuffer *b, depth_t depth, const char *pre, const char *
 void put_duration(struct membuffer *b, duration_t duration, const char *pre, const char *post)
 {
 	if (duration.seconds)
-		put_format(b, "%s%u:%02u%s", pre, FRACTION(duration.seconds, 60), post);
+		put_min_sec(b, pre, duration.seconds, post);
 }
 
 void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, const char *post)
@@ -220,20 +353,32 @@ void put_pressure(struct membuffer *b, pressure_t pressure, const char *pre, con
 
 void put_salinity(struct membuffer *b, int salinity, const char *pre, const char *post)
 {
-	if (salinity)
-		put_format(b, "%s%d%s", pre, salinity / 10, post);
+	if (salinity) {
+		put_string(b, pre);
+		put_int(b, salinity / 10);
+		put_string(b, post);
+	}
 }
 
 void put_degrees(struct membuffer *b, degrees_t value, const char *pre, const char *post)
 {
-	int udeg = value.udeg;
-	const char *sign = "";
+	char buf[32], *end = buf + sizeof(buf), *p;
+	unsigned int udeg = value.udeg < 0 ? 0u - value.udeg : (unsigned int)value.udeg;
+	unsigned int fraction = udeg % 1000000;
+	int i;
 
-	if (udeg < 0) {
-		udeg = -udeg;
-		sign = "-";
+	p = end;
+	for (i = 0; i < 6; i++) {
+		*--p = '0' + fraction % 10;
+		fraction /= 10;
 	}
-	put_format(b, "%s%s%u.%06u%s", pre, sign, FRACTION(udeg, 1000000), post);
+	*--p = '.';
+	p = format_uint(p, udeg / 1000000);
+	if (value.udeg < 0)
+		*--p = '-';
+	put_string(b, pre);
+	put_bytes(b, p, end - p);
+	put_string(b, post);
 }
 
 void put_location(struct membuffer *b, const location_t *loc, const char *pre, const char *post)
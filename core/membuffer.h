@@ -48,6 +48,7 @@ extern "C" {
 struct membuffer {
 	unsigned int len, alloc;
 	char *buffer;
+	FILE *sink;
 };
 
 #ifdef __GNUC__
@@ -72,11 +73,48 @@ extern __printf(2, 3) void put_format_loc(struct membuffer *, const char *fmt, .
 extern __printf(2, 0) char *add_to_string_va(char *old, const char *fmt, va_list args);
 extern __printf(2, 3) char *add_to_string(char *old, const char *fmt, ...);
 
+/*
+ * Instead of collecting everything in memory, a membuffer can write its
+ * contents to a file whenever it holds more than MEMBUFFER_SINK_SIZE bytes.
+ * That only works for data that is appended, not for strip_mb() or for
+ * reading the buffer back.
+ *
+ *     if (mb_open_file(&mb, filename))
+ *         return error;
+ *     put_string(&mb, "something");
+ *     error = mb_close_file(&mb, filename, NULL);
+ *
+ * The data goes to a temporary file, which only replaces the file once
+ * everything was written. Just before that, backup() is called with the
+ * file name, if given. The file name "-" means stdout. Both functions
+ * return 0 on success and -1 with errno set on failure. After a failed
+ * mb_open_file(), the data ends up in memory and mb_close_file() fails
+ * too, so the error can also be checked only at the end. If the old file
+ * was already removed when the rename fails, the temporary file is kept
+ * and its name is reported with report_error().
+ */
+#define MEMBUFFER_SINK_SIZE (64 * 1024)
+extern int mb_open_file(struct membuffer *b, const char *filename);
+extern int mb_close_file(struct membuffer *b, const char *filename, void (*backup)(const char *filename));
+
 /* Helpers that use membuffers internally */
 extern __printf(1, 0) char *vformat_string(const char *, va_list);
 extern __printf(1, 2) char *format_string(const char *, ...);
 
 
+/*
+ * Formatting numbers with put_format() goes through vsnprintf(), which is
+ * slow for the millions of sample values of a large dive log. These write
+ * the plain decimal digits, without regard to the locale. The padded
+ * version fills up to "width" characters with "pad", like "%02u" or "%3u".
+ */
+extern void put_int(struct membuffer *, int);
+extern void put_uint(struct membuffer *, unsigned int);
+extern void put_padded_uint(struct membuffer *, unsigned int, int width, char pad);
+
+/* Output a number of seconds as "m:ss" with pre/post data */
+extern void put_min_sec(struct membuffer *, const char *, unsigned int, const char *);
+
 /* Output one of our "milli" values with type and pre/post data */
 extern void put_milli(struct membuffer *, const char *, int, const char *);
 
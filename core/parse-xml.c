@@ -16,6 +16,7 @@
 #include <libxml/parser.h>
 #include <libxml/parserInternals.h>
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <libxslt/transform.h>
 #include <libdivecomputer/parser.h>
 
@@ -29,14 +30,17 @@
 #include "subsurface-time.h"
 #include "trip.h"
 #include "device.h"
+#include "filterpreset.h"
 #include "membuffer.h"
 #include "picture.h"
 #include "qthelper.h"
 #include "sample.h"
 #include "tag.h"
+#include "xmlfields.h"
 #include "xmlparams.h"
 
 int last_xml_version = -1;
+bool xml_stream_parse = true;
 
 static xmlDoc *test_xslt_transforms(xmlDoc *doc, const struct xml_params *params);
 
@@ -743,200 +747,265 @@ static void try_to_fill_dc_settings(const char *name, char *buf, struct parser_s
 	nonmatch("divecomputerid", name, buf);
 }
 
-static void try_to_fill_event(const char *name, char *buf, struct parser_state *state)
+static bool fill_event_field(int field, char *buf, struct parser_state *state)
 {
-	start_match("event", name, buf);
-	if (MATCH("event", event_name, state->cur_event.name))
-		return;
-	if (MATCH("name", event_name, state->cur_event.name))
-		return;
-	if (MATCH_STATE("time", eventtime, &state->cur_event.time))
-		return;
-	if (MATCH("type", get_index, &state->cur_event.type))
-		return;
-	if (MATCH("flags", get_index, &state->cur_event.flags))
-		return;
-	if (MATCH("value", get_index, &state->cur_event.value))
-		return;
-	if (MATCH("divemode", event_divemode, &state->cur_event.value))
-		return;
-	if (MATCH("cylinder", get_index, &state->cur_event.gas.index)) {
+	switch (field) {
+	case XML_EVENT_EVENT:
+	case XML_EVENT_NAME:
+		event_name(buf, state->cur_event.name);
+		return true;
+	case XML_EVENT_TIME:
+		eventtime(buf, &state->cur_event.time, state);
+		return true;
+	case XML_EVENT_TYPE:
+		get_index(buf, &state->cur_event.type);
+		return true;
+	case XML_EVENT_FLAGS:
+		get_index(buf, &state->cur_event.flags);
+		return true;
+	case XML_EVENT_VALUE:
+		get_index(buf, &state->cur_event.value);
+		return true;
+	case XML_EVENT_DIVEMODE:
+		event_divemode(buf, &state->cur_event.value);
+		return true;
+	case XML_EVENT_CYLINDER:
+		get_index(buf, &state->cur_event.gas.index);
 		/* We add one to indicate that we got an actual cylinder index value */
 		state->cur_event.gas.index++;
-		return;
+		return true;
+	case XML_EVENT_O2:
+		percent(buf, &state->cur_event.gas.mix.o2);
+		return true;
+	case XML_EVENT_HE:
+		percent(buf, &state->cur_event.gas.mix.he);
+		return true;
+	}
+	return false;
+}
+
+static void try_to_fill_event(const char *name, char *buf, struct parser_state *state)
+{
+	const struct xml_field_match *match = xml_match_field(XML_EVENT_CONTEXT, name);
+
+	start_match("event", name, buf);
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_event_field(match->fields[i], buf, state))
+			return;
 	}
-	if (MATCH("o2", percent, &state->cur_event.gas.mix.o2))
-		return;
-	if (MATCH("he", percent, &state->cur_event.gas.mix.he))
-		return;
 	nonmatch("event", name, buf);
 }
 
+static bool fill_dc_data_field(struct divecomputer *dc, int field, char *buf, struct parser_state *state)
+{
+	switch (field) {
+	case XML_DC_DATA_MAXDEPTH:
+	case XML_DC_DATA_MAX_DEPTH:
+		depth(buf, &dc->maxdepth, state);
+		return true;
+	case XML_DC_DATA_MEANDEPTH:
+	case XML_DC_DATA_MEAN_DEPTH:
+		depth(buf, &dc->meandepth, state);
+		return true;
+	case XML_DC_DATA_DURATION:
+	case XML_DC_DATA_DIVETIME:
+	case XML_DC_DATA_DIVETIMESEC:
+		duration(buf, &dc->duration);
+		return true;
+	case XML_DC_DATA_LAST_MANUAL_TIME:
+		duration(buf, &dc->last_manual_time);
+		return true;
+	case XML_DC_DATA_SURFACETIME:
+		duration(buf, &dc->surfacetime);
+		return true;
+	case XML_DC_DATA_AIRTEMP:
+	case XML_DC_DATA_AIR_TEMPERATURE:
+		temperature(buf, &dc->airtemp, state);
+		return true;
+	case XML_DC_DATA_WATERTEMP:
+	case XML_DC_DATA_WATER_TEMPERATURE:
+		temperature(buf, &dc->watertemp, state);
+		return true;
+	case XML_DC_DATA_SURFACE_PRESSURE:
+	case XML_DC_DATA_ATMOSPHERIC:
+		pressure(buf, &dc->surface_pressure, state);
+		return true;
+	case XML_DC_DATA_SALINITY_WATER:
+	case XML_DC_DATA_SALINITY:
+		salinity(buf, &dc->salinity);
+		return true;
+	case XML_DC_DATA_EXTRADATA_KEY:
+		utf8_string(buf, &state->cur_extra_data.key);
+		return true;
+	case XML_DC_DATA_EXTRADATA_VALUE:
+		utf8_string(buf, &state->cur_extra_data.value);
+		return true;
+	case XML_DC_DATA_DIVEMODE:
+		get_dc_type(buf, &dc->divemode);
+		return true;
+	}
+	return false;
+}
+
 static int match_dc_data_fields(struct divecomputer *dc, const char *name, char *buf, struct parser_state *state)
 {
-	if (MATCH_STATE("maxdepth", depth, &dc->maxdepth))
-		return 1;
-	if (MATCH_STATE("meandepth", depth, &dc->meandepth))
-		return 1;
-	if (MATCH_STATE("max.depth", depth, &dc->maxdepth))
-		return 1;
-	if (MATCH_STATE("mean.depth", depth, &dc->meandepth))
-		return 1;
-	if (MATCH("duration", duration, &dc->duration))
-		return 1;
-	if (MATCH("divetime", duration, &dc->duration))
-		return 1;
-	if (MATCH("divetimesec", duration, &dc->duration))
-		return 1;
-	if (MATCH("last-manual-time", duration, &dc->last_manual_time))
-		return 1;
-	if (MATCH("surfacetime", duration, &dc->surfacetime))
-		return 1;
-	if (MATCH_STATE("airtemp", temperature, &dc->airtemp))
-		return 1;
-	if (MATCH_STATE("watertemp", temperature, &dc->watertemp))
-		return 1;
-	if (MATCH_STATE("air.temperature", temperature, &dc->airtemp))
-		return 1;
-	if (MATCH_STATE("water.temperature", temperature, &dc->watertemp))
-		return 1;
-	if (MATCH_STATE("pressure.surface", pressure, &dc->surface_pressure))
-		return 1;
-	if (MATCH("salinity.water", salinity, &dc->salinity))
-		return 1;
-	if (MATCH("key.extradata", utf8_string, &state->cur_extra_data.key))
-		return 1;
-	if (MATCH("value.extradata", utf8_string, &state->cur_extra_data.value))
-		return 1;
-	if (MATCH("divemode", get_dc_type, &dc->divemode))
-		return 1;
-	if (MATCH("salinity", salinity, &dc->salinity))
-		return 1;
-	if (MATCH_STATE("atmospheric", pressure, &dc->surface_pressure))
-		return 1;
+	const struct xml_field_match *match = xml_match_field(XML_DC_DATA_CONTEXT, name);
+
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_dc_data_field(dc, match->fields[i], buf, state))
+			return 1;
+	}
 	return 0;
 }
 
-/* We're in the top-level dive xml. Try to convert whatever value to a dive value */
-static void try_to_fill_dc(struct divecomputer *dc, const char *name, char *buf, struct parser_state *state)
+static bool fill_dc_field(struct divecomputer *dc, int field, char *buf, struct parser_state *state)
 {
 	unsigned int deviceid;
 
-	start_match("divecomputer", name, buf);
-
-	if (MATCH_STATE("date", divedate, &dc->when))
-		return;
-	if (MATCH_STATE("time", divetime, &dc->when))
-		return;
-	if (MATCH("model", utf8_string, &dc->model))
-		return;
-	if (MATCH("deviceid", hex_value, &deviceid)) {
+	switch (field) {
+	case XML_DC_DATE:
+		divedate(buf, &dc->when, state);
+		return true;
+	case XML_DC_TIME:
+		divetime(buf, &dc->when, state);
+		return true;
+	case XML_DC_MODEL:
+		utf8_string(buf, &dc->model);
+		return true;
+	case XML_DC_DEVICEID:
+		hex_value(buf, &deviceid);
 		set_dc_deviceid(dc, deviceid, &device_table); // prefer already known serial/firmware over those from the loaded log
 		set_dc_deviceid(dc, deviceid, state->devices);
-		return;
+		return true;
+	case XML_DC_DIVEID:
+		hex_value(buf, &dc->diveid);
+		return true;
+	case XML_DC_DCTYPE:
+		get_dc_type(buf, &dc->divemode);
+		return true;
+	case XML_DC_NO_O2SENSORS:
+		get_sensor(buf, &dc->no_o2sensors);
+		return true;
+	}
+	return false;
+}
+
+/* We're in the top-level dive xml. Try to convert whatever value to a dive value */
+static void try_to_fill_dc(struct divecomputer *dc, const char *name, char *buf, struct parser_state *state)
+{
+	const struct xml_field_match *match = xml_match_field(XML_DC_CONTEXT, name);
+
+	start_match("divecomputer", name, buf);
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_dc_field(dc, match->fields[i], buf, state))
+			return;
 	}
-	if (MATCH("diveid", hex_value, &dc->diveid))
-		return;
-	if (MATCH("dctype", get_dc_type, &dc->divemode))
-		return;
-	if (MATCH("no_o2sensors", get_sensor, &dc->no_o2sensors))
-		return;
 	if (match_dc_data_fields(dc, name, buf, state))
 		return;
 
 	nonmatch("divecomputer", name, buf);
 }
 
-/* We're in samples - try to convert the random xml value to something useful */
-static void try_to_fill_sample(struct sample *sample, const char *name, char *buf, struct parser_state *state)
+static bool fill_sample_field(struct sample *sample, int field, char *buf, struct parser_state *state)
 {
 	int in_deco;
 	pressure_t p;
 
-	start_match("sample", name, buf);
-	if (MATCH_STATE("pressure.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("cylpress.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("pdiluent.sample", pressure, &sample->pressure[0]))
-		return;
-	if (MATCH_STATE("o2pressure.sample", pressure, &sample->pressure[1]))
-		return;
+	switch (field) {
+	case XML_SAMPLE_PRESSURE:
+	case XML_SAMPLE_CYLPRESS:
+	case XML_SAMPLE_PDILUENT:
+		pressure(buf, &sample->pressure[0], state);
+		return true;
+	case XML_SAMPLE_O2PRESSURE:
+		pressure(buf, &sample->pressure[1], state);
+		return true;
 	/* Christ, this is ugly */
-	if (MATCH_STATE("pressure0.sample", pressure, &p)) {
-		add_sample_pressure(sample, 0, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure1.sample", pressure, &p)) {
-		add_sample_pressure(sample, 1, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure2.sample", pressure, &p)) {
-		add_sample_pressure(sample, 2, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure3.sample", pressure, &p)) {
-		add_sample_pressure(sample, 3, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("pressure4.sample", pressure, &p)) {
-		add_sample_pressure(sample, 4, p.mbar);
-		return;
-	}
-	if (MATCH_STATE("cylinderindex.sample", get_cylinderindex, &sample->sensor[0]))
-		return;
-	if (MATCH("sensor.sample", get_sensor, &sample->sensor[0]))
-		return;
-	if (MATCH_STATE("depth.sample", depth, &sample->depth))
-		return;
-	if (MATCH_STATE("temp.sample", temperature, &sample->temperature))
-		return;
-	if (MATCH_STATE("temperature.sample", temperature, &sample->temperature))
-		return;
-	if (MATCH("sampletime.sample", sampletime, &sample->time))
-		return;
-	if (MATCH("time.sample", sampletime, &sample->time))
-		return;
-	if (MATCH("ndl.sample", sampletime, &sample->ndl))
-		return;
-	if (MATCH("tts.sample", sampletime, &sample->tts))
-		return;
-	if (MATCH("in_deco.sample", get_index, &in_deco)) {
+	case XML_SAMPLE_PRESSURE0:
+	case XML_SAMPLE_PRESSURE1:
+	case XML_SAMPLE_PRESSURE2:
+	case XML_SAMPLE_PRESSURE3:
+	case XML_SAMPLE_PRESSURE4:
+		pressure(buf, &p, state);
+		add_sample_pressure(sample, field - XML_SAMPLE_PRESSURE0, p.mbar);
+		return true;
+	case XML_SAMPLE_CYLINDERINDEX:
+		get_cylinderindex(buf, &sample->sensor[0], state);
+		return true;
+	case XML_SAMPLE_SENSOR:
+		get_sensor(buf, &sample->sensor[0]);
+		return true;
+	case XML_SAMPLE_DEPTH:
+		depth(buf, &sample->depth, state);
+		return true;
+	case XML_SAMPLE_TEMP:
+	case XML_SAMPLE_TEMPERATURE:
+		temperature(buf, &sample->temperature, state);
+		return true;
+	case XML_SAMPLE_SAMPLETIME:
+	case XML_SAMPLE_TIME:
+		sampletime(buf, &sample->time);
+		return true;
+	case XML_SAMPLE_NDL:
+		sampletime(buf, &sample->ndl);
+		return true;
+	case XML_SAMPLE_TTS:
+		sampletime(buf, &sample->tts);
+		return true;
+	case XML_SAMPLE_IN_DECO:
+		get_index(buf, &in_deco);
 		sample->in_deco = (in_deco == 1);
-		return;
-	}
-	if (MATCH("stoptime.sample", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("stopdepth.sample", depth, &sample->stopdepth))
-		return;
-	if (MATCH("cns.sample", get_uint16, &sample->cns))
-		return;
-	if (MATCH("rbt.sample", sampletime, &sample->rbt))
-		return;
-	if (MATCH("sensor1.sample", double_to_o2pressure, &sample->o2sensor[0])) // CCR O2 sensor data
-		return;
-	if (MATCH("sensor2.sample", double_to_o2pressure, &sample->o2sensor[1]))
-		return;
-	if (MATCH("sensor3.sample", double_to_o2pressure, &sample->o2sensor[2])) // up to 3 CCR sensors
-		return;
-	if (MATCH("po2.sample", double_to_o2pressure, &sample->setpoint))
-		return;
-	if (MATCH("heartbeat", get_uint8, &sample->heartbeat))
-		return;
-	if (MATCH("bearing", get_bearing, &sample->bearing))
-		return;
-	if (MATCH("setpoint.sample", double_to_o2pressure, &sample->setpoint))
-		return;
-	if (MATCH("ppo2.sample", double_to_o2pressure, &sample->o2sensor[state->next_o2_sensor])) {
+		return true;
+	case XML_SAMPLE_STOPTIME:
+	case XML_SAMPLE_DECO_TIME:
+		sampletime(buf, &sample->stoptime);
+		return true;
+	case XML_SAMPLE_STOPDEPTH:
+	case XML_SAMPLE_DECO_DEPTH:
+		depth(buf, &sample->stopdepth, state);
+		return true;
+	case XML_SAMPLE_CNS:
+		get_uint16(buf, &sample->cns);
+		return true;
+	case XML_SAMPLE_RBT:
+		sampletime(buf, &sample->rbt);
+		return true;
+	case XML_SAMPLE_SENSOR1: // CCR O2 sensor data
+	case XML_SAMPLE_SENSOR2:
+	case XML_SAMPLE_SENSOR3: // up to 3 CCR sensors
+		double_to_o2pressure(buf, &sample->o2sensor[field - XML_SAMPLE_SENSOR1]);
+		return true;
+	case XML_SAMPLE_PO2:
+	case XML_SAMPLE_SETPOINT:
+		double_to_o2pressure(buf, &sample->setpoint);
+		return true;
+	case XML_SAMPLE_HEARTBEAT:
+		get_uint8(buf, &sample->heartbeat);
+		return true;
+	case XML_SAMPLE_BEARING:
+		get_bearing(buf, &sample->bearing);
+		return true;
+	case XML_SAMPLE_PPO2:
+		double_to_o2pressure(buf, &sample->o2sensor[state->next_o2_sensor]);
 		state->next_o2_sensor++;
-		return;
+		return true;
+	case XML_SAMPLE_DECO:
+		parse_libdc_deco(buf, sample);
+		return true;
+	}
+	return false;
+}
+
+/* We're in samples - try to convert the random xml value to something useful */
+static void try_to_fill_sample(struct sample *sample, const char *name, char *buf, struct parser_state *state)
+{
+	const struct xml_field_match *match = xml_match_field(XML_SAMPLE_CONTEXT, name);
+
+	start_match("sample", name, buf);
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_sample_field(sample, match->fields[i], buf, state))
+			return;
 	}
-	if (MATCH("deco.sample", parse_libdc_deco, sample))
-		return;
-	if (MATCH("time.deco", sampletime, &sample->stoptime))
-		return;
-	if (MATCH_STATE("depth.deco", depth, &sample->stopdepth))
-		return;
 
 	switch (state->import_source) {
 	case DIVINGLOG:
@@ -1218,8 +1287,7 @@ static void gps_picture_location(char *buffer, struct picture *pic)
 	parse_location(buffer, &pic->location);
 }
 
-/* We're in the top-level dive xml. Try to convert whatever value to a dive value */
-static void try_to_fill_dive(struct dive *dive, const char *name, char *buf, struct parser_state *state)
+static bool fill_dive_field(struct dive *dive, int field, char *buf, struct parser_state *state)
 {
 	char *hash = NULL;
 	cylinder_t *cyl = dive->cylinders.nr > 0 ? get_cylinder(dive, dive->cylinders.nr - 1) : NULL;
@@ -1227,6 +1295,177 @@ static void try_to_fill_dive(struct dive *dive, const char *name, char *buf, str
 		&dive->weightsystems.weightsystems[dive->weightsystems.nr - 1] : NULL;
 	pressure_t p;
 	weight_t w;
+
+	switch (field) {
+	case XML_DIVE_DIVESITEID:
+		dive_site(buf, dive, state);
+		return true;
+	case XML_DIVE_NUMBER:
+		get_index(buf, &dive->number);
+		return true;
+	case XML_DIVE_TAGS:
+		divetags(buf, &dive->tag_list);
+		return true;
+	case XML_DIVE_TRIPFLAG:
+		get_notrip(buf, &dive->notrip);
+		return true;
+	case XML_DIVE_DATE:
+		divedate(buf, &dive->when, state);
+		return true;
+	case XML_DIVE_TIME:
+		divetime(buf, &dive->when, state);
+		return true;
+	case XML_DIVE_DATETIME:
+		divedatetime(buf, &dive->when, state);
+		return true;
+	case XML_DIVE_PICTURE_FILENAME:
+		utf8_string(buf, &state->cur_picture.filename);
+		return true;
+	case XML_DIVE_PICTURE_OFFSET:
+		offsettime(buf, &state->cur_picture.offset);
+		return true;
+	case XML_DIVE_PICTURE_GPS:
+		gps_picture_location(buf, &state->cur_picture);
+		return true;
+	case XML_DIVE_PICTURE_HASH:
+		/* Legacy -> ignore. */
+		utf8_string(buf, &hash);
+		free(hash);
+		return true;
+	case XML_DIVE_CYLINDERSTARTPRESSURE:
+		pressure(buf, &p, state);
+		get_or_create_cylinder(dive, 0)->start = p;
+		return true;
+	case XML_DIVE_CYLINDERENDPRESSURE:
+		pressure(buf, &p, state);
+		get_or_create_cylinder(dive, 0)->end = p;
+		return true;
+	case XML_DIVE_GPS:
+	case XML_DIVE_PLACE:
+		gps_in_dive(buf, dive, state);
+		return true;
+	case XML_DIVE_LATITUDE:
+	case XML_DIVE_SITELAT:
+	case XML_DIVE_LAT:
+		gps_lat(buf, dive, state);
+		return true;
+	case XML_DIVE_LONGITUDE:
+	case XML_DIVE_SITELON:
+	case XML_DIVE_LON:
+		gps_long(buf, dive, state);
+		return true;
+	case XML_DIVE_LOCATION:
+	case XML_DIVE_NAME:
+		add_dive_site(buf, dive, state);
+		return true;
+	case XML_DIVE_SUIT:
+	case XML_DIVE_DIVESUIT:
+		utf8_string(buf, &dive->suit);
+		return true;
+	case XML_DIVE_NOTES:
+		utf8_string(buf, &dive->notes);
+		return true;
+	case XML_DIVE_DIVEMASTER:
+		utf8_string(buf, &dive->divemaster);
+		return true;
+	case XML_DIVE_BUDDY:
+		utf8_string(buf, &dive->buddy);
+		return true;
+	case XML_DIVE_WATERSALINITY:
+		salinity(buf, &dive->user_salinity);
+		return true;
+	case XML_DIVE_RATING:
+		get_rating(buf, &dive->rating);
+		return true;
+	case XML_DIVE_VISIBILITY:
+		get_rating(buf, &dive->visibility);
+		return true;
+	case XML_DIVE_WAVESIZE:
+		get_rating(buf, &dive->wavesize);
+		return true;
+	case XML_DIVE_CURRENT:
+		get_rating(buf, &dive->current);
+		return true;
+	case XML_DIVE_SURGE:
+		get_rating(buf, &dive->surge);
+		return true;
+	case XML_DIVE_CHILL:
+		get_rating(buf, &dive->chill);
+		return true;
+	case XML_DIVE_AIRPRESSURE:
+		pressure(buf, &dive->surface_pressure, state);
+		return true;
+	case XML_DIVE_WS_DESCRIPTION:
+		if (!ws)
+			return false;
+		utf8_string(buf, &ws->description);
+		return true;
+	case XML_DIVE_WS_WEIGHT:
+		if (!ws)
+			return false;
+		weight(buf, &ws->weight, state);
+		return true;
+	case XML_DIVE_WEIGHT: {
+		weightsystem_t ws = empty_weightsystem;
+		weight(buf, &w, state);
+		ws.weight = w;
+		add_cloned_weightsystem(&dive->weightsystems, ws);
+		return true;
+	}
+	case XML_DIVE_AIRTEMP:
+		temperature(buf, &dive->airtemp, state);
+		return true;
+	case XML_DIVE_WATERTEMP:
+		temperature(buf, &dive->watertemp, state);
+		return true;
+	case XML_DIVE_INVALID:
+		get_bool(buf, &dive->invalid);
+		return true;
+	}
+
+	if (!cyl)
+		return false;
+	switch (field) {
+	case XML_DIVE_CYL_SIZE:
+		cylindersize(buf, &cyl->type.size);
+		return true;
+	case XML_DIVE_CYL_WORKPRESSURE:
+		pressure(buf, &cyl->type.workingpressure, state);
+		return true;
+	case XML_DIVE_CYL_DESCRIPTION:
+		utf8_string(buf, &cyl->type.description);
+		return true;
+	case XML_DIVE_CYL_START:
+		pressure(buf, &cyl->start, state);
+		return true;
+	case XML_DIVE_CYL_END:
+		pressure(buf, &cyl->end, state);
+		return true;
+	case XML_DIVE_CYL_USE:
+		cylinder_use(buf, &cyl->cylinder_use, state);
+		return true;
+	case XML_DIVE_CYL_DEPTH:
+		depth(buf, &cyl->depth, state);
+		return true;
+	case XML_DIVE_CYL_O2:
+	case XML_DIVE_CYL_O2PERCENT:
+		gasmix(buf, &cyl->gasmix.o2, state);
+		return true;
+	case XML_DIVE_CYL_N2:
+		gasmix_nitrogen(buf, &cyl->gasmix);
+		return true;
+	case XML_DIVE_CYL_HE:
+		gasmix(buf, &cyl->gasmix.he, state);
+		return true;
+	}
+	return false;
+}
+
+/* We're in the top-level dive xml. Try to convert whatever value to a dive value */
+static void try_to_fill_dive(struct dive *dive, const char *name, char *buf, struct parser_state *state)
+{
+	const struct xml_field_match *match;
+
 	start_match("dive", name, buf);
 
 	switch (state->import_source) {
@@ -1243,135 +1482,20 @@ static void try_to_fill_dive(struct dive *dive, const char *name, char *buf, str
 	default:
 		break;
 	}
-	if (MATCH_STATE("divesiteid", dive_site, dive))
-		return;
-	if (MATCH("number", get_index, &dive->number))
-		return;
-	if (MATCH("tags", divetags, &dive->tag_list))
-		return;
-	if (MATCH("tripflag", get_notrip, &dive->notrip))
-		return;
-	if (MATCH_STATE("date", divedate, &dive->when))
-		return;
-	if (MATCH_STATE("time", divetime, &dive->when))
-		return;
-	if (MATCH_STATE("datetime", divedatetime, &dive->when))
-		return;
+
+	match = xml_match_field(XML_DIVE_CONTEXT, name);
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_dive_field(dive, match->fields[i], buf, state))
+			return;
+	}
 	/*
 	 * Legacy format note: per-dive depths and duration get saved
-	 * in the first dive computer entry
+	 * in the first dive computer entry. None of the names of the
+	 * dive computer data also matches a dive value.
 	 */
 	if (match_dc_data_fields(&dive->dc, name, buf, state))
 		return;
 
-	if (MATCH("filename.picture", utf8_string, &state->cur_picture.filename))
-		return;
-	if (MATCH("offset.picture", offsettime, &state->cur_picture.offset))
-		return;
-	if (MATCH("gps.picture", gps_picture_location, &state->cur_picture))
-		return;
-	if (MATCH("hash.picture", utf8_string, &hash)) {
-		/* Legacy -> ignore. */
-		free(hash);
-		return;
-	}
-	if (MATCH_STATE("cylinderstartpressure", pressure, &p)) {
-		get_or_create_cylinder(dive, 0)->start = p;
-		return;
-	}
-	if (MATCH_STATE("cylinderendpressure", pressure, &p)) {
-		get_or_create_cylinder(dive, 0)->end = p;
-		return;
-	}
-	if (MATCH_STATE("gps", gps_in_dive, dive))
-		return;
-	if (MATCH_STATE("Place", gps_in_dive, dive))
-		return;
-	if (MATCH_STATE("latitude", gps_lat, dive))
-		return;
-	if (MATCH_STATE("sitelat", gps_lat, dive))
-		return;
-	if (MATCH_STATE("lat", gps_lat, dive))
-		return;
-	if (MATCH_STATE("longitude", gps_long, dive))
-		return;
-	if (MATCH_STATE("sitelon", gps_long, dive))
-		return;
-	if (MATCH_STATE("lon", gps_long, dive))
-		return;
-	if (MATCH_STATE("location", add_dive_site, dive))
-		return;
-	if (MATCH_STATE("name.dive", add_dive_site, dive))
-		return;
-	if (MATCH("suit", utf8_string, &dive->suit))
-		return;
-	if (MATCH("divesuit", utf8_string, &dive->suit))
-		return;
-	if (MATCH("notes", utf8_string, &dive->notes))
-		return;
-	if (MATCH("divemaster", utf8_string, &dive->divemaster))
-		return;
-	if (MATCH("buddy", utf8_string, &dive->buddy))
-		return;
-	if (MATCH("watersalinity", salinity, &dive->user_salinity))
-		return;
-	if (MATCH("rating.dive", get_rating, &dive->rating))
-		return;
-	if (MATCH("visibility.dive", get_rating, &dive->visibility))
-		return;
-	if (MATCH("wavesize.dive", get_rating, &dive->wavesize))
-		return;
-	if (MATCH("current.dive", get_rating, &dive->current))
-		return;
-	if (MATCH("surge.dive", get_rating, &dive->surge))
-		return;
-	if (MATCH("chill.dive", get_rating, &dive->chill))
-		return;
-	if (MATCH_STATE("airpressure.dive", pressure, &dive->surface_pressure))
-		return;
-	if (ws) {
-		if (MATCH("description.weightsystem", utf8_string, &ws->description))
-			return;
-		if (MATCH_STATE("weight.weightsystem", weight, &ws->weight))
-			return;
-	}
-	if (MATCH_STATE("weight", weight, &w)) {
-		weightsystem_t ws = empty_weightsystem;
-		ws.weight = w;
-		add_cloned_weightsystem(&dive->weightsystems, ws);
-		return;
-	}
-	if (cyl) {
-		if (MATCH("size.cylinder", cylindersize, &cyl->type.size))
-			return;
-		if (MATCH_STATE("workpressure.cylinder", pressure, &cyl->type.workingpressure))
-			return;
-		if (MATCH("description.cylinder", utf8_string, &cyl->type.description))
-			return;
-		if (MATCH_STATE("start.cylinder", pressure, &cyl->start))
-			return;
-		if (MATCH_STATE("end.cylinder", pressure, &cyl->end))
-			return;
-		if (MATCH_STATE("use.cylinder", cylinder_use, &cyl->cylinder_use))
-			return;
-		if (MATCH_STATE("depth.cylinder", depth, &cyl->depth))
-			return;
-		if (MATCH_STATE("o2", gasmix, &cyl->gasmix.o2))
-			return;
-		if (MATCH_STATE("o2percent", gasmix, &cyl->gasmix.o2))
-			return;
-		if (MATCH("n2", gasmix_nitrogen, &cyl->gasmix))
-			return;
-		if (MATCH_STATE("he", gasmix, &cyl->gasmix.he))
-			return;
-	}
-	if (MATCH_STATE("air.divetemperature", temperature, &dive->airtemp))
-		return;
-	if (MATCH_STATE("water.divetemperature", temperature, &dive->watertemp))
-		return;
-	if (MATCH("invalid", get_bool, &dive->invalid))
-		return;
-
 	nonmatch("dive", name, buf);
 }
 
@@ -1388,29 +1512,34 @@ static void try_to_fill_trip(dive_trip_t *dive_trip, const char *name, char *buf
 	nonmatch("trip", name, buf);
 }
 
-/* We're processing a divesite entry - try to fill the components */
-static void try_to_fill_dive_site(struct parser_state *state, const char *name, char *buf)
+static bool fill_dive_site_field(struct dive_site *ds, int field, char *buf, struct parser_state *state)
 {
-	struct dive_site *ds = state->cur_dive_site;
 	char *taxonomy_value = NULL;
 
-	start_match("divesite", name, buf);
-
-	if (MATCH("uuid", hex_value, &ds->uuid))
-		return;
-	if (MATCH("name", utf8_string, &ds->name))
-		return;
-	if (MATCH("description", utf8_string, &ds->description))
-		return;
-	if (MATCH("notes", utf8_string, &ds->notes))
-		return;
-	if (MATCH("gps", gps_location, ds))
-		return;
-	if (MATCH("cat.geo", get_index, &state->taxonomy_category))
-		return;
-	if (MATCH("origin.geo", get_index, &state->taxonomy_origin))
-		return;
-	if (MATCH("value.geo", utf8_string, &taxonomy_value)) {
+	switch (field) {
+	case XML_DIVESITE_UUID:
+		hex_value(buf, &ds->uuid);
+		return true;
+	case XML_DIVESITE_NAME:
+		utf8_string(buf, &ds->name);
+		return true;
+	case XML_DIVESITE_DESCRIPTION:
+		utf8_string(buf, &ds->description);
+		return true;
+	case XML_DIVESITE_NOTES:
+		utf8_string(buf, &ds->notes);
+		return true;
+	case XML_DIVESITE_GPS:
+		gps_location(buf, ds);
+		return true;
+	case XML_DIVESITE_TAXONOMY_CATEGORY:
+		get_index(buf, &state->taxonomy_category);
+		return true;
+	case XML_DIVESITE_TAXONOMY_ORIGIN:
+		get_index(buf, &state->taxonomy_origin);
+		return true;
+	case XML_DIVESITE_TAXONOMY_VALUE:
+		utf8_string(buf, &taxonomy_value);
 		/* The code assumes that "value.geo" comes last, which is against
 		 * the expectations of an XML file. Let's at least make sure that
 		 * cat and origin have been set! */
@@ -1422,7 +1551,20 @@ static void try_to_fill_dive_site(struct parser_state *state, const char *name,
 		}
 		state->taxonomy_category = state->taxonomy_origin = -1;
 		free(taxonomy_value);
-		return;
+		return true;
+	}
+	return false;
+}
+
+/* We're processing a divesite entry - try to fill the components */
+static void try_to_fill_dive_site(struct parser_state *state, const char *name, char *buf)
+{
+	const struct xml_field_match *match = xml_match_field(XML_DIVESITE_CONTEXT, name);
+
+	start_match("divesite", name, buf);
+	for (int i = 0; match && i < match->nr; i++) {
+		if (fill_dive_site_field(state->cur_dive_site, match->fields[i], buf, state))
+			return;
 	}
 
 	nonmatch("divesite", name, buf);
@@ -1731,15 +1873,275 @@ static const char *preprocess_divelog_de(const char *buffer)
 	return buffer;
 }
 
+/*
+ * Native Subsurface XML doesn't need any XSLT transformations, so
+ * there's no reason to build a document tree just to walk it once.
+ * Instead, we stream through the file with a libxml2 text reader and
+ * feed the nodes to entry() as they come by. This must produce exactly
+ * the same calls as the traverse() of the tree, so we keep the names
+ * of the open elements around to construct the node names that
+ * nodename() would return.
+ */
+struct xml_stream_level {
+	const struct nesting *rule;
+	char name[MAXNAME];
+};
+
+struct xml_stream {
+	const char *url;
+	int depth, allocated;
+	struct xml_stream_level *levels;
+};
+
+static void append_lowercase(char **p, int *len, const char *name)
+{
+	char c;
+
+	while (*len > 1 && (c = *name++) != 0) {
+		/* Cheaper 'tolower()' for ASCII */
+		*(*p)++ = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+		--*len;
+	}
+}
+
+/* See nodename(): "name.parent" - plus a trailing '.' if there is yet another level */
+static const char *stream_nodename(const char *name, const struct xml_stream *stream, int parent, char *buf, int len)
+{
+	char *p = buf;
+
+	append_lowercase(&p, &len, name);
+	if (parent >= 0 && len > 1) {
+		*p++ = '.';
+		len--;
+		append_lowercase(&p, &len, stream->levels[parent].name);
+		if (parent > 0 && len > 1)
+			*p++ = '.';
+	}
+	*p = 0;
+	return buf;
+}
+
+static bool is_blank(const char *s)
+{
+	while (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r')
+		s++;
+	return !*s;
+}
+
+static bool stream_entry(const char *name, int parent, char *content, struct xml_stream *stream, struct parser_state *state)
+{
+	char buffer[MAXNAME];
+
+	if (!content || is_blank(content))
+		return true;
+	return entry(stream_nodename(name, stream, parent, buffer, sizeof(buffer)), content, state);
+}
+
+static const struct nesting *find_rule(const char *name)
+{
+	const struct nesting *rule = nesting;
+
+	while (rule->name && strcmp(rule->name, name))
+		rule++;
+	return rule;
+}
+
+static bool stream_start_element(xmlTextReaderPtr reader, struct xml_stream *stream, struct parser_state *state)
+{
+	const char *name = (const char *)xmlTextReaderConstLocalName(reader);
+	struct xml_stream_level *level;
+	char *lower;
+	int len;
+	bool ret = true;
+
+	if (stream->depth >= stream->allocated) {
+		int allocated = (stream->allocated + 8) * 3 / 2;
+		struct xml_stream_level *levels = realloc(stream->levels, allocated * sizeof(*levels));
+		if (!levels) {
+			report_error("Out of memory parsing file %s", stream->url);
+			return false;
+		}
+		stream->levels = levels;
+		stream->allocated = allocated;
+	}
+	level = &stream->levels[stream->depth++];
+	level->rule = find_rule(name);
+	lower = level->name;
+	len = MAXNAME;
+	append_lowercase(&lower, &len, name);
+	*lower = 0;
+
+	if (level->rule->start)
+		level->rule->start(state);
+
+	while (ret && xmlTextReaderMoveToNextAttribute(reader) == 1) {
+		char *value;
+		if (xmlTextReaderIsNamespaceDecl(reader))
+			continue;
+		value = (char *)xmlTextReaderValue(reader);
+		ret = stream_entry((const char *)xmlTextReaderConstLocalName(reader), stream->depth - 1, value, stream, state);
+		xmlFree(value);
+	}
+	xmlTextReaderMoveToElement(reader);
+	return ret;
+}
+
+static void stream_end_element(struct xml_stream *stream, struct parser_state *state)
+{
+	const struct nesting *rule = stream->levels[--stream->depth].rule;
+
+	if (rule->end)
+		rule->end(state);
+}
+
+/* Returns 1 if this isn't native Subsurface XML, so that the caller can fall back to the tree walk */
+static int read_xml_stream(const char *url, const char *buffer, struct parser_state *state)
+{
+	struct xml_stream stream = { .url = url };
+	xmlTextReaderPtr reader;
+	int res, ret = 0;
+	bool started = false, ok = true;
+
+	/* The tree walk knows how to deal with broken encodings */
+	if (!xmlCheckUTF8((const unsigned char *)buffer))
+		return 1;
+	reader = xmlReaderForMemory(buffer, strlen(buffer), url, NULL, XML_PARSE_HUGE);
+	if (!reader)
+		return 1;
+
+	while (ok && (res = xmlTextReaderRead(reader)) == 1) {
+		char *value;
+
+		switch (xmlTextReaderNodeType(reader)) {
+		case XML_READER_TYPE_ELEMENT:
+			if (!started) {
+				if (strcmp((const char *)xmlTextReaderConstLocalName(reader), "divelog")) {
+					xmlFreeTextReader(reader);
+					return 1;
+				}
+				started = true;
+				reset_all(state);
+				dive_start(state);
+			}
+			ok = stream_start_element(reader, &stream, state);
+			if (ok && xmlTextReaderIsEmptyElement(reader))
+				stream_end_element(&stream, state);
+			break;
+		case XML_READER_TYPE_END_ELEMENT:
+			stream_end_element(&stream, state);
+			break;
+		case XML_READER_TYPE_TEXT:
+		case XML_READER_TYPE_CDATA:
+			if (!stream.depth)
+				break;
+			value = (char *)xmlTextReaderValue(reader);
+			ok = stream_entry(stream.levels[stream.depth - 1].name, stream.depth - 2, value, &stream, state);
+			xmlFree(value);
+			break;
+		}
+	}
+	if (!ok) {
+		// we decided to give up on parsing... why?
+		ret = -1;
+	} else if (res < 0) {
+		ret = report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
+	}
+	if (started)
+		dive_end(state);
+	else if (!ret)
+		ret = 1;
+	xmlFreeTextReader(reader);
+	free(stream.levels);
+	return ret;
+}
+
+/*
+ * The reader can fail in the middle of the file, when a part of it was
+ * parsed already. The tree walk never adds anything for a broken file,
+ * so this parses into our own tables and only hands the results over
+ * on success.
+ */
+static int parse_xml_stream(const char *url, const char *buffer, struct parser_state *state)
+{
+	struct dive_table dives = empty_dive_table;
+	struct trip_table trips = empty_trip_table;
+	struct dive_site_table sites = empty_dive_site_table;
+	struct device_table *devices = alloc_device_table();
+	struct filter_preset_table *filter_presets = alloc_filter_preset_table();
+	struct dive_table *target_table = state->target_table;
+	struct trip_table *target_trips = state->trips;
+	struct dive_site_table *target_sites = state->sites;
+	struct device_table *target_devices = state->devices;
+	struct filter_preset_table *target_filter_presets = state->filter_presets;
+	int i, ret;
+
+	state->target_table = &dives;
+	state->trips = &trips;
+	state->sites = &sites;
+	state->devices = devices;
+	state->filter_presets = filter_presets;
+	ret = read_xml_stream(url, buffer, state);
+	state->target_table = target_table;
+	state->trips = target_trips;
+	state->sites = target_sites;
+	state->devices = target_devices;
+	state->filter_presets = target_filter_presets;
+
+	if (ret) {
+		clear_dive_table(&dives);
+		clear_trip_table(&trips);
+		clear_dive_site_table(&sites);
+	}
+	for (i = 0; i < dives.nr; i++)
+		add_to_dive_table(target_table, target_table->nr, dives.dives[i]);
+	for (i = 0; i < trips.nr; i++)
+		insert_trip(trips.trips[i], target_trips);
+	for (i = 0; i < sites.nr; i++)
+		add_dive_site_to_table(sites.dive_sites[i], target_sites);
+	if (!ret) {
+		for (i = 0; i < nr_devices(devices); i++)
+			add_to_device_table(target_devices, get_device(devices, i));
+		add_filter_presets_to_table(filter_presets, target_filter_presets);
+	}
+	free(dives.dives);
+	free(trips.trips);
+	free(sites.dive_sites);
+	free_device_table(devices);
+	free_filter_preset_table(filter_presets);
+	return ret;
+}
+
+static int parse_xml_doc(const char *url, const char *buffer, struct parser_state *state, const struct xml_params *params)
+{
+	xmlDoc *doc;
+	int ret = 0;
+
+	doc = xmlReadMemory(buffer, strlen(buffer), url, NULL, XML_PARSE_HUGE);
+	if (!doc)
+		doc = xmlReadMemory(buffer, strlen(buffer), url, "latin1", XML_PARSE_HUGE);
+	if (!doc)
+		return report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
+
+	reset_all(state);
+	dive_start(state);
+	doc = test_xslt_transforms(doc, params);
+	if (!traverse(xmlDocGetRootElement(doc), state)) {
+		// we decided to give up on parsing... why?
+		ret = -1;
+	}
+	dive_end(state);
+	xmlFreeDoc(doc);
+	return ret;
+}
+
 int parse_xml_buffer(const char *url, const char *buffer, int size,
 		     struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
 		     struct device_table *devices, struct filter_preset_table *filter_presets,
 		     const struct xml_params *params)
 {
 	UNUSED(size);
-	xmlDoc *doc;
 	const char *res = preprocess_divelog_de(buffer);
-	int ret = 0;
+	int ret = 1;
 	struct parser_state state;
 
 	init_parser_state(&state);
@@ -1748,26 +2150,14 @@ int parse_xml_buffer(const char *url, const char *buffer, int size,
 	state.sites = sites;
 	state.devices = devices;
 	state.filter_presets = filter_presets;
-	doc = xmlReadMemory(res, strlen(res), url, NULL, XML_PARSE_HUGE);
-	if (!doc)
-		doc = xmlReadMemory(res, strlen(res), url, "latin1", XML_PARSE_HUGE);
+	if (xml_stream_parse && !params)
+		ret = parse_xml_stream(url, res, &state);
+	if (ret > 0)
+		ret = parse_xml_doc(url, res, &state, params);
 
 	if (res != buffer)
 		free((char *)res);
-
-	if (!doc)
-		return report_error(translate("gettextFromC", "Failed to parse '%s'"), url);
-
-	reset_all(&state);
-	dive_start(&state);
-	doc = test_xslt_transforms(doc, params);
-	if (!traverse(xmlDocGetRootElement(doc), &state)) {
-		// we decided to give up on parsing... why?
-		ret = -1;
-	}
-	dive_end(&state);
 	free_parser_state(&state);
-	xmlFreeDoc(doc);
 	return ret;
 }
 
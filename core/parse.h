@@ -145,6 +145,8 @@ void utf8_string(char *buffer, void *_res);
 void add_dive_site(char *ds_name, struct dive *dive, struct parser_state *state);
 int atoi_n(char *ptr, unsigned int len);
 
+extern bool xml_stream_parse;
+
 void parse_xml_init(void);
 int parse_xml_buffer(const char *url, const char *buf, int size, struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
 		     struct device_table *devices, struct filter_preset_table *filter_presets, const struct xml_params *params);
@@ -27,13 +27,13 @@
 
 #define TIMESTEP 2 /* second */
 
-static int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
+static const int decostoplevels_metric[] = { 0, 3000, 6000, 9000, 12000, 15000, 18000, 21000, 24000, 27000,
 					30000, 33000, 36000, 39000, 42000, 45000, 48000, 51000, 54000, 57000,
 					60000, 63000, 66000, 69000, 72000, 75000, 78000, 81000, 84000, 87000,
 					90000, 100000, 110000, 120000, 130000, 140000, 150000, 160000, 170000,
 					180000, 190000, 200000, 220000, 240000, 260000, 280000, 300000,
 					320000, 340000, 360000, 380000 };
-static int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
+static const int decostoplevels_imperial[] = { 0, 3048, 6096, 9144, 12192, 15240, 18288, 21336, 24384, 27432,
 					30480, 33528, 36576, 39624, 42672, 45720, 48768, 51816, 54864, 57912,
 					60960, 64008, 67056, 70104, 73152, 76200, 79248, 82296, 85344, 88392,
 					91440, 101600, 111760, 121920, 132080, 142240, 152400, 162560, 172720,
@@ -123,9 +123,11 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 	if (!dive)
 		return 0;
 	if (*cached_datap) {
+		struct deco_config config = ds->config;
 		restore_deco_state(*cached_datap, ds, true);
+		ds->config = config;
 	} else {
-		surface_interval = init_decompression(ds, dive, true);
+		surface_interval = init_decompression(ds, dive, &ds->config, true);
 		cache_deco_state(ds, cached_datap);
 	}
 	dc = &dive->dc;
@@ -158,7 +160,7 @@ static int tissue_at_end(struct deco_state *ds, struct dive *dive, struct deco_s
 		 * portion of the dive.
 		 * Remember the value for later.
 		 */
-		if ((decoMode(true) == VPMB) && (lastdepth.mm > sample->depth.mm)) {
+		if ((ds->config.mode == VPMB) && (lastdepth.mm > sample->depth.mm)) {
 			pressure_t ceiling_pressure;
 			nuclear_regeneration(ds, t0.seconds);
 			vpmb_start_gradient(ds);
@@ -550,7 +552,7 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 		add_segment(ds, depth_to_bar(trial_depth, dive),
 			    gasmix,
 			    wait_time, po2, divemode, prefs.decosac, true);
-	if (decoMode(true) == VPMB) {
+	if (ds->config.mode == VPMB) {
 		double tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(stoplevel, dive), true);
 		update_regression(ds, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > stoplevel) {
@@ -569,7 +571,7 @@ static bool trial_ascent(struct deco_state *ds, int wait_time, int trial_depth,
 			    gasmix,
 			    TIMESTEP, po2, divemode, prefs.decosac, true);
 		tolerance_limit = tissue_tolerance_calc(ds, dive, depth_to_bar(trial_depth, dive), true);
-		if (decoMode(true) == VPMB)
+		if (ds->config.mode == VPMB)
 			update_regression(ds, dive);
 		if (deco_allowed_depth(tolerance_limit, surface_pressure, dive, 1) > trial_depth - deltad) {
 			/* We should have stopped */
@@ -668,7 +670,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int depth;
 	struct gaschanges *gaschanges = NULL;
 	int gaschangenr;
-	int *decostoplevels;
+	int decostoplevels[sizeof(decostoplevels_metric) / sizeof(int)];
 	int decostoplevelcount;
 	int *stoplevels = NULL;
 	bool stopping = false;
@@ -689,21 +691,24 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	int decostopcounter = 0;
 	enum divemode_t divemode = dive->dc.divemode;
 
-	set_gf(diveplan->gflow, diveplan->gfhigh);
-	set_vpmb_conservatism(diveplan->vpmb_conservatism);
+	struct deco_config config;
+
+	/* The settings of the plan are kept in the deco state. Thus, several plans can be calculated concurrently. */
+	init_deco_config(&config, prefs.planner_deco_mode, diveplan->gflow, diveplan->gfhigh, diveplan->vpmb_conservatism);
 	if (!diveplan->surface_pressure)
 		diveplan->surface_pressure = SURFACE_PRESSURE;
 	dive->surface_pressure.mbar = diveplan->surface_pressure;
-	clear_deco(ds, dive->surface_pressure.mbar / 1000.0, true);
+	clear_deco(ds, dive->surface_pressure.mbar / 1000.0, &config, true);
 	ds->max_bottom_ceiling_pressure.mbar = ds->first_ceiling_pressure.mbar = 0;
 	create_dive_from_plan(diveplan, dive, is_planner);
 
 	// Do we want deco stop array in metres or feet?
+	// Take a copy, because it is modified below and plans may be calculated concurrently.
 	if (prefs.units.length == METERS ) {
-		decostoplevels = decostoplevels_metric;
+		memcpy(decostoplevels, decostoplevels_metric, sizeof(decostoplevels_metric));
 		decostoplevelcount = sizeof(decostoplevels_metric) / sizeof(int);
 	} else {
-		decostoplevels = decostoplevels_imperial;
+		memcpy(decostoplevels, decostoplevels_imperial, sizeof(decostoplevels_imperial));
 		decostoplevelcount = sizeof(decostoplevels_imperial) / sizeof(int);
 	}
 
@@ -771,7 +776,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	diveplan->surface_interval = tissue_at_end(ds, dive, cached_datap);
 	nuclear_regeneration(ds, clock);
 	vpmb_start_gradient(ds);
-	if (decoMode(true) == RECREATIONAL) {
+	if (ds->config.mode == RECREATIONAL) {
 		bool safety_stop = prefs.safetystop && max_depth >= 10000;
 		track_ascent_gas(depth, dive, current_cylinder, avg_depth, bottom_time, safety_stop, divemode);
 		// How long can we stay at the current depth and still directly ascent to the surface?
@@ -859,7 +864,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	//CVA
 	do {
 		decostopcounter = 0;
-		is_final_plan = (decoMode(true) == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
+		is_final_plan = (ds->config.mode == BUEHLMANN) || (previous_deco_time - ds->deco_time < 10);  // CVA time converges
 		if (ds->deco_time != 10000000)
 			vpmb_next_gradient(ds, ds->deco_time, diveplan->surface_pressure / 1000.0, true);
 
@@ -1090,7 +1095,7 @@ bool plan(struct deco_state *ds, struct diveplan *diveplan, struct dive *dive, i
 	decostoptable[decostopcounter].depth = 0;
 
 	plan_add_segment(diveplan, clock - previous_point_time, 0, current_cylinder, po2, false, divemode);
-	if (decoMode(true) == VPMB) {
+	if (ds->config.mode == VPMB) {
 		diveplan->eff_gfhigh = lrint(100.0 * regressionb(ds));
 		diveplan->eff_gflow = lrint(100.0 * (regressiona(ds) * first_stop_depth + regressionb(ds)));
 	}
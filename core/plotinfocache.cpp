@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: GPL-2.0
+#include "plotinfocache.h"
+#include "dive.h"
+#include "divecomputer.h"
+#include "divelist.h"
+#include "profile.h"
+#include "subsurface-qt/divelistnotifier.h"
+
+#include <string.h>
+
+// Enough to switch back and forth between the dives of a day or a trip
+static const size_t maxEntries = 16;
+
+PlotInfoCache *PlotInfoCache::instance()
+{
+	static PlotInfoCache self;
+	return &self;
+}
+
+PlotInfoCache::PlotInfoCache()
+{
+	connect(&diveListNotifier, &DiveListNotifier::dataReset, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::settingsChanged, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::divesAdded, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::divesDeleted, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::divesTimeChanged, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::divesImported, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::divesChanged, this, &PlotInfoCache::divesChanged);
+	connect(&diveListNotifier, &DiveListNotifier::cylindersReset, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderAdded, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderRemoved, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::cylinderEdited, this, &PlotInfoCache::clear);
+	connect(&diveListNotifier, &DiveListNotifier::eventsChanged, this, &PlotInfoCache::clear);
+}
+
+PlotInfoCache::~PlotInfoCache()
+{
+	clear();
+}
+
+void PlotInfoCache::clear()
+{
+	for (Entry &entry: entries)
+		free_plot_info_data(&entry.pi);
+	entries.clear();
+}
+
+int PlotInfoCache::size() const
+{
+	return (int)entries.size();
+}
+
+void PlotInfoCache::divesChanged(const QVector<dive *> &, DiveField field)
+{
+	// Fields that are not shown in and don't influence the profile
+	if (!field.datetime && !field.depth && !field.duration && !field.air_temp && !field.water_temp &&
+	    !field.atm_press && !field.mode && !field.salinity && !field.invalid &&
+	    (field.nr || field.divesite || field.divemaster || field.buddy || field.rating || field.visibility ||
+	     field.wavesize || field.current || field.surge || field.chill || field.suit || field.tags || field.notes))
+		return;
+	clear();
+}
+
+void PlotInfoCache::makeKey(Key &key, const struct dive *d, int dcNr, bool fast, int columns)
+{
+	memset(&key, 0, sizeof(key));
+	key.diveId = d->id;
+	key.dcNr = dcNr;
+	key.fast = fast;
+	key.columns = columns;
+	get_deco_config(&key.decoConfig, false);
+	key.calcceiling3m = prefs.calcceiling3m;
+	key.calcndltts = prefs.calcndltts;
+	key.decoinfo = prefs.decoinfo;
+	key.ead = prefs.ead;
+	key.mod = prefs.mod;
+	key.hrgraph = prefs.hrgraph;
+	key.show_sac = prefs.show_sac;
+	key.zoomed_plot = prefs.zoomed_plot;
+	key.modpO2 = prefs.modpO2;
+	key.pp_graphs.po2 = prefs.pp_graphs.po2;
+	key.pp_graphs.pn2 = prefs.pp_graphs.pn2;
+	key.pp_graphs.phe = prefs.pp_graphs.phe;
+	key.pp_graphs.po2_threshold_min = prefs.pp_graphs.po2_threshold_min;
+	key.pp_graphs.po2_threshold_max = prefs.pp_graphs.po2_threshold_max;
+	key.pp_graphs.pn2_threshold = prefs.pp_graphs.pn2_threshold;
+	key.pp_graphs.phe_threshold = prefs.pp_graphs.phe_threshold;
+	key.bottomsac = prefs.bottomsac;
+	key.decosac = prefs.decosac;
+	key.pscr_ratio = prefs.pscr_ratio;
+	key.ascratelast6m = prefs.ascratelast6m;
+	key.ascratestops = prefs.ascratestops;
+	key.ascrate50 = prefs.ascrate50;
+	key.ascrate75 = prefs.ascrate75;
+}
+
+void PlotInfoCache::createPlotInfo(const struct dive *d, int dcNr, struct plot_info *pi, bool fast, int columns, const struct deco_state *planner_ds)
+{
+	const struct divecomputer *dc = get_dive_dc_const(d, dcNr);
+
+	// Changes are only reported for the dives of the dive table. Note that
+	// the profile may show a copy of a dive, which has the same id.
+	int idx = get_divenr(d);
+	if (planner_ds || idx < 0 || get_dive(idx) != d) {
+		create_plot_info_new(d, dc, pi, fast, columns, planner_ds);
+		return;
+	}
+
+	Key key;
+	makeKey(key, d, dcNr, fast, columns);
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (memcmp(&it->key, &key, sizeof(key)) == 0) {
+			entries.splice(entries.begin(), entries, it);
+			copy_plot_info(pi, &entries.front().pi);
+			return;
+		}
+	}
+
+	create_plot_info_new(d, dc, pi, fast, columns, nullptr);
+	if (entries.size() >= maxEntries) {
+		free_plot_info_data(&entries.back().pi);
+		entries.pop_back();
+	}
+	entries.push_front(Entry());
+	memcpy(&entries.front().key, &key, sizeof(key));
+	init_plot_info(&entries.front().pi);
+	copy_plot_info(&entries.front().pi, pi);
+}
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-2.0
+// A least-recently-used cache of the plot infos of dives, so that switching
+// between dives or printing many profiles doesn't recalculate them every time.
+// The entries are keyed by dive, dive computer and the preferences the plot
+// info depends on. Since the deco calculation of a dive depends on the
+// previous dives, all entries are dropped whenever the undo commands report
+// a change that may affect a profile.
+
+#ifndef PLOTINFOCACHE_H
+#define PLOTINFOCACHE_H
+
+#include "core/deco.h"
+#include "core/display.h"
+#include "core/pref.h"
+
+#include <QObject>
+#include <QVector>
+#include <list>
+
+struct dive;
+struct DiveField;
+
+class PlotInfoCache : public QObject {
+	Q_OBJECT
+public:
+	static PlotInfoCache *instance();
+	~PlotInfoCache();
+
+	// Same as create_plot_info_new(), but takes the plot info from the cache
+	// if possible. Only dives of the dive table are cached, and not in the planner.
+	void createPlotInfo(const struct dive *d, int dcNr, struct plot_info *pi, bool fast, int columns, const struct deco_state *planner_ds);
+	void clear();
+	int size() const; // Number of cached plot infos
+
+private:
+	PlotInfoCache();
+	void divesChanged(const QVector<dive *> &dives, DiveField field);
+
+	// Set up with memset() so that it can be compared with memcmp()
+	struct Key {
+		int diveId;
+		int dcNr;
+		bool fast;
+		int columns;
+		struct deco_config decoConfig;
+		bool calcceiling3m, calcndltts, decoinfo;
+		bool ead, mod, hrgraph, show_sac, zoomed_plot;
+		double modpO2;
+		partial_pressure_graphs_t pp_graphs;
+		int bottomsac, decosac, pscr_ratio;
+		int ascratelast6m, ascratestops, ascrate50, ascrate75;
+	};
+	static void makeKey(Key &key, const struct dive *d, int dcNr, bool fast, int columns);
+
+	struct Entry {
+		Key key;
+		struct plot_info pi;
+	};
+	std::list<Entry> entries; // most recently used first
+};
+
+#endif
@@ -122,6 +122,8 @@ struct preferences {
 	bool        use_default_file;
 	bool        extraEnvironmentalDefault;
 	bool        salinityEditDefault;
+	bool        compact_samples; // keep samples of loaded dives packed until needed
+	bool        lazy_samples; // load samples from git repositories when needed
 
 	// ********** Geocoding **********
 	geocoding_prefs_t geocoding;
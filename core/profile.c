@@ -377,9 +377,11 @@ static void calculate_max_limits_new(const struct dive *dive, const struct divec
 	do {
 		if (dc == given_dc)
 			seen = true;
-		int i = dc->samples;
+		struct divecomputer tmp;
+		const struct divecomputer *unpacked = get_unpacked_dc(dc, &tmp);
+		int i = unpacked->samples;
 		int lastdepth = 0;
-		struct sample *s = dc->sample;
+		const struct sample *s = unpacked->sample;
 		struct event *ev;
 
 		/* Make sure we can fit all events */
@@ -423,6 +425,7 @@ static void calculate_max_limits_new(const struct dive *dive, const struct divec
 			lastdepth = depth;
 			s++;
 		}
+		release_unpacked_dc(&tmp);
 
 		dc = dc->next;
 		if (dc == NULL && !seen) {
@@ -463,12 +466,45 @@ static void insert_entry(struct plot_info *pi, int idx, int time, int depth, int
 	entry->bearing = -1;
 }
 
+static void free_deco_checkpoints(struct deco_checkpoints *c);
+
 void free_plot_info_data(struct plot_info *pi)
 {
 	free(pi->entry);
 	free(pi->pressures);
+	free(pi->tissue_ceilings);
+	free(pi->tissue_percentages);
+	free_deco_checkpoints(pi->deco_checkpoints);
 	pi->entry = NULL;
 	pi->pressures = NULL;
+	pi->tissue_ceilings = NULL;
+	pi->tissue_percentages = NULL;
+	pi->deco_checkpoints = NULL;
+}
+
+static int *copy_tissue_column(const int *column, int nr)
+{
+	int *res;
+
+	if (!column)
+		return NULL;
+	res = malloc(nr * 16 * sizeof(int));
+	memcpy(res, column, nr * 16 * sizeof(int));
+	return res;
+}
+
+/* Deep copy of the plot data, the old data of dest is freed. The deco checkpoints are not copied. */
+void copy_plot_info(struct plot_info *dest, const struct plot_info *src)
+{
+	free_plot_info_data(dest);
+	*dest = *src;
+	dest->entry = malloc(src->nr * sizeof(*dest->entry));
+	memcpy(dest->entry, src->entry, src->nr * sizeof(*dest->entry));
+	dest->pressures = malloc(src->nr_cylinders * src->nr * sizeof(*dest->pressures));
+	memcpy(dest->pressures, src->pressures, src->nr_cylinders * src->nr * sizeof(*dest->pressures));
+	dest->tissue_ceilings = copy_tissue_column(src->tissue_ceilings, src->nr);
+	dest->tissue_percentages = copy_tissue_column(src->tissue_percentages, src->nr);
+	dest->deco_checkpoints = NULL;
 }
 
 static void populate_plot_entries(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi)
@@ -986,16 +1022,215 @@ static void calculate_ndl_tts(struct deco_state *ds, const struct dive *dive, st
 	}
 }
 
+/*
+ * When only the end of a profile changes, e.g. while dragging a waypoint
+ * in the planner, there is no need to recalculate the deco information of
+ * the unchanged part. Therefore the deco state is saved at regular intervals
+ * along the profile and the calculation is resumed at the last checkpoint
+ * before the first entry whose input differs from the previous calculation.
+ *
+ * This is only done for Buehlmann. The CVA iterations of VPM-B depend on
+ * the whole profile.
+ */
+#define DECO_CHECKPOINT_INTERVAL 32
+
+/* The data of a plot entry that the deco calculation depends on */
+struct deco_input {
+	int sec;
+	int depth;
+	int o2pressure;
+	int running_sum;
+	struct gasmix gasmix;
+	enum divemode_t divemode;
+};
+
+struct deco_checkpoint {
+	int idx;			/* first entry calculated from this state */
+	int last_ndl_tts_calc_time;
+	struct deco_state ds;
+};
+
+struct deco_checkpoints {
+	/* the dive and the dive computer the checkpoints belong to */
+	int dive_id, dc_nr;
+
+	/* the conditions of the calculation */
+	bool in_planner;
+	int columns;
+	double surface_pressure;
+	int dive_surface_pressure, salinity;	/* for the depth to pressure conversion */
+	int dc_salinity;			/* for the pressure to depth conversion */
+	struct preferences prefs;
+	struct deco_state initial;
+
+	/* the input and results of the calculation */
+	int nr, first_entry;		/* first_entry: the first entry calculated last time */
+	struct deco_input *inputs;
+	struct plot_data *entry;
+	int *tissue_ceilings, *tissue_percentages;
+	int ceiling_violation;		/* entry for which the planner added an event, or nr */
+
+	int nr_checkpoints, allocated;
+	struct deco_checkpoint *checkpoints;
+};
+
+static void free_deco_checkpoints(struct deco_checkpoints *c)
+{
+	if (!c)
+		return;
+	free(c->inputs);
+	free(c->entry);
+	free(c->tissue_ceilings);
+	free(c->tissue_percentages);
+	free(c->checkpoints);
+	free(c);
+}
+
+static bool same_deco_input(const struct deco_input *a, const struct deco_input *b)
+{
+	return a->sec == b->sec &&
+	       a->depth == b->depth &&
+	       a->o2pressure == b->o2pressure &&
+	       a->running_sum == b->running_sum &&
+	       same_gasmix(a->gasmix, b->gasmix) &&
+	       a->divemode == b->divemode;
+}
+
+/* Compare the parts of the initial state that are set by init_decompression() */
+static bool same_initial_deco_state(const struct deco_state *a, const struct deco_state *b)
+{
+	return a->config.mode == b->config.mode &&
+	       a->config.gf_low == b->config.gf_low &&
+	       a->config.gf_high == b->config.gf_high &&
+	       a->config.vpmb_conservatism == b->config.vpmb_conservatism &&
+	       !memcmp(a->tissue_n2_sat, b->tissue_n2_sat,
+		       offsetof(struct deco_state, first_ceiling_pressure) - offsetof(struct deco_state, tissue_n2_sat)) &&
+	       a->first_ceiling_pressure.mbar == b->first_ceiling_pressure.mbar &&
+	       a->ci_pointing_to_guiding_tissue == b->ci_pointing_to_guiding_tissue &&
+	       a->gf_low_pressure_this_dive == b->gf_low_pressure_this_dive &&
+	       a->deco_time == b->deco_time;
+}
+
+static struct deco_input *get_deco_inputs(const struct dive *dive, const struct divecomputer *dc, const struct plot_info *pi)
+{
+	struct deco_input *inputs = calloc(pi->nr, sizeof(*inputs));
+	struct gasmix gasmix = gasmix_invalid;
+	const struct event *ev = NULL, *evd = NULL;
+	enum divemode_t current_divemode = UNDEF_COMP_TYPE;
+
+	for (int i = 1; i < pi->nr; i++) {
+		const struct plot_data *entry = pi->entry + i;
+		struct deco_input *input = inputs + i;
+
+		input->sec = entry->sec;
+		input->depth = entry->depth;
+		input->o2pressure = entry->o2pressure.mbar;
+		input->running_sum = entry->running_sum;
+		input->divemode = current_divemode = get_current_divemode(dc, entry->sec, &evd, &current_divemode);
+		input->gasmix = gasmix = get_gasmix(dive, dc, entry->sec, &ev, gasmix);
+	}
+	return inputs;
+}
+
+static void copy_deco_information(struct plot_info *pi, const struct deco_checkpoints *c, int idx)
+{
+	struct plot_data *dest = pi->entry + idx;
+	const struct plot_data *src = c->entry + idx;
+
+	if (pi->tissue_ceilings)
+		memcpy(pi->tissue_ceilings + idx * 16, c->tissue_ceilings + idx * 16, 16 * sizeof(int));
+	if (pi->tissue_percentages)
+		memcpy(pi->tissue_percentages + idx * 16, c->tissue_percentages + idx * 16, 16 * sizeof(int));
+	dest->ceiling = src->ceiling;
+	dest->in_deco_calc = src->in_deco_calc;
+	dest->ndl_calc = src->ndl_calc;
+	dest->tts_calc = src->tts_calc;
+	dest->stoptime_calc = src->stoptime_calc;
+	dest->stopdepth_calc = src->stopdepth_calc;
+	dest->ambpressure = src->ambpressure;
+	dest->gfline = src->gfline;
+	dest->surface_gf = src->surface_gf;
+	dest->current_gf = src->current_gf;
+	dest->icd_warning = src->icd_warning;
+}
+
+static void add_deco_checkpoint(struct deco_checkpoints *c, int idx, int last_ndl_tts_calc_time, const struct deco_state *ds)
+{
+	struct deco_checkpoint *checkpoint;
+
+	if (c->nr_checkpoints >= c->allocated) {
+		c->allocated = (c->allocated + 8) * 3 / 2;
+		c->checkpoints = realloc(c->checkpoints, c->allocated * sizeof(*c->checkpoints));
+	}
+	checkpoint = c->checkpoints + c->nr_checkpoints++;
+	checkpoint->idx = idx;
+	checkpoint->last_ndl_tts_calc_time = last_ndl_tts_calc_time;
+	checkpoint->ds = *ds;
+}
+
+/*
+ * Restore the state of the previous calculation at the last checkpoint that
+ * comes before any change of the profile and copy the results of the entries
+ * before it. Returns the first entry that has to be calculated.
+ */
+static int resume_deco_calculation(const struct deco_checkpoints *c, const struct deco_input *inputs, struct deco_state *ds,
+				   const struct dive *dive, int dc_nr, struct plot_info *pi, double surface_pressure,
+				   bool in_planner, int *last_ndl_tts_calc_time)
+{
+	const struct deco_checkpoint *checkpoint = NULL;
+	int i, limit, first_change;
+
+	/* The plot info may be reused for a different dive or dive computer */
+	if (!c || c->dive_id != dive->id || c->dc_nr != dc_nr)
+		return 1;
+
+	if (c->in_planner != in_planner || c->columns != pi->columns || c->surface_pressure != surface_pressure ||
+	    c->dive_surface_pressure != dive->surface_pressure.mbar || c->salinity != dive->salinity ||
+	    c->dc_salinity != dive->dc.salinity ||
+	    memcmp(&c->prefs, &prefs, sizeof(prefs)) || !same_initial_deco_state(&c->initial, ds))
+		return 1;
+
+	/* The NDL of the last entry is always calculated, and the
+	 * planner event for a violated ceiling has to be added again. */
+	limit = MIN(c->nr, pi->nr - 1);
+	limit = MIN(limit, c->ceiling_violation);
+	for (first_change = 1; first_change < limit; first_change++) {
+		if (!same_deco_input(c->inputs + first_change, inputs + first_change))
+			break;
+	}
+
+	for (i = 0; i < c->nr_checkpoints && c->checkpoints[i].idx <= first_change; i++)
+		checkpoint = c->checkpoints + i;
+	if (!checkpoint)
+		return 1;
+
+	for (i = 1; i < checkpoint->idx; i++)
+		copy_deco_information(pi, c, i);
+	*ds = checkpoint->ds;
+	*last_ndl_tts_calc_time = checkpoint->last_ndl_tts_calc_time;
+	return checkpoint->idx;
+}
+
+/* The first entry whose deco information was calculated by the last call
+ * of create_plot_info_new(). The entries before it were taken from the
+ * previous calculation. */
+int get_deco_resume_entry(const struct plot_info *pi)
+{
+	return pi->deco_checkpoints ? pi->deco_checkpoints->first_entry : 1;
+}
+
 /* Let's try to do some deco calculations.
  */
 static void calculate_deco_information(struct deco_state *ds, const struct deco_state *planner_ds, const struct dive *dive,
-				       const struct divecomputer *dc, struct plot_info *pi)
+				       const struct divecomputer *dc, int dc_nr, struct plot_info *pi)
 {
 	int i, count_iteration = 0;
 	double surface_pressure = (dc->surface_pressure.mbar ? dc->surface_pressure.mbar : get_surface_pressure_in_mbar(dive, true)) / 1000.0;
 	bool first_iteration = true;
 	int prev_deco_time = 10000000, time_deep_ceiling = 0;
 	bool in_planner = planner_ds != NULL;
+	struct deco_checkpoints *checkpoints = NULL;
+	int first_entry = 1, first_ndl_tts_calc_time = 0;
 
 	if (!in_planner) {
 		ds->deco_time = 0;
@@ -1005,27 +1240,63 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 		ds->first_ceiling_pressure = planner_ds->first_ceiling_pressure;
 	}
 	struct deco_state *cache_data_initial = NULL;
-	lock_planner();
 	/* For VPM-B outside the planner, cache the initial deco state for CVA iterations */
-	if (decoMode(in_planner) == VPMB) {
+	if (ds->config.mode == VPMB) {
 		cache_deco_state(ds, &cache_data_initial);
+		if (pi->deco_checkpoints)
+			pi->deco_checkpoints->first_entry = 1;
+	} else {
+		struct deco_input *inputs = get_deco_inputs(dive, dc, pi);
+
+		first_entry = resume_deco_calculation(pi->deco_checkpoints, inputs, ds, dive, dc_nr, pi, surface_pressure,
+						      in_planner, &first_ndl_tts_calc_time);
+
+		/* Keep the checkpoints that are still valid and record new ones */
+		checkpoints = pi->deco_checkpoints;
+		if (first_entry == 1) {
+			free_deco_checkpoints(checkpoints);
+			checkpoints = calloc(1, sizeof(*checkpoints));
+			checkpoints->dive_id = dive->id;
+			checkpoints->dc_nr = dc_nr;
+			checkpoints->in_planner = in_planner;
+			checkpoints->columns = pi->columns;
+			checkpoints->surface_pressure = surface_pressure;
+			checkpoints->dive_surface_pressure = dive->surface_pressure.mbar;
+			checkpoints->salinity = dive->salinity;
+			checkpoints->dc_salinity = dive->dc.salinity;
+			memcpy(&checkpoints->prefs, &prefs, sizeof(prefs));
+			checkpoints->initial = *ds;
+		} else {
+			while (checkpoints->nr_checkpoints > 0 &&
+			       checkpoints->checkpoints[checkpoints->nr_checkpoints - 1].idx >= first_entry)
+				checkpoints->nr_checkpoints--;
+			free(checkpoints->inputs);
+		}
+		checkpoints->inputs = inputs;
+		checkpoints->nr = pi->nr;
+		checkpoints->first_entry = first_entry;
+		checkpoints->ceiling_violation = pi->nr;
+		pi->deco_checkpoints = checkpoints;
 	}
 	/* For VPM-B outside the planner, iterate until deco time converges (usually one or two iterations after the initial)
 	 * Set maximum number of iterations to 10 just in case */
 
 	while ((abs(prev_deco_time - ds->deco_time) >= 30) && (count_iteration < 10)) {
-		int last_ndl_tts_calc_time = 0, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
-		if (decoMode(in_planner) == VPMB)
+		int last_ndl_tts_calc_time = first_ndl_tts_calc_time, first_ceiling = 0, current_ceiling, last_ceiling = 0, final_tts = 0 , time_clear_ceiling = 0;
+		if (ds->config.mode == VPMB)
 			ds->first_ceiling_pressure.mbar = depth_to_mbar(first_ceiling, dive);
 		struct gasmix gasmix = gasmix_invalid;
 		const struct event *ev = NULL, *evd = NULL;
 		enum divemode_t current_divemode = UNDEF_COMP_TYPE;
 
-		for (i = 1; i < pi->nr; i++) {
+		for (i = first_entry; i < pi->nr; i++) {
 			struct plot_data *entry = pi->entry + i;
 			int j, t0 = (entry - 1)->sec, t1 = entry->sec;
 			int time_stepsize = 20, max_ceiling = -1;
 
+			if (checkpoints && i % DECO_CHECKPOINT_INTERVAL == 0)
+				add_deco_checkpoint(checkpoints, i, last_ndl_tts_calc_time, ds);
+
 			current_divemode = get_current_divemode(dc, entry->sec, &evd, &current_divemode);
 			gasmix = get_gasmix(dive, dc, t1, &ev, gasmix);
 			entry->ambpressure = depth_to_bar(entry->depth, dive);
@@ -1050,7 +1321,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				entry->ceiling = (entry - 1)->ceiling;
 			} else {
 				/* Keep updating the VPM-B gradients until the start of the ascent phase of the dive. */
-				if (decoMode(in_planner) == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
+				if (ds->config.mode == VPMB && last_ceiling >= first_ceiling && first_iteration == true) {
 					nuclear_regeneration(ds, t1);
 					vpmb_start_gradient(ds);
 					/* For CVA iterations, calculate next gradient */
@@ -1064,7 +1335,7 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 					current_ceiling = entry->ceiling;
 				last_ceiling = current_ceiling;
 				/* If using VPM-B, take first_ceiling_pressure as the deepest ceiling */
-				if (decoMode(in_planner) == VPMB) {
+				if (ds->config.mode == VPMB) {
 					if  (current_ceiling >= first_ceiling ||
 					     (time_deep_ceiling == t0 && entry->depth == (entry - 1)->depth)) {
 						time_deep_ceiling = t1;
@@ -1090,16 +1361,24 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 			}
 			entry->surface_gf = 0.0;
 			entry->current_gf = 0.0;
+			int *ceilings = pi->tissue_ceilings ? pi->tissue_ceilings + i * 16 : NULL;
+			int *percentages = pi->tissue_percentages ? pi->tissue_percentages + i * 16 : NULL;
+			bool check_ceiling = in_planner && !pi->waypoint_above_ceiling;
 			for (j = 0; j < 16; j++) {
 				double m_value = ds->buehlmann_inertgas_a[j] + entry->ambpressure / ds->buehlmann_inertgas_b[j];
 				double surface_m_value = ds->buehlmann_inertgas_a[j] + surface_pressure / ds->buehlmann_inertgas_b[j];
-				entry->ceilings[j] = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
-				if (entry->ceilings[j] > max_ceiling)
-					max_ceiling = entry->ceilings[j];
+				if (ceilings || check_ceiling) {
+					int ceiling = deco_allowed_depth(ds->tolerated_by_tissue[j], surface_pressure, dive, 1);
+					if (ceilings)
+						ceilings[j] = ceiling;
+					if (ceiling > max_ceiling)
+						max_ceiling = ceiling;
+				}
 				double current_gf = (ds->tissue_inertgas_saturation[j] - entry->ambpressure) / (m_value - entry->ambpressure);
-				entry->percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
-					lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
-					lrint(AMB_PERCENTAGE + current_gf * (100.0 - AMB_PERCENTAGE));
+				if (percentages)
+					percentages[j] = ds->tissue_inertgas_saturation[j] < entry->ambpressure ?
+						lrint(ds->tissue_inertgas_saturation[j] / entry->ambpressure * AMB_PERCENTAGE) :
+						lrint(AMB_PERCENTAGE + current_gf * (100.0 - AMB_PERCENTAGE));
 				if (current_gf > entry->current_gf)
 					entry->current_gf = current_gf;
 				double surface_gf = 100.0 * (ds->tissue_inertgas_saturation[j] - surface_pressure) / (surface_m_value - surface_pressure);
@@ -1119,14 +1398,16 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				add_event(&non_const_dive->dc, entry->sec, SAMPLE_EVENT_CEILING, -1, max_ceiling / 1000,
 					  translate("gettextFromC", "planned waypoint above ceiling"));
 				pi->waypoint_above_ceiling = true;
+				if (checkpoints)
+					checkpoints->ceiling_violation = i;
 			}
 
 			/* should we do more calculations?
 			* We don't for print-mode because this info doesn't show up there
 			* If the ceiling hasn't cleared by the last data point, we need tts for VPM-B CVA calculation
 			* It is not necessary to do these calculation on the first VPMB iteration, except for the last data point */
-			if ((prefs.calcndltts && (decoMode(in_planner) != VPMB || in_planner || !first_iteration)) ||
-			    (decoMode(in_planner) == VPMB && !in_planner && i == pi->nr - 1)) {
+			if ((prefs.calcndltts && (ds->config.mode != VPMB || in_planner || !first_iteration)) ||
+			    (ds->config.mode == VPMB && !in_planner && i == pi->nr - 1)) {
 				/* only calculate ndl/tts on every 30 seconds */
 				if ((entry->sec - last_ndl_tts_calc_time) < 30 && i != pi->nr - 1) {
 					struct plot_data *prev_entry = (entry - 1);
@@ -1142,14 +1423,14 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 				struct deco_state *cache_data = NULL;
 				cache_deco_state(ds, &cache_data);
 				calculate_ndl_tts(ds, dive, entry, gasmix, surface_pressure, current_divemode, in_planner);
-				if (decoMode(in_planner) == VPMB && !in_planner && i == pi->nr - 1)
+				if (ds->config.mode == VPMB && !in_planner && i == pi->nr - 1)
 					final_tts = entry->tts_calc;
 				/* Restore "real" deco state for next real time step */
-				restore_deco_state(cache_data, ds, decoMode(in_planner) == VPMB);
+				restore_deco_state(cache_data, ds, ds->config.mode == VPMB);
 				free(cache_data);
 			}
 		}
-		if (decoMode(in_planner) == VPMB && !in_planner) {
+		if (ds->config.mode == VPMB && !in_planner) {
 			int this_deco_time;
 			prev_deco_time = ds->deco_time;
 			// Do we need to update deco_time?
@@ -1177,10 +1458,21 @@ static void calculate_deco_information(struct deco_state *ds, const struct deco_
 	}
 
 	free(cache_data_initial);
+	if (checkpoints) {
+		checkpoints->entry = realloc(checkpoints->entry, pi->nr * sizeof(*checkpoints->entry));
+		memcpy(checkpoints->entry, pi->entry, pi->nr * sizeof(*checkpoints->entry));
+		if (pi->tissue_ceilings) {
+			checkpoints->tissue_ceilings = realloc(checkpoints->tissue_ceilings, pi->nr * 16 * sizeof(int));
+			memcpy(checkpoints->tissue_ceilings, pi->tissue_ceilings, pi->nr * 16 * sizeof(int));
+		}
+		if (pi->tissue_percentages) {
+			checkpoints->tissue_percentages = realloc(checkpoints->tissue_percentages, pi->nr * 16 * sizeof(int));
+			memcpy(checkpoints->tissue_percentages, pi->tissue_percentages, pi->nr * 16 * sizeof(int));
+		}
+	}
 #if DECO_CALC_DEBUG & 1
 	dump_tissues(ds);
 #endif
-	unlock_planner();
 }
 
 
@@ -1352,16 +1644,31 @@ void init_plot_info(struct plot_info *pi)
  * about it.
  *
  * The old data will be freed. Before the first call, the plot
- * info must be initialized with init_plot_info().
+ * info must be initialized with init_plot_info(). The samples must
+ * have been loaded, see load_deco_dive_samples(). Packed samples are
+ * read from a temporary copy.
  */
-void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool fast, const struct deco_state *planner_ds)
+void create_plot_info_new(const struct dive *dive, const struct divecomputer *given_dc, struct plot_info *pi, bool fast, int columns,
+			  const struct deco_state *planner_ds)
 {
-	int o2, he, o2max;
+	struct divecomputer tmp;
+	const struct divecomputer *dc = get_unpacked_dc(given_dc, &tmp);
+	int o2, he, o2max, dc_nr = 0;
 	struct deco_state plot_deco_state;
+	struct deco_config config;
 	bool in_planner = planner_ds != NULL;
-	init_decompression(&plot_deco_state, dive, in_planner);
+	/* A planned dive is shown with the settings of the planner */
+	if (in_planner)
+		config = planner_ds->config;
+	else
+		get_deco_config(&config, false);
+	init_decompression(&plot_deco_state, dive, &config, in_planner);
+	/* The deco checkpoints of the previous calculation are kept */
+	struct deco_checkpoints *checkpoints = pi->deco_checkpoints;
+	pi->deco_checkpoints = NULL;
 	free_plot_info_data(pi);
-	calculate_max_limits_new(dive, dc, pi, in_planner);
+	calculate_max_limits_new(dive, given_dc, pi, in_planner);
+	pi->deco_checkpoints = checkpoints;
 	get_dive_gas(dive, &o2, &he, &o2max);
 	if (dc->divemode == FREEDIVE){
 		pi->dive_type = FREEDIVE;
@@ -1375,6 +1682,11 @@ void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc
 	}
 
 	populate_plot_entries(dive, dc, pi);
+	pi->columns = columns;
+	if (columns & PLOT_TISSUE_CEILINGS)
+		pi->tissue_ceilings = calloc(pi->nr * 16, sizeof(int));
+	if (columns & PLOT_TISSUE_PERCENTAGES)
+		pi->tissue_percentages = calloc(pi->nr * 16, sizeof(int));
 
 	check_setpoint_events(dive, dc, pi);     /* Populate setpoints */
 	setup_gas_sensor_pressure(dive, dc, pi); /* Try to populate our gas pressure knowledge */
@@ -1385,7 +1697,9 @@ void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc
 	fill_o2_values(dive, dc, pi);			 /* .. and insert the O2 sensor data having 0 values. */
 	calculate_sac(dive, dc, pi);			 /* Calculate sac */
 
-	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, pi); /* and ceiling information, using gradient factor values in Preferences) */
+	for (const struct divecomputer *d = &dive->dc; d && d != given_dc; d = d->next)
+		dc_nr++;
+	calculate_deco_information(&plot_deco_state, planner_ds, dive, dc, dc_nr, pi); /* and ceiling information, using gradient factor values in Preferences) */
 
 	calculate_gas_information_new(dive, dc, pi);	 /* Calculate gas partial pressures */
 
@@ -1395,6 +1709,7 @@ void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc
 
 	pi->meandepth = dive->dc.meandepth.mm;
 	analyze_plot_info(pi);
+	release_unpacked_dc(&tmp);
 }
 
 struct divecomputer *select_dc(struct dive *dive)
@@ -1539,11 +1854,12 @@ static void plot_string(const struct dive *d, const struct plot_info *pi, int id
 		if (entry->ceiling) {
 			depthvalue = get_depth_units(entry->ceiling, NULL, &depth_unit);
 			put_format_loc(b, translate("gettextFromC", "Calculated ceiling %.1f%s\n"), depthvalue, depth_unit);
-			if (prefs.calcalltissues) {
+			if (prefs.calcalltissues && pi->tissue_ceilings) {
 				int k;
 				for (k = 0; k < 16; k++) {
-					if (entry->ceilings[k]) {
-						depthvalue = get_depth_units(entry->ceilings[k], NULL, &depth_unit);
+					int ceiling = get_plot_tissue_ceiling(pi, idx, k);
+					if (ceiling) {
+						depthvalue = get_depth_units(ceiling, NULL, &depth_unit);
 						put_format_loc(b, translate("gettextFromC", "Tissue %.0fmin: %.1f%s\n"), buehlmann_N2_t_halflife[k], depthvalue, depth_unit);
 					}
 				}
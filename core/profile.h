@@ -42,8 +42,6 @@ struct plot_data {
 	/* Depth info */
 	int depth;
 	int ceiling;
-	int ceilings[16];
-	int percentages[16];
 	int ndl;
 	int tts;
 	int rbt;
@@ -82,10 +80,20 @@ struct plot_data {
 
 extern void compare_samples(const struct dive *d, const struct plot_info *pi, int idx1, int idx2, char *buf, int bufsize, bool sum);
 extern void init_plot_info(struct plot_info *pi);
-/* when planner_dc is non-null, this is called in planner mode. */
-extern void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool fast, const struct deco_state *planner_ds);
+/* Optional per-tissue data of a plot info, only calculated if requested */
+enum plot_info_columns {
+	PLOT_TISSUE_CEILINGS = 1 << 0,
+	PLOT_TISSUE_PERCENTAGES = 1 << 1
+};
+
+/* when planner_dc is non-null, this is called in planner mode.
+ * columns is a combination of the plot_info_columns flags. */
+extern void create_plot_info_new(const struct dive *dive, const struct divecomputer *dc, struct plot_info *pi, bool fast, int columns,
+				 const struct deco_state *planner_ds);
+extern int get_deco_resume_entry(const struct plot_info *pi);
 extern int get_plot_details_new(const struct dive *d, const struct plot_info *pi, int time, struct membuffer *);
 extern void free_plot_info_data(struct plot_info *pi);
+extern void copy_plot_info(struct plot_info *dest, const struct plot_info *src);
 
 /*
  * When showing dive profiles, we scale things to the
@@ -128,6 +136,17 @@ static inline int get_plot_pressure(const struct plot_info *pi, int idx, int cyl
 	return res ? res : get_plot_interpolated_pressure(pi, idx, cylinder);
 }
 
+/* the tissue columns read as 0 if they weren't calculated */
+static inline int get_plot_tissue_ceiling(const struct plot_info *pi, int idx, int tissue)
+{
+	return pi->tissue_ceilings ? pi->tissue_ceilings[idx * 16 + tissue] : 0;
+}
+
+static inline int get_plot_tissue_percentage(const struct plot_info *pi, int idx, int tissue)
+{
+	return pi->tissue_percentages ? pi->tissue_percentages[idx * 16 + tissue] : 0;
+}
+
 #ifdef __cplusplus
 }
 #endif
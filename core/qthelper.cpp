@@ -33,6 +33,7 @@
 #include <QDateTime>
 #include <QImageReader>
 #include <QtConcurrent>
+#include <QThread>
 #include <QFont>
 #include <QApplication>
 #include <QTextDocument>
@@ -1671,16 +1672,26 @@ extern "C" void print_qt_versions()
 	printf("%s\n", qPrintable(QStringLiteral("built with Qt Version %1, runtime from Qt Version %2").arg(QT_VERSION_STR).arg(qVersion())));
 }
 
-QMutex planLock;
-
-extern "C" void lock_planner()
+// Split the range [0, n) into one chunk per core and call fn() on the
+// chunks concurrently. Returns once all chunks are processed.
+extern "C" void parallel_for_ranges(int n, void (*fn)(int begin, int end, void *data), void *data)
 {
-	planLock.lock();
-}
+	int chunks = std::min(n, QThread::idealThreadCount());
+	if (chunks <= 1) {
+		if (n > 0)
+			fn(0, n, data);
+		return;
+	}
 
-extern "C" void unlock_planner()
-{
-	planLock.unlock();
+	std::vector<QFuture<void>> futures;
+	futures.reserve(chunks);
+	for (int i = 0; i < chunks; ++i) {
+		int begin = (int)((long long)n * i / chunks);
+		int end = (int)((long long)n * (i + 1) / chunks);
+		futures.push_back(QtConcurrent::run([fn, data, begin, end]() { fn(begin, end, data); }));
+	}
+	for (QFuture<void> &future: futures)
+		future.waitForFinished();
 }
 
 char *copy_qstring(const QString &s)
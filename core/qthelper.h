@@ -156,8 +156,7 @@ void parse_seabear_header(const char *filename, struct xml_params *params);
 char *get_current_date();
 time_t get_dive_datetime_from_isostring(char *when);
 void print_qt_versions();
-void lock_planner();
-void unlock_planner();
+void parallel_for_ranges(int n, void (*fn)(int begin, int end, void *data), void *data);
 xsltStylesheetPtr get_stylesheet(const char *name);
 weight_t string_to_weight(const char *str);
 depth_t string_to_depth(const char *str);
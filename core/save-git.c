@@ -32,10 +32,18 @@
 #include "version.h"
 #include "picture.h"
 #include "qthelper.h"
+#include "sha1.h"
 #include "gettext.h"
 #include "tag.h"
 #include "subsurface-time.h"
 
+/*
+ * Dives are formatted in parallel. Only switched off by the tests,
+ * to compare against the serial save. Therefore, this is not
+ * declared in a header.
+ */
+bool git_parallel_save = true;
+
 #define VA_BUF(b, fmt) do { va_list args; va_start(args, fmt); put_vformat(b, fmt, args); va_end(args); } while (0)
 
 static void cond_put_format(int cond, struct membuffer *b, const char *fmt, ...)
@@ -231,7 +239,10 @@ static void show_date(struct membuffer *b, timestamp_t when)
 
 static void show_integer(struct membuffer *b, int value, const char *pre, const char *post)
 {
-	put_format(b, " %s%d%s", pre, value, post);
+	put_bytes(b, " ", 1);
+	put_string(b, pre);
+	put_int(b, value);
+	put_string(b, post);
 }
 
 static void show_index(struct membuffer *b, int value, const char *pre, const char *post)
@@ -250,7 +261,9 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 {
 	int idx;
 
-	put_format(b, "%3u:%02u", FRACTION(sample->time.seconds, 60));
+	put_padded_uint(b, (unsigned int)sample->time.seconds / 60, 3, ' ');
+	put_bytes(b, ":", 1);
+	put_padded_uint(b, (unsigned int)sample->time.seconds % 60, 2, '0');
 	put_milli(b, " ", sample->depth.mm, "m");
 	put_temperature(b, sample->temperature, " ", "°C");
 
@@ -276,7 +289,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			 * mode, and "old->sensor[0]" contains that index.
 			 */
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor=%d", sensor);
+				show_integer(b, sensor, "sensor=", "");
 				old->sensor[0] = sensor;
 			}
 			continue;
@@ -284,24 +297,25 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 
 		/* The new-style format is much simpler: the sensor is always encoded */
 		put_pressure(b, p, " ", "bar");
-		put_format(b, ":%d", sensor);
+		put_bytes(b, ":", 1);
+		put_int(b, sensor);
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl=%u:%02u", FRACTION(sample->ndl.seconds, 60));
+		put_min_sec(b, " ndl=", sample->ndl.seconds, "");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts=%u:%02u", FRACTION(sample->tts.seconds, 60));
+		put_min_sec(b, " tts=", sample->tts.seconds, "");
 		old->tts = sample->tts;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco=%d", sample->in_deco ? 1 : 0);
+		put_string(b, sample->in_deco ? " in_deco=1" : " in_deco=0");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime=%u:%02u", FRACTION(sample->stoptime.seconds, 60));
+		put_min_sec(b, " stoptime=", sample->stoptime.seconds, "");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -311,12 +325,12 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns=%u%%", sample->cns);
+		show_integer(b, sample->cns, "cns=", "%");
 		old->cns = sample->cns;
 	}
 
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt=%u:%02u", FRACTION(sample->rbt.seconds, 60));
+		put_min_sec(b, " rbt=", sample->rbt.seconds, "");
 		old->rbt.seconds = sample->rbt.seconds;
 	}
 
@@ -347,15 +361,17 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 		show_index(b, sample->bearing.degrees, "bearing=", "°");
 		old->bearing.degrees = sample->bearing.degrees;
 	}
-	put_format(b, "\n");
+	put_bytes(b, "\n", 1);
 }
 
-static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
+static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *packed_dc)
 {
 	int nr;
 	int o2sensor;
 	struct sample *s;
 	struct sample dummy = { .bearing.degrees = -1, .ndl.seconds = -1 };
+	struct divecomputer tmp;
+	const struct divecomputer *dc = get_unpacked_dc(packed_dc, &tmp);
 
 	/* Is this a CCR dive with the old-style "o2pressure" sensor? */
 	o2sensor = legacy_format_o2pressures(dive, dc);
@@ -370,6 +386,7 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		save_sample(b, s, &dummy, o2sensor);
 		s++;
 	}
+	release_unpacked_dc(&tmp);
 }
 
 static void save_one_event(struct membuffer *b, struct dive *dive, struct event *ev)
@@ -477,6 +494,9 @@ static void create_dive_buffer(struct dive *dive, struct membuffer *b)
 struct dir {
 	git_treebuilder *files;
 	struct dir *subdirs, *sibling;
+	/* the dive or trip that is written into this directory, if any */
+	struct dive *dive;
+	dive_trip_t *trip;
 	char unique, name[1];
 };
 
@@ -523,6 +543,8 @@ static struct dir *new_directory(git_repository *repo, struct dir *parent, struc
 	 * and an empty treebuilder list of files.
 	 */
 	subdir->subdirs = NULL;
+	subdir->dive = NULL;
+	subdir->trip = NULL;
 	git_treebuilder_new(&subdir->files, repo, NULL);
 	memcpy(subdir->name, name, len);
 	subdir->unique = 0;
@@ -604,28 +626,75 @@ static int blob_insert(git_repository *repo, struct dir *tree, struct membuffer
 	return ret;
 }
 
-static int save_one_divecomputer(git_repository *repo, struct dir *tree, struct dive *dive, struct divecomputer *dc, int idx)
+/*
+ * Formatting a dive and writing its blobs doesn't depend on anything
+ * but the dive itself, so for all the dives that have to be written
+ * this is done by a set of worker threads. Each job just remembers
+ * the ids of the blobs, and the tree entries are then added in the
+ * original order, so that the result is identical to what a single
+ * thread would have written.
+ */
+struct dive_save_job {
+	struct dive *dive;
+	struct dir *dir;
+	bool done;
+	int ret;
+	git_oid dive_blob;
+	git_oid *dc_blobs;
+	git_oid *picture_blobs;
+};
+
+struct dive_save_queue {
+	const char *repo_path;
+	int nr, allocated;
+	struct dive_save_job *jobs;
+};
+
+static void queue_dive(struct dive_save_queue *queue, struct dive *dive, struct dir *dir)
+{
+	struct dive_save_job *job;
+
+	if (queue->nr >= queue->allocated) {
+		queue->allocated = (queue->nr + 32) * 3 / 2;
+		queue->jobs = realloc(queue->jobs, queue->allocated * sizeof(*queue->jobs));
+		if (!queue->jobs)
+			exit(1);
+	}
+	job = queue->jobs + queue->nr++;
+	memset(job, 0, sizeof(*job));
+	job->dive = dive;
+	job->dir = dir;
+	job->dc_blobs = calloc(number_of_computers(dive), sizeof(git_oid));
+	job->picture_blobs = calloc(dive->pictures.nr, sizeof(git_oid));
+
+	/* A failed job is skipped by the workers and reported when inserting */
+	if (!job->dc_blobs || (dive->pictures.nr > 0 && !job->picture_blobs)) {
+		job->ret = -1;
+		job->done = true;
+	}
+}
+
+static int create_blob(git_repository *repo, struct membuffer *b, git_oid *id)
 {
 	int ret;
-	struct membuffer buf = { 0 };
 
-	save_dc(&buf, dive, dc);
-	ret = blob_insert(repo, tree, &buf, "Divecomputer%c%03u", idx ? '-' : 0, idx);
-	if (ret)
-		report_error("divecomputer tree insert failed");
+	ret = git_blob_create_frombuffer(id, repo, b->buffer, b->len);
+	free_buffer(b);
 	return ret;
 }
 
-static int save_one_picture(git_repository *repo, struct dir *dir, struct picture *pic)
+static void save_one_picture(struct membuffer *b, struct picture *pic)
+{
+	show_utf8(b, "filename ", pic->filename, "\n");
+	put_location(b, &pic->location, "gps ", "\n");
+}
+
+static void create_picture_name(struct membuffer *name, struct picture *pic)
 {
 	int offset = pic->offset.seconds;
-	struct membuffer buf = { 0 };
 	char sign = '+';
 	unsigned h;
 
-	show_utf8(&buf, "filename ", pic->filename, "\n");
-	put_location(&buf, &pic->location, "gps ", "\n");
-
 	/* Picture loading will load even negative offsets.. */
 	if (offset < 0) {
 		offset = -offset;
@@ -635,27 +704,132 @@ static int save_one_picture(git_repository *repo, struct dir *dir, struct pictur
 	/* Use full hh:mm:ss format to make it all sort nicely */
 	h = offset / 3600;
 	offset -= h *3600;
-	return blob_insert(repo, dir, &buf, "%c%02u=%02u=%02u",
-		sign, h, FRACTION(offset, 60));
+	put_format(name, "%c%02u=%02u=%02u", sign, h, FRACTION(offset, 60));
 }
 
-static int save_pictures(git_repository *repo, struct dir *dir, struct dive *dive)
+/*
+ * This is what the worker threads do, so it must not touch
+ * anything but the dive and the job.
+ */
+static void create_dive_blobs(git_repository *repo, struct dive_save_job *job)
 {
+	struct dive *dive = job->dive;
+	struct divecomputer *dc;
+	struct membuffer buf = { 0 };
+	int i;
+
+	create_dive_buffer(dive, &buf);
+	job->ret = create_blob(repo, &buf, &job->dive_blob);
+
+	i = 0;
+	for_each_dc (dive, dc) {
+		save_dc(&buf, dive, dc);
+		job->ret |= create_blob(repo, &buf, job->dc_blobs + i++);
+	}
+
+	for (i = 0; i < dive->pictures.nr; i++) {
+		save_one_picture(&buf, dive->pictures.pictures + i);
+		job->ret |= create_blob(repo, &buf, job->picture_blobs + i);
+	}
+	job->done = true;
+}
+
+static void create_dive_blobs_range(int begin, int end, void *data)
+{
+	struct dive_save_queue *queue = data;
+	git_repository *repo;
+
+	/* libgit2 repositories can't be shared between threads */
+	if (git_repository_open(&repo, queue->repo_path))
+		return;
+	for (int i = begin; i < end; i++)
+		create_dive_blobs(repo, queue->jobs + i);
+	git_repository_free(repo);
+}
+
+static int insert_blob(struct dir *tree, git_oid *id, const char *fmt, ...)
+{
+	int ret;
+	struct membuffer name = { 0 };
+
+	VA_BUF(&name, fmt);
+	ret = tree_insert(tree->files, mb_cstring(&name), 1, id, GIT_FILEMODE_BLOB);
+	free_buffer(&name);
+	return ret;
+}
+
+static int insert_dive_blobs(git_repository *repo, struct dive_save_job *job)
+{
+	struct dive *dive = job->dive;
+	struct divecomputer *dc;
+	struct dir *dir;
+	int i, nr;
+
+	if (job->ret)
+		return report_error("dive blob creation failed");
+
+	nr = dive->number;
+	if (insert_blob(job->dir, &job->dive_blob, "Dive%c%d", nr ? '-' : 0, nr))
+		return report_error("dive save-file tree insert failed");
+
+	/*
+	 * Save the dive computer data. If there is only one dive
+	 * computer, use index 0 for that (which disables the index
+	 * generation when naming it).
+	 */
+	i = 0;
+	nr = dive->dc.next ? 1 : 0;
+	for_each_dc (dive, dc) {
+		if (insert_blob(job->dir, job->dc_blobs + i++, "Divecomputer%c%03u", nr ? '-' : 0, nr))
+			report_error("divecomputer tree insert failed");
+		nr++;
+	}
+
+	/* Save the picture data, if any */
 	if (dive->pictures.nr > 0) {
-		dir = mktree(repo, dir, "Pictures");
-		FOR_EACH_PICTURE(dive) {
-			save_one_picture(repo, dir, picture);
+		dir = mktree(repo, job->dir, "Pictures");
+		for (i = 0; i < dive->pictures.nr; i++) {
+			struct membuffer name = { 0 };
+
+			create_picture_name(&name, dive->pictures.pictures + i);
+			insert_blob(dir, job->picture_blobs + i, "%s", mb_cstring(&name));
+			free_buffer(&name);
 		}
 	}
 	return 0;
 }
 
-static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok)
+static void save_queued_dives(git_repository *repo, struct dive_save_queue *queue)
 {
-	struct divecomputer *dc;
-	struct membuffer buf = { 0 }, name = { 0 };
+	int i;
+
+	queue->repo_path = git_repository_path(repo);
+	if (git_parallel_save)
+		parallel_for_ranges(queue->nr, create_dive_blobs_range, queue);
+
+	/* Whatever the workers couldn't do, we do ourselves */
+	for (i = 0; i < queue->nr; i++) {
+		if (!queue->jobs[i].done)
+			create_dive_blobs(repo, queue->jobs + i);
+	}
+
+	for (i = 0; i < queue->nr; i++) {
+		struct dive_save_job *job = queue->jobs + i;
+
+		insert_dive_blobs(repo, job);
+		free(job->dc_blobs);
+		free(job->picture_blobs);
+	}
+	free(queue->jobs);
+	memset(queue, 0, sizeof(*queue));
+}
+
+static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *dive, struct tm *tm, bool cached_ok,
+			 struct dive_save_queue *queue)
+{
+	struct membuffer name = { 0 };
 	struct dir *subdir;
-	int ret, nr;
+	int ret;
 
 	/* Create dive directory */
 	create_dive_name(dive, &name, tm);
@@ -677,29 +851,12 @@ static int save_one_dive(git_repository *repo, struct dir *tree, struct dive *di
 
 	subdir = new_directory(repo, tree, &name);
 	subdir->unique = 1;
+	subdir->dive = dive;
 	free_buffer(&name);
 
-	create_dive_buffer(dive, &buf);
-	nr = dive->number;
-	ret = blob_insert(repo, subdir, &buf,
-		"Dive%c%d", nr ? '-' : 0, nr);
-	if (ret)
-		return report_error("dive save-file tree insert failed");
-
-	/*
-	 * Save the dive computer data. If there is only one dive
-	 * computer, use index 0 for that (which disables the index
-	 * generation when naming it).
-	 */
-	dc = &dive->dc;
-	nr = dc->next ? 1 : 0;
-	do {
-		save_one_divecomputer(repo, subdir, dive, dc, nr++);
-		dc = dc->next;
-	} while (dc);
-
-	/* Save the picture data, if any */
-	save_pictures(repo, subdir, dive);
+	/* Lazily loaded samples have to be there before the workers start */
+	load_dive_samples(dive);
+	queue_dive(queue, dive, subdir);
 	return 0;
 }
 
@@ -751,20 +908,24 @@ static void create_trip_name(dive_trip_t *trip, struct membuffer *name, struct t
 	put_string(name, "trip");
 }
 
+static void format_trip_description(dive_trip_t *trip, struct tm *tm, struct membuffer *desc)
+{
+	put_format(desc, "date %04u-%02u-%02u\n",
+		   tm->tm_year, tm->tm_mon + 1, tm->tm_mday);
+	put_format(desc, "time %02u:%02u:%02u\n",
+		   tm->tm_hour, tm->tm_min, tm->tm_sec);
+
+	show_utf8(desc, "location ", trip->location, "\n");
+	show_utf8(desc, "notes ", trip->notes, "\n");
+}
+
 static int save_trip_description(git_repository *repo, struct dir *dir, dive_trip_t *trip, struct tm *tm)
 {
 	int ret;
 	git_oid blob_id;
 	struct membuffer desc = { 0 };
 
-	put_format(&desc, "date %04u-%02u-%02u\n",
-		   tm->tm_year, tm->tm_mon + 1, tm->tm_mday);
-	put_format(&desc, "time %02u:%02u:%02u\n",
-		   tm->tm_hour, tm->tm_min, tm->tm_sec);
-
-	show_utf8(&desc, "location ", trip->location, "\n");
-	show_utf8(&desc, "notes ", trip->notes, "\n");
-
+	format_trip_description(trip, tm, &desc);
 	ret = git_blob_create_frombuffer(&blob_id, repo, desc.buffer, desc.len);
 	free_buffer(&desc);
 	if (ret)
@@ -791,42 +952,119 @@ static void verify_shared_date(timestamp_t when, struct tm *tm)
 #define MIN_TIMESTAMP (0)
 #define MAX_TIMESTAMP (0x7fffffffffffffff)
 
-static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok)
+/* The parts of the date that all dives of the trip share, see create_dive_name() */
+static void trip_shared_date(dive_trip_t *trip, struct tm *tm)
+{
+	int i;
+	timestamp_t first, last;
+
+	first = MAX_TIMESTAMP;
+	last = MIN_TIMESTAMP;
+	for (i = 0; i < trip->dives.nr; i++) {
+		struct dive *dive = trip->dives.dives[i];
+		if (dive->when < first)
+			first = dive->when;
+		if (dive->when > last)
+			last = dive->when;
+	}
+	verify_shared_date(first, tm);
+	verify_shared_date(last, tm);
+}
+
+/*
+ * A trip directory contains nothing but the trip description and
+ * the dive directories. So if none of these changed, we can reuse
+ * the directory we loaded or saved last time as a whole. To find
+ * out, we hash everything that goes into the directory: the
+ * description and the names and git ids of the dives. If any of
+ * the dives has no valid git id, it changed and so did the trip.
+ */
+static bool get_trip_git_sig(dive_trip_t *trip, unsigned char sig[20])
+{
+	int i;
+	struct tm tm;
+	SHA_CTX ctx;
+	struct membuffer buf = { 0 };
+
+	utc_mkdate(trip_date(trip), &tm);
+	format_trip_description(trip, &tm, &buf);
+	put_bytes(&buf, "", 1);
+	trip_shared_date(trip, &tm);
+	for (i = 0; i < trip->dives.nr; i++) {
+		struct dive *dive = trip->dives.dives[i];
+		if (!dive_cache_is_valid(dive)) {
+			free_buffer(&buf);
+			return false;
+		}
+		create_dive_name(dive, &buf, &tm);
+		put_bytes(&buf, "", 1);
+		put_bytes(&buf, (const char *)dive->git_id, 20);
+	}
+
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, buf.buffer, buf.len);
+	SHA1_Final(sig, &ctx);
+	free_buffer(&buf);
+	return true;
+}
+
+/* Called when the trip directory was loaded or written */
+void update_trip_git_sig(dive_trip_t *trip)
+{
+	if (!get_trip_git_sig(trip, trip->git_sig))
+		memset(trip->git_id, 0, 20);
+}
+
+static bool trip_cache_is_valid(dive_trip_t *trip)
+{
+	static const unsigned char null_id[20] = { 0, };
+	unsigned char sig[20];
+
+	if (!memcmp(trip->git_id, null_id, 20))
+		return false;
+	return get_trip_git_sig(trip, sig) && !memcmp(sig, trip->git_sig, 20);
+}
+
+static int save_one_trip(git_repository *repo, struct dir *tree, dive_trip_t *trip, struct tm *tm, bool cached_ok,
+			 struct dive_save_queue *queue)
 {
 	int i;
-	struct dive *dive;
 	struct dir *subdir;
 	struct membuffer name = { 0 };
-	timestamp_t first, last;
 
 	/* Create trip directory */
 	create_trip_name(trip, &name, tm);
+
+	/*
+	 * If nothing in the trip changed, we just create the whole
+	 * directory with the old ID
+	 */
+	if (cached_ok && trip_cache_is_valid(trip)) {
+		git_oid oid;
+		int ret;
+
+		git_oid_fromraw(&oid, trip->git_id);
+		ret = tree_insert(tree->files, mb_cstring(&name), 1, &oid, GIT_FILEMODE_TREE);
+		free_buffer(&name);
+		if (ret)
+			return report_error("cached trip tree insert failed");
+		return 0;
+	}
+
 	subdir = new_directory(repo, tree, &name);
 	subdir->unique = 1;
+	subdir->trip = trip;
 	free_buffer(&name);
 
-	/* Trip description file */
+	/* Trip description file, with the full date of the trip */
 	save_trip_description(repo, subdir, trip, tm);
 
 	/* Make sure we write out the dates to the dives consistently */
-	first = MAX_TIMESTAMP;
-	last = MIN_TIMESTAMP;
-	for_each_dive(i, dive) {
-		if (dive->divetrip != trip)
-			continue;
-		if (dive->when < first)
-			first = dive->when;
-		if (dive->when > last)
-			last = dive->when;
-	}
-	verify_shared_date(first, tm);
-	verify_shared_date(last, tm);
+	trip_shared_date(trip, tm);
 
 	/* Save each dive in the directory */
-	for_each_dive(i, dive) {
-		if (dive->divetrip == trip)
-			save_one_dive(repo, subdir, dive, tm, cached_ok);
-	}
+	for (i = 0; i < trip->dives.nr; i++)
+		save_one_dive(repo, subdir, trip->dives.dives[i], tm, cached_ok, queue);
 
 	return 0;
 }
@@ -1010,6 +1248,7 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 	int i;
 	struct dive *dive;
 	dive_trip_t *trip;
+	struct dive_save_queue queue = { 0 };
 
 	git_storage_update_progress(translate("gettextFromC", "Start saving data"));
 	save_settings(repo, root);
@@ -1048,12 +1287,13 @@ static int create_git_tree(git_repository *repo, struct dir *root, bool select_o
 			trip->saved = 1;
 
 			/* Pass that new subdirectory in for save-trip */
-			save_one_trip(repo, tree, trip, &tm, cached_ok);
+			save_one_trip(repo, tree, trip, &tm, cached_ok, &queue);
 			continue;
 		}
 
-		save_one_dive(repo, tree, dive, &tm, cached_ok);
+		save_one_dive(repo, tree, dive, &tm, cached_ok, &queue);
 	}
+	save_queued_dives(repo, &queue);
 	git_storage_update_progress(translate("gettextFromC", "Done creating local cache"));
 	return 0;
 }
@@ -1279,8 +1519,17 @@ static int write_git_tree(git_repository *repo, struct dir *tree, git_oid *resul
 	while ((subdir = tree->subdirs) != NULL) {
 		git_oid id;
 
-		if (!write_git_tree(repo, subdir, &id))
+		if (!write_git_tree(repo, subdir, &id)) {
 			tree_insert(tree->files, subdir->name, subdir->unique, &id, GIT_FILEMODE_TREE);
+
+			/* Remember the new trees, so that the next save can reuse them */
+			if (subdir->dive)
+				memcpy(subdir->dive->git_id, id.id, 20);
+			if (subdir->trip) {
+				memcpy(subdir->trip->git_id, id.id, 20);
+				update_trip_git_sig(subdir->trip);
+			}
+		}
 		tree->subdirs = subdir->sibling;
 		free(subdir);
 	};
@@ -1320,6 +1569,8 @@ int do_git_save(git_repository *repo, const char *branch, const char *remote, bo
 	/* Start with an empty tree: no subdirectories, no files */
 	tree.name[0] = 0;
 	tree.subdirs = NULL;
+	tree.dive = NULL;
+	tree.trip = NULL;
 	if (git_treebuilder_new(&tree.files, repo, NULL))
 		return report_error("git treebuilder failed");
 
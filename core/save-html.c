@@ -179,20 +179,28 @@ static void put_cylinder_HTML(struct membuffer *b, struct dive *dive)
 static void put_HTML_samples(struct membuffer *b, struct dive *dive)
 {
 	int i;
+	struct divecomputer tmp;
+	const struct divecomputer *dc;
+
+	load_dive_samples(dive);
 	put_format(b, "\"maxdepth\":%d,", dive->dc.maxdepth.mm);
 	put_format(b, "\"duration\":%d,", dive->dc.duration.seconds);
-	struct sample *s = dive->dc.sample;
+	dc = get_unpacked_dc(&dive->dc, &tmp);
+	const struct sample *s = dc->sample;
 
-	if (!dive->dc.samples)
+	if (!dc->samples) {
+		release_unpacked_dc(&tmp);
 		return;
+	}
 
 	char *separator = "\"samples\":[";
-	for (i = 0; i < dive->dc.samples; i++) {
+	for (i = 0; i < dc->samples; i++) {
 		put_format(b, "%s[%d,%d,%d,%d]", separator, s->time.seconds, s->depth.mm, s->pressure[0].mbar, s->temperature.mkelvin);
 		separator = ", ";
 		s++;
 	}
 	put_string(b, "],");
+	release_unpacked_dc(&tmp);
 }
 
 static void put_HTML_coordinates(struct membuffer *b, struct dive *dive)
@@ -480,28 +488,24 @@ void export_list(struct membuffer *b, const char *photos_dir, bool selected_only
 
 void export_HTML(const char *file_name, const char *photos_dir, const bool selected_only, const bool list_only)
 {
-	FILE *f;
-
 	struct membuffer buf = { 0 };
-	export_list(&buf, photos_dir, selected_only, list_only);
 
-	f = subsurface_fopen(file_name, "w+");
-	if (!f) {
+	if (!mb_open_file(&buf, file_name))
+		export_list(&buf, photos_dir, selected_only, list_only);
+	if (mb_close_file(&buf, file_name, NULL))
 		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
-	} else {
-		flush_buffer(&buf, f); /*check for writing errors? */
-		fclose(f);
-	}
-	free_buffer(&buf);
 }
 
 void export_translation(const char *file_name)
 {
-	FILE *f;
-
 	struct membuffer buf = { 0 };
 	struct membuffer *b = &buf;
 
+	if (mb_open_file(b, file_name)) {
+		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
+		return;
+	}
+
 	//export translated words here
 	put_format(b, "translate={");
 
@@ -574,12 +578,6 @@ void export_translation(const char *file_name)
 
 	put_format(b, "}");
 
-	f = subsurface_fopen(file_name, "w+");
-	if (!f) {
+	if (mb_close_file(b, file_name, NULL))
 		report_error(translate("gettextFromC", "Can't open file %s"), file_name);
-	} else {
-		flush_buffer(&buf, f); /*check for writing errors? */
-		fclose(f);
-	}
-	free_buffer(&buf);
 }
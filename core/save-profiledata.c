@@ -1,5 +1,6 @@
 #include "core/profile.h"
 #include "core/display.h"
+#include "core/divelist.h"
 #include "core/errorhelper.h"
 #include "core/file.h"
 #include "core/membuffer.h"
@@ -8,12 +9,12 @@
 #include "core/version.h"
 #include <errno.h>
 
-static void put_int(struct membuffer *b, int val)
+static void put_csv_int(struct membuffer *b, int val)
 {
 	put_format(b, "\"%d\", ", val);
 }
 
-static void put_int_with_nl(struct membuffer *b, int val)
+static void put_csv_int_with_nl(struct membuffer *b, int val)
 {
 	put_format(b, "\"%d\"\n", val);
 }
@@ -46,37 +47,37 @@ static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 {
 	const struct plot_data *entry = pi->entry + idx;
 
-	put_int(b, entry->in_deco);
-	put_int(b,  entry->sec);
+	put_csv_int(b, entry->in_deco);
+	put_csv_int(b,  entry->sec);
 	for (int c = 0; c < pi->nr_cylinders; c++) {
-		put_int(b, get_plot_sensor_pressure(pi, idx, c));
-		put_int(b, get_plot_interpolated_pressure(pi, idx, c));
+		put_csv_int(b, get_plot_sensor_pressure(pi, idx, c));
+		put_csv_int(b, get_plot_interpolated_pressure(pi, idx, c));
 	}
-	put_int(b, entry->temperature);
-	put_int(b, entry->depth);
-	put_int(b, entry->ceiling);
+	put_csv_int(b, entry->temperature);
+	put_csv_int(b, entry->depth);
+	put_csv_int(b, entry->ceiling);
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->ceilings[i]);
+		put_csv_int(b, get_plot_tissue_ceiling(pi, idx, i));
 	for (int i = 0; i < 16; i++)
-		put_int(b, entry->percentages[i]);
-	put_int(b, entry->ndl);
-	put_int(b, entry->tts);
-	put_int(b, entry->rbt);
-	put_int(b, entry->stoptime);
-	put_int(b, entry->stopdepth);
-	put_int(b, entry->cns);
-	put_int(b, entry->smoothed);
-	put_int(b, entry->sac);
-	put_int(b, entry->running_sum);
+		put_csv_int(b, get_plot_tissue_percentage(pi, idx, i));
+	put_csv_int(b, entry->ndl);
+	put_csv_int(b, entry->tts);
+	put_csv_int(b, entry->rbt);
+	put_csv_int(b, entry->stoptime);
+	put_csv_int(b, entry->stopdepth);
+	put_csv_int(b, entry->cns);
+	put_csv_int(b, entry->smoothed);
+	put_csv_int(b, entry->sac);
+	put_csv_int(b, entry->running_sum);
 	put_double(b, entry->pressures.o2);
 	put_double(b, entry->pressures.n2);
 	put_double(b, entry->pressures.he);
-	put_int(b, entry->o2pressure.mbar);
-	put_int(b, entry->o2sensor[0].mbar);
-	put_int(b, entry->o2sensor[1].mbar);
-	put_int(b, entry->o2sensor[2].mbar);
-	put_int(b, entry->o2setpoint.mbar);
-	put_int(b, entry->scr_OC_pO2.mbar);
+	put_csv_int(b, entry->o2pressure.mbar);
+	put_csv_int(b, entry->o2sensor[0].mbar);
+	put_csv_int(b, entry->o2sensor[1].mbar);
+	put_csv_int(b, entry->o2sensor[2].mbar);
+	put_csv_int(b, entry->o2setpoint.mbar);
+	put_csv_int(b, entry->scr_OC_pO2.mbar);
 	put_double(b, entry->mod);
 	put_double(b, entry->ead);
 	put_double(b, entry->end);
@@ -98,20 +99,20 @@ static void put_pd(struct membuffer *b, const struct plot_info *pi, int idx)
 		put_csv_string(b, "CRAZY");
 		break;
 	}
-	put_int(b, entry->speed);
-	put_int(b, entry->in_deco_calc);
-	put_int(b, entry->ndl_calc);
-	put_int(b, entry->tts_calc);
-	put_int(b, entry->stoptime_calc);
-	put_int(b, entry->stopdepth_calc);
-	put_int(b, entry->pressure_time);
-	put_int(b, entry->heartbeat);
-	put_int(b, entry->bearing);
+	put_csv_int(b, entry->speed);
+	put_csv_int(b, entry->in_deco_calc);
+	put_csv_int(b, entry->ndl_calc);
+	put_csv_int(b, entry->tts_calc);
+	put_csv_int(b, entry->stoptime_calc);
+	put_csv_int(b, entry->stopdepth_calc);
+	put_csv_int(b, entry->pressure_time);
+	put_csv_int(b, entry->heartbeat);
+	put_csv_int(b, entry->bearing);
 	put_double(b, entry->ambpressure);
 	put_double(b, entry->gfline);
 	put_double(b, entry->surface_gf);
 	put_double(b, entry->density);
-	put_int_with_nl(b, entry->icd_warning ? 1 : 0);
+	put_csv_int_with_nl(b, entry->icd_warning ? 1 : 0);
 }
 
 static void put_headers(struct membuffer *b, int nr_cylinders)
@@ -213,7 +214,8 @@ static void save_profiles_buffer(struct membuffer *b, bool select_only)
 	for_each_dive(i, dive) {
 		if (select_only && !dive->selected)
 			continue;
-		create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
+		load_deco_dive_samples(dive);
+		create_plot_info_new(dive, &dive->dc, &pi, false, PLOT_TISSUE_CEILINGS | PLOT_TISSUE_PERCENTAGES, planner_deco_state);
 		put_headers(b, pi.nr_cylinders);
 
 		for (int i = 0; i < pi.nr; i++)
@@ -229,7 +231,8 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 	struct deco_state *planner_deco_state = NULL;
 
 	init_plot_info(&pi);
-	create_plot_info_new(dive, &dive->dc, &pi, false, planner_deco_state);
+	load_deco_dive_samples(dive);
+	create_plot_info_new(dive, &dive->dc, &pi, false, 0, planner_deco_state);
 
 	put_format(b, "[Script Info]\n");
 	put_format(b, "; Script generated by Subsurface %s\n", subsurface_canonical_version());
@@ -249,24 +252,13 @@ void save_subtitles_buffer(struct membuffer *b, struct dive *dive, int offset, i
 int save_profiledata(const char *filename, bool select_only)
 {
 	struct membuffer buf = { 0 };
-	FILE *f;
-	int error = 0;
+	int error;
 
-	save_profiles_buffer(&buf, select_only);
-
-	if (same_string(filename, "-")) {
-		f = stdout;
-	} else {
-		error = -1;
-		f = subsurface_fopen(filename, "w");
-	}
-	if (f) {
-		flush_buffer(&buf, f);
-		error = fclose(f);
-	}
+	if (!mb_open_file(&buf, filename))
+		save_profiles_buffer(&buf, select_only);
+	error = mb_close_file(&buf, filename, NULL);
 	if (error)
 		report_error("Save failed (%s)", strerror(errno));
 
-	free_buffer(&buf);
 	return error;
 }
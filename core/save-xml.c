@@ -228,7 +228,10 @@ static void save_weightsystem_info(struct membuffer *b, struct dive *dive)
 
 static void show_integer(struct membuffer *b, int value, const char *pre, const char *post)
 {
-	put_format(b, " %s%d%s", pre, value, post);
+	put_bytes(b, " ", 1);
+	put_string(b, pre);
+	put_int(b, value);
+	put_string(b, post);
 }
 
 static void show_index(struct membuffer *b, int value, const char *pre, const char *post)
@@ -241,7 +244,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 {
 	int idx;
 
-	put_format(b, "  <sample time='%u:%02u min'", FRACTION(sample->time.seconds, 60));
+	put_min_sec(b, "  <sample time='", sample->time.seconds, " min'");
 	put_milli(b, " depth='", sample->depth.mm, " m'");
 	if (sample->temperature.mkelvin && sample->temperature.mkelvin != old->temperature.mkelvin) {
 		put_temperature(b, sample->temperature, " temp='", " C'");
@@ -267,36 +270,37 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 			}
 			put_pressure(b, p, " pressure='", " bar'");
 			if (sensor != old->sensor[0]) {
-				put_format(b, " sensor='%d'", sensor);
+				show_integer(b, sensor, "sensor='", "'");
 				old->sensor[0] = sensor;
 			}
 			continue;
 		}
 
 		/* The new-style format is much simpler: the sensor is always encoded */
-		put_format(b, " pressure%d=", sensor);
-		put_pressure(b, p, "'", " bar'");
+		put_string(b, " pressure");
+		put_int(b, sensor);
+		put_pressure(b, p, "='", " bar'");
 	}
 
 	/* the deco/ndl values are stored whenever they change */
 	if (sample->ndl.seconds != old->ndl.seconds) {
-		put_format(b, " ndl='%u:%02u min'", FRACTION(sample->ndl.seconds, 60));
+		put_min_sec(b, " ndl='", sample->ndl.seconds, " min'");
 		old->ndl = sample->ndl;
 	}
 	if (sample->tts.seconds != old->tts.seconds) {
-		put_format(b, " tts='%u:%02u min'", FRACTION(sample->tts.seconds, 60));
+		put_min_sec(b, " tts='", sample->tts.seconds, " min'");
 		old->tts = sample->tts;
 	}
 	if (sample->rbt.seconds != old->rbt.seconds) {
-		put_format(b, " rbt='%u:%02u min'", FRACTION(sample->rbt.seconds, 60));
+		put_min_sec(b, " rbt='", sample->rbt.seconds, " min'");
 		old->rbt = sample->rbt;
 	}
 	if (sample->in_deco != old->in_deco) {
-		put_format(b, " in_deco='%d'", sample->in_deco ? 1 : 0);
+		put_string(b, sample->in_deco ? " in_deco='1'" : " in_deco='0'");
 		old->in_deco = sample->in_deco;
 	}
 	if (sample->stoptime.seconds != old->stoptime.seconds) {
-		put_format(b, " stoptime='%u:%02u min'", FRACTION(sample->stoptime.seconds, 60));
+		put_min_sec(b, " stoptime='", sample->stoptime.seconds, " min'");
 		old->stoptime = sample->stoptime;
 	}
 
@@ -306,7 +310,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 	}
 
 	if (sample->cns != old->cns) {
-		put_format(b, " cns='%u%%'", sample->cns);
+		show_integer(b, sample->cns, "cns='", "%'");
 		old->cns = sample->cns;
 	}
 
@@ -337,7 +341,7 @@ static void save_sample(struct membuffer *b, struct sample *sample, struct sampl
 		show_index(b, sample->bearing.degrees, "bearing='", "'");
 		old->bearing.degrees = sample->bearing.degrees;
 	}
-	put_format(b, " />\n");
+	put_string(b, " />\n");
 }
 
 static void save_one_event(struct membuffer *b, struct dive *dive, struct event *ev)
@@ -409,12 +413,14 @@ static void show_date(struct membuffer *b, timestamp_t when)
 			   tm.tm_hour, tm.tm_min, tm.tm_sec);
 }
 
-static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
+static void save_samples(struct membuffer *b, struct dive *dive, struct divecomputer *packed_dc)
 {
 	int nr;
 	int o2sensor;
 	struct sample *s;
 	struct sample dummy = { .bearing.degrees = -1, .ndl.seconds = -1 };
+	struct divecomputer tmp;
+	const struct divecomputer *dc = get_unpacked_dc(packed_dc, &tmp);
 
 	/* Set up default pressure sensor indices */
 	o2sensor = legacy_format_o2pressures(dive, dc);
@@ -429,6 +435,7 @@ static void save_samples(struct membuffer *b, struct dive *dive, struct divecomp
 		save_sample(b, s, &dummy, o2sensor);
 		s++;
 	}
+	release_unpacked_dc(&tmp);
 }
 
 static void save_dc(struct membuffer *b, struct dive *dive, struct divecomputer *dc)
@@ -484,10 +491,13 @@ static void save_picture(struct membuffer *b, struct picture *pic)
 	put_string(b, "/>\n");
 }
 
-void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
+/* The samples have to be loaded, this may run in a worker thread */
+static void save_dive_xml(struct membuffer *b, struct dive *dive, bool anonymize)
 {
 	struct divecomputer *dc;
-	pressure_t surface_pressure = un_fixup_surface_pressure(dive);
+	pressure_t surface_pressure;
+
+	surface_pressure = un_fixup_surface_pressure(dive);
 
 	put_string(b, "<dive");
 	if (dive->number)
@@ -543,6 +553,12 @@ void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
 	put_format(b, "</dive>\n");
 }
 
+void save_one_dive_to_mb(struct membuffer *b, struct dive *dive, bool anonymize)
+{
+	load_dive_samples(dive);
+	save_dive_xml(b, dive, anonymize);
+}
+
 int save_dive(FILE *f, struct dive *dive, bool anonymize)
 {
 	struct membuffer buf = { 0 };
@@ -553,16 +569,109 @@ int save_dive(FILE *f, struct dive *dive, bool anonymize)
 	return 0;
 }
 
-static void save_trip(struct membuffer *b, dive_trip_t *trip, bool anonymize)
+/*
+ * The dives are formatted concurrently in batches of XML_SAVE_BATCH. Each
+ * part of the output (a dive or the start or end of a trip) gets its own
+ * buffer, and the buffers are appended in order once the batch is done,
+ * so that the output is the same as when saving serially.
+ *
+ * The switch is only there for the tests, which compare the output to the
+ * one of the serial writer. Therefore, it is not declared in a header.
+ */
+bool xml_parallel_save = true;
+
+#define XML_SAVE_BATCH 256
+
+enum xml_save_part_type {
+	SAVE_DIVE,
+	SAVE_TRIP_START,
+	SAVE_TRIP_END
+};
+
+struct xml_save_part {
+	enum xml_save_part_type type;
+	struct dive *dive;
+	dive_trip_t *trip;
+	struct membuffer buf;
+};
+
+struct xml_save_queue {
+	struct membuffer *b;
+	bool anonymize;
+	int nr;
+	struct xml_save_part parts[XML_SAVE_BATCH];
+};
+
+static void save_part(struct membuffer *b, const struct xml_save_part *part, bool anonymize)
+{
+	switch (part->type) {
+	case SAVE_DIVE:
+		save_dive_xml(b, part->dive, anonymize);
+		break;
+	case SAVE_TRIP_START:
+		put_format(b, "<trip");
+		show_date(b, trip_date(part->trip));
+		show_utf8(b, part->trip->location, " location=\'", "\'", 1);
+		put_format(b, ">\n");
+		show_utf8(b, part->trip->notes, "<notes>", "</notes>\n", 0);
+		break;
+	case SAVE_TRIP_END:
+		put_format(b, "</trip>\n");
+		break;
+	}
+}
+
+/* This is what the worker threads do: only touch the parts of the range */
+static void save_parts_range(int begin, int end, void *data)
+{
+	struct xml_save_queue *queue = data;
+
+	for (int i = begin; i < end; i++)
+		save_part(&queue->parts[i].buf, queue->parts + i, queue->anonymize);
+}
+
+static void flush_save_queue(struct xml_save_queue *queue)
+{
+	parallel_for_ranges(queue->nr, save_parts_range, queue);
+	for (int i = 0; i < queue->nr; i++) {
+		struct membuffer *buf = &queue->parts[i].buf;
+
+		put_bytes(queue->b, buf->buffer, buf->len);
+		/* Re-use the allocation, but forget the data */
+		buf->len = 0;
+	}
+	queue->nr = 0;
+}
+
+/* Without a queue, the part is saved right away */
+static void queue_part(struct membuffer *b, struct xml_save_queue *queue, enum xml_save_part_type type,
+		       struct dive *dive, dive_trip_t *trip, bool anonymize)
+{
+	struct xml_save_part *part;
+
+	/* Lazily loaded samples are read here, before the workers start */
+	if (dive)
+		load_dive_samples(dive);
+	if (!queue) {
+		struct xml_save_part direct = { type, dive, trip };
+		save_part(b, &direct, anonymize);
+		return;
+	}
+
+	part = queue->parts + queue->nr++;
+	part->type = type;
+	part->dive = dive;
+	part->trip = trip;
+	if (queue->nr == XML_SAVE_BATCH)
+		flush_save_queue(queue);
+}
+
+static void save_trip(struct membuffer *b, struct xml_save_queue *queue, dive_trip_t *trip, bool anonymize)
 {
 	int i;
 	struct dive *dive;
 
-	put_format(b, "<trip");
-	show_date(b, trip_date(trip));
-	show_utf8(b, trip->location, " location=\'", "\'", 1);
-	put_format(b, ">\n");
-	show_utf8(b, trip->notes, "<notes>", "</notes>\n", 0);
+	queue_part(b, queue, SAVE_TRIP_START, NULL, trip, anonymize);
 
 	/*
 	 * Incredibly cheesy: we want to save the dives sorted, and they
@@ -572,10 +681,10 @@ static void save_trip(struct membuffer *b, dive_trip_t *trip, bool anonymize)
 	 */
 	for_each_dive(i, dive) {
 		if (dive->divetrip == trip)
-			save_one_dive_to_mb(b, dive, anonymize);
+			queue_part(b, queue, SAVE_DIVE, dive, NULL, anonymize);
 	}
 
-	put_format(b, "</trip>\n");
+	queue_part(b, queue, SAVE_TRIP_END, NULL, NULL, anonymize);
 }
 
 static void save_one_device(struct membuffer *b, const struct device *d)
@@ -670,6 +779,7 @@ static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonym
 	int i;
 	struct dive *dive;
 	dive_trip_t *trip;
+	struct xml_save_queue *queue = NULL;
 
 	put_format(b, "<divelog program='subsurface' version='%d'>\n<settings>\n", DATAFORMAT_VERSION);
 
@@ -721,19 +831,24 @@ static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonym
 	save_filter_presets(b);
 
 	/* save the dives */
+	if (xml_parallel_save) {
+		queue = calloc(1, sizeof(*queue));
+		queue->b = b;
+		queue->anonymize = anonymize;
+	}
 	for_each_dive(i, dive) {
 		if (select_only) {
 
 			if (!dive->selected)
 				continue;
-			save_one_dive_to_mb(b, dive, anonymize);
+			queue_part(b, queue, SAVE_DIVE, dive, NULL, anonymize);
 
 		} else {
 			trip = dive->divetrip;
 
 			/* Bare dive without a trip? */
 			if (!trip) {
-				save_one_dive_to_mb(b, dive, anonymize);
+				queue_part(b, queue, SAVE_DIVE, dive, NULL, anonymize);
 				continue;
 			}
 
@@ -743,9 +858,15 @@ static void save_dives_buffer(struct membuffer *b, bool select_only, bool anonym
 
 			/* We haven't seen this trip before - save it and all dives */
 			trip->saved = 1;
-			save_trip(b, trip, anonymize);
+			save_trip(b, queue, trip, anonymize);
 		}
 	}
+	if (queue) {
+		flush_save_queue(queue);
+		for (i = 0; i < XML_SAVE_BATCH; i++)
+			free_buffer(&queue->parts[i].buf);
+		free(queue);
+	}
 	put_format(b, "</dives>\n</divelog>\n");
 }
 
@@ -809,32 +930,20 @@ static void try_to_backup(const char *filename)
 int save_dives_logic(const char *filename, const bool select_only, bool anonymize)
 {
 	struct membuffer buf = { 0 };
-	FILE *f;
 	void *git;
 	const char *branch, *remote;
-	int error = 0;
+	int error;
 
 	git = is_git_repository(filename, &branch, &remote, false);
 	if (git)
 		return git_save_dives(git, branch, remote, select_only);
 
-	save_dives_buffer(&buf, select_only, anonymize);
-
-	if (same_string(filename, "-")) {
-		f = stdout;
-	} else {
-		try_to_backup(filename);
-		error = -1;
-		f = subsurface_fopen(filename, "w");
-	}
-	if (f) {
-		flush_buffer(&buf, f);
-		error = fclose(f);
-	}
+	if (!mb_open_file(&buf, filename))
+		save_dives_buffer(&buf, select_only, anonymize);
+	error = mb_close_file(&buf, filename, try_to_backup);
 	if (error)
 		report_error(translate("gettextFromC", "Failed to save dives to %s (%s)"), filename, strerror(errno));
 
-	free_buffer(&buf);
 	return error;
 }
 
@@ -935,25 +1044,13 @@ static void save_dive_sites_buffer(struct membuffer *b, const struct dive_site *
 int save_dive_sites_logic(const char *filename, const struct dive_site *sites[], int nr_sites, bool anonymize)
 {
 	struct membuffer buf = { 0 };
-	FILE *f;
-	int error = 0;
-
-	save_dive_sites_buffer(&buf, sites, nr_sites, anonymize);
+	int error;
 
-	if (same_string(filename, "-")) {
-		f = stdout;
-	} else {
-		try_to_backup(filename);
-		error = -1;
-		f = subsurface_fopen(filename, "w");
-	}
-	if (f) {
-		flush_buffer(&buf, f);
-		error = fclose(f);
-	}
+	if (!mb_open_file(&buf, filename))
+		save_dive_sites_buffer(&buf, sites, nr_sites, anonymize);
+	error = mb_close_file(&buf, filename, try_to_backup);
 	if (error)
 		report_error(translate("gettextFromC", "Failed to save divesites to %s (%s)"), filename, strerror(errno));
 
-	free_buffer(&buf);
 	return error;
 }
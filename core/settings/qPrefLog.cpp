@@ -18,6 +18,8 @@ void qPrefLog::loadSync(bool doSync)
 	disk_extraEnvironmentalDefault(doSync);
 	disk_salinityEditDefault(doSync);
 	disk_show_average_depth(doSync);
+	disk_compact_samples(doSync);
+	disk_lazy_samples(doSync);
 }
 
 void qPrefLog::set_default_file_behavior(enum def_file_behavior value)
@@ -59,3 +61,7 @@ HANDLE_PREFERENCE_BOOL(Log, "salinityEditDefault", salinityEditDefault);
 
 HANDLE_PREFERENCE_BOOL(Log, "show_average_depth", show_average_depth);
 
+HANDLE_PREFERENCE_BOOL(Log, "compact_samples", compact_samples);
+
+HANDLE_PREFERENCE_BOOL(Log, "lazy_samples", lazy_samples);
+
@@ -13,6 +13,8 @@ class qPrefLog : public QObject {
 	Q_PROPERTY(bool extraEnvironmentalDefault READ extraEnvironmentalDefault WRITE set_extraEnvironmentalDefault NOTIFY extraEnvironmentalDefaultChanged);
 	Q_PROPERTY(bool salinityEditDefault READ salinityEditDefault WRITE set_salinityEditDefault NOTIFY salinityEditDefaultChanged);
 	Q_PROPERTY(bool show_average_depth READ show_average_depth WRITE set_show_average_depth NOTIFY show_average_depthChanged)
+	Q_PROPERTY(bool compact_samples READ compact_samples WRITE set_compact_samples NOTIFY compact_samplesChanged)
+	Q_PROPERTY(bool lazy_samples READ lazy_samples WRITE set_lazy_samples NOTIFY lazy_samplesChanged)
 
 public:
 	static qPrefLog *instance();
@@ -29,6 +31,8 @@ public:
 	static bool extraEnvironmentalDefault() { return prefs.extraEnvironmentalDefault; }
 	static bool salinityEditDefault() { return prefs.salinityEditDefault; }
 	static bool show_average_depth() { return prefs.show_average_depth; }
+	static bool compact_samples() { return prefs.compact_samples; }
+	static bool lazy_samples() { return prefs.lazy_samples; }
 
 public slots:
 	static void set_default_filename(const QString& value);
@@ -37,6 +41,8 @@ public slots:
 	static void set_extraEnvironmentalDefault(bool value);
 	static void set_salinityEditDefault(bool value);
 	static void set_show_average_depth(bool value);
+	static void set_compact_samples(bool value);
+	static void set_lazy_samples(bool value);
 
 signals:
 	void default_filenameChanged(const QString& value);
@@ -45,6 +51,8 @@ signals:
 	void extraEnvironmentalDefaultChanged(bool value);
 	void salinityEditDefaultChanged(bool value);
 	void show_average_depthChanged(bool value);
+	void compact_samplesChanged(bool value);
+	void lazy_samplesChanged(bool value);
 
 private:
 	qPrefLog() {}
@@ -55,6 +63,8 @@ private:
 	static void disk_extraEnvironmentalDefault(bool doSync);
 	static void disk_salinityEditDefault(bool doSync);
 	static void disk_show_average_depth(bool doSync);
+	static void disk_compact_samples(bool doSync);
+	static void disk_lazy_samples(bool doSync);
 
 };
 
@@ -0,0 +1,771 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Binary snapshots of loaded dive logs.
+ *
+ * Parsing a big dive log (be it XML or git) is by far the slowest
+ * part of starting up. Most of the time the log didn't change since
+ * the last start, so we dump the tables the parser produced into a
+ * cache file and the next time around we just read them back.
+ *
+ * The format is a plain in-memory dump: a fixed header, followed by
+ * the devices, dive sites, trips and dives. Numbers are stored in
+ * native byte order and samples are stored as an array of "struct
+ * sample", so a snapshot is only valid for the very same build that
+ * wrote it. That's what the version string in the header is for.
+ * Everything is read from one contiguous buffer without any parsing,
+ * so the file could just as well be mapped into memory.
+ *
+ * If anything at all doesn't match, the snapshot is ignored and the
+ * log is parsed normally.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+#include "dive.h"
+#include "divelist.h"
+#include "divesite.h"
+#include "device.h"
+#include "event.h"
+#include "extradata.h"
+#include "file.h"
+#include "filterpreset.h"
+#include "membuffer.h"
+#include "picture.h"
+#include "pref.h"
+#include "qthelper.h"
+#include "sample.h"
+#include "sha1.h"
+#include "subsurface-string.h"
+#include "tag.h"
+#include "trip.h"
+#include "version.h"
+
+#define SNAPSHOT_MAGIC "SSRFSNAP"
+#define SNAPSHOT_VERSION 3
+#define SNAPSHOT_NONE 0xffffffffu
+
+bool snapshot_cache = false;
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t sample_size;
+	char subsurface_version[64];
+	char key[64];
+};
+
+struct snapshot_reader {
+	const char *p, *end;
+	bool error;
+};
+
+#define put_raw(b, v) put_bytes(b, (const char *)&(v), sizeof(v))
+#define get_raw(r, v) get_bytes(r, &(v), sizeof(v))
+
+static void put_u32(struct membuffer *b, uint32_t v)
+{
+	put_raw(b, v);
+}
+
+static void put_str(struct membuffer *b, const char *s)
+{
+	uint32_t len = s ? strlen(s) : SNAPSHOT_NONE;
+
+	put_u32(b, len);
+	if (s)
+		put_bytes(b, s, len);
+}
+
+static void get_bytes(struct snapshot_reader *r, void *v, size_t size)
+{
+	if (r->error || (size_t)(r->end - r->p) < size) {
+		r->error = true;
+		memset(v, 0, size);
+		return;
+	}
+	memcpy(v, r->p, size);
+	r->p += size;
+}
+
+static uint32_t get_u32(struct snapshot_reader *r)
+{
+	uint32_t v;
+
+	get_raw(r, v);
+	return v;
+}
+
+/* Counts are sanity-checked against the remaining size, so that a corrupt file can't make us allocate the world */
+static int get_count(struct snapshot_reader *r)
+{
+	uint32_t v = get_u32(r);
+
+	if (v > (size_t)(r->end - r->p)) {
+		r->error = true;
+		return 0;
+	}
+	return (int)v;
+}
+
+static char *get_str(struct snapshot_reader *r)
+{
+	uint32_t len = get_u32(r);
+	char *s;
+
+	if (len == SNAPSHOT_NONE || r->error)
+		return NULL;
+	if ((size_t)(r->end - r->p) < len) {
+		r->error = true;
+		return NULL;
+	}
+	s = malloc(len + 1);
+	memcpy(s, r->p, len);
+	s[len] = 0;
+	r->p += len;
+	return s;
+}
+
+static char *snapshot_filename(const char *source)
+{
+	SHA_CTX ctx;
+	unsigned char hash[20];
+	char hex[41];
+	int i;
+
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, source, strlen(source));
+	SHA1_Final(hash, &ctx);
+	for (i = 0; i < 20; i++)
+		sprintf(hex + 2 * i, "%02x", hash[i]);
+	return format_string("%s/snapshots/%s", system_default_directory(), hex);
+}
+
+char *snapshot_key_from_buffer(const void *buffer, size_t size)
+{
+	SHA_CTX ctx;
+	unsigned char hash[20];
+	char hex[41];
+	int i;
+
+	SHA1_Init(&ctx);
+	SHA1_Update(&ctx, buffer, size);
+	SHA1_Final(hash, &ctx);
+	for (i = 0; i < 20; i++)
+		sprintf(hex + 2 * i, "%02x", hash[i]);
+	return format_string("%s-%lu", hex, (unsigned long)size);
+}
+
+static void fill_header(struct snapshot_header *header, const char *key)
+{
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic));
+	header->version = SNAPSHOT_VERSION;
+	header->sample_size = sizeof(struct sample);
+	strncpy(header->subsurface_version, subsurface_git_version(), sizeof(header->subsurface_version) - 1);
+	strncpy(header->key, key, sizeof(header->key) - 1);
+}
+
+/*
+ * Snapshots contain complete logs. Therefore, we can only use them
+ * when loading into empty tables and only for logs without filter
+ * presets, which we don't store.
+ */
+bool snapshot_applies(struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+		      struct device_table *devices, struct filter_preset_table *filter_presets)
+{
+	return snapshot_cache && !table->nr && !trips->nr && !sites->nr &&
+	       !nr_devices(devices) && !nr_filter_presets(filter_presets);
+}
+
+static void write_settings(struct membuffer *b)
+{
+	put_raw(b, autogroup);
+	put_u32(b, get_min_datafile_version());
+	put_raw(b, git_prefs.unit_system);
+	put_raw(b, git_prefs.units);
+	put_raw(b, git_prefs.tankbar);
+	put_raw(b, git_prefs.dcceiling);
+	put_raw(b, git_prefs.show_ccr_setpoint);
+	put_raw(b, git_prefs.show_ccr_sensors);
+	put_raw(b, git_prefs.pp_graphs.po2);
+}
+
+struct snapshot_settings {
+	bool autogroup;
+	int datafile_version;
+	struct preferences git_prefs;
+};
+
+static void read_settings(struct snapshot_reader *r, struct snapshot_settings *settings)
+{
+	settings->git_prefs = git_prefs;
+	get_raw(r, settings->autogroup);
+	settings->datafile_version = get_u32(r);
+	get_raw(r, settings->git_prefs.unit_system);
+	get_raw(r, settings->git_prefs.units);
+	get_raw(r, settings->git_prefs.tankbar);
+	get_raw(r, settings->git_prefs.dcceiling);
+	get_raw(r, settings->git_prefs.show_ccr_setpoint);
+	get_raw(r, settings->git_prefs.show_ccr_sensors);
+	get_raw(r, settings->git_prefs.pp_graphs.po2);
+}
+
+static void apply_settings(const struct snapshot_settings *settings)
+{
+	if (settings->autogroup)
+		set_autogroup(true);
+	if (settings->datafile_version)
+		report_datafile_version(settings->datafile_version);
+	git_prefs = settings->git_prefs;
+}
+
+static void write_devices(struct membuffer *b, const struct device_table *devices)
+{
+	int i, nr = nr_devices(devices);
+
+	put_u32(b, nr);
+	for (i = 0; i < nr; i++) {
+		const struct device *dev = get_device(devices, i);
+		put_str(b, device_get_model(dev));
+		put_u32(b, device_get_id(dev));
+		put_str(b, device_get_serial(dev));
+		put_str(b, device_get_firmware(dev));
+		put_str(b, device_get_nickname(dev));
+	}
+}
+
+static void read_devices(struct snapshot_reader *r, struct device_table *devices)
+{
+	int i, nr = get_count(r);
+
+	for (i = 0; i < nr && !r->error; i++) {
+		char *model = get_str(r);
+		uint32_t deviceid = get_u32(r);
+		char *serial = get_str(r);
+		char *firmware = get_str(r);
+		char *nickname = get_str(r);
+		if (!r->error)
+			create_device_node(devices, model, deviceid, serial, firmware, nickname);
+		free(model);
+		free(serial);
+		free(firmware);
+		free(nickname);
+	}
+}
+
+static void write_sites(struct membuffer *b, const struct dive_site_table *sites)
+{
+	int i, j;
+
+	put_u32(b, sites->nr);
+	for (i = 0; i < sites->nr; i++) {
+		const struct dive_site *ds = sites->dive_sites[i];
+		put_u32(b, ds->uuid);
+		put_str(b, ds->name);
+		put_raw(b, ds->location);
+		put_str(b, ds->description);
+		put_str(b, ds->notes);
+		put_u32(b, ds->taxonomy.nr);
+		for (j = 0; j < ds->taxonomy.nr; j++) {
+			const struct taxonomy *t = &ds->taxonomy.category[j];
+			put_u32(b, t->category);
+			put_str(b, t->value);
+			put_u32(b, t->origin);
+		}
+	}
+}
+
+static void read_sites(struct snapshot_reader *r, struct dive_site_table *sites)
+{
+	int i, j, nr = get_count(r);
+
+	for (i = 0; i < nr && !r->error; i++) {
+		struct dive_site *ds = alloc_or_get_dive_site(get_u32(r), sites);
+		ds->name = get_str(r);
+		get_raw(r, ds->location);
+		ds->description = get_str(r);
+		ds->notes = get_str(r);
+		ds->taxonomy.nr = get_count(r);
+		ds->taxonomy.category = ds->taxonomy.nr ? calloc(ds->taxonomy.nr, sizeof(struct taxonomy)) : NULL;
+		for (j = 0; j < ds->taxonomy.nr; j++) {
+			struct taxonomy *t = &ds->taxonomy.category[j];
+			t->category = get_u32(r);
+			t->value = get_str(r);
+			t->origin = get_u32(r);
+		}
+	}
+}
+
+static void write_trips(struct membuffer *b, const struct trip_table *trips)
+{
+	int i;
+
+	put_u32(b, trips->nr);
+	for (i = 0; i < trips->nr; i++) {
+		const struct dive_trip *trip = trips->trips[i];
+		put_str(b, trip->location);
+		put_str(b, trip->notes);
+		put_raw(b, trip->autogen);
+		put_raw(b, trip->git_id);
+		put_raw(b, trip->git_sig);
+	}
+}
+
+/* The trips can only be sorted into the table once their dives are known, so just read them into an array */
+static void read_trips(struct snapshot_reader *r, struct trip_table *trips)
+{
+	int i, nr = get_count(r);
+
+	trips->trips = nr ? calloc(nr, sizeof(*trips->trips)) : NULL;
+	trips->allocated = nr;
+	for (i = 0; i < nr && !r->error; i++) {
+		dive_trip_t *trip = alloc_trip();
+		trip->location = get_str(r);
+		trip->notes = get_str(r);
+		get_raw(r, trip->autogen);
+		get_raw(r, trip->git_id);
+		get_raw(r, trip->git_sig);
+		trips->trips[trips->nr++] = trip;
+	}
+}
+
+static void write_dc(struct membuffer *b, const struct divecomputer *dc)
+{
+	struct divecomputer tmp;
+	const struct divecomputer *unpacked;
+	const struct event *ev;
+	const struct extra_data *ed;
+	int nr;
+
+	put_raw(b, dc->when);
+	put_raw(b, dc->duration);
+	put_raw(b, dc->surfacetime);
+	put_raw(b, dc->last_manual_time);
+	put_raw(b, dc->maxdepth);
+	put_raw(b, dc->meandepth);
+	put_raw(b, dc->airtemp);
+	put_raw(b, dc->watertemp);
+	put_raw(b, dc->surface_pressure);
+	put_raw(b, dc->divemode);
+	put_raw(b, dc->no_o2sensors);
+	put_raw(b, dc->salinity);
+	put_str(b, dc->model);
+	put_str(b, dc->serial);
+	put_str(b, dc->fw_version);
+	put_u32(b, dc->deviceid);
+	put_u32(b, dc->diveid);
+
+	/* Samples that weren't loaded from git yet are stored as reference */
+	put_u32(b, dc->samples_repo != NULL);
+	if (dc->samples_repo) {
+		put_bytes(b, (const char *)dc->samples_git_id, sizeof(dc->samples_git_id));
+		put_raw(b, dc->unloaded_samples);
+	} else {
+		/* Packed samples are stored unpacked, the dive is left as it is */
+		unpacked = get_unpacked_dc(dc, &tmp);
+		put_u32(b, unpacked->samples);
+		put_bytes(b, (const char *)unpacked->sample, unpacked->samples * sizeof(struct sample));
+		release_unpacked_dc(&tmp);
+	}
+
+	for (nr = 0, ev = dc->events; ev; ev = ev->next)
+		nr++;
+	put_u32(b, nr);
+	for (ev = dc->events; ev; ev = ev->next) {
+		put_raw(b, ev->time);
+		put_raw(b, ev->type);
+		put_raw(b, ev->flags);
+		put_raw(b, ev->value);
+		put_raw(b, ev->gas);
+		put_raw(b, ev->deleted);
+		put_str(b, ev->name);
+	}
+
+	for (nr = 0, ed = dc->extra_data; ed; ed = ed->next)
+		nr++;
+	put_u32(b, nr);
+	for (ed = dc->extra_data; ed; ed = ed->next) {
+		put_str(b, ed->key);
+		put_str(b, ed->value);
+	}
+}
+
+static void read_dc(struct snapshot_reader *r, struct divecomputer *dc, const char *samples_repo)
+{
+	int i, nr;
+
+	get_raw(r, dc->when);
+	get_raw(r, dc->duration);
+	get_raw(r, dc->surfacetime);
+	get_raw(r, dc->last_manual_time);
+	get_raw(r, dc->maxdepth);
+	get_raw(r, dc->meandepth);
+	get_raw(r, dc->airtemp);
+	get_raw(r, dc->watertemp);
+	get_raw(r, dc->surface_pressure);
+	get_raw(r, dc->divemode);
+	get_raw(r, dc->no_o2sensors);
+	get_raw(r, dc->salinity);
+	dc->model = get_str(r);
+	dc->serial = get_str(r);
+	dc->fw_version = get_str(r);
+	dc->deviceid = get_u32(r);
+	dc->diveid = get_u32(r);
+
+	if (get_u32(r)) {
+		/* We can only refer to the samples if they come from a git repository */
+		if (!samples_repo)
+			r->error = true;
+		dc->samples_repo = samples_repo;
+		get_raw(r, dc->samples_git_id);
+		get_raw(r, dc->unloaded_samples);
+	} else {
+		nr = get_count(r);
+		if (nr) {
+			alloc_samples(dc, nr);
+			if (!dc->sample)
+				r->error = true;
+			get_bytes(r, dc->sample, nr * sizeof(struct sample));
+			dc->samples = r->error ? 0 : nr;
+		}
+	}
+
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		struct event *ev;
+		duration_t time;
+		int type, flags, value;
+		char *name;
+
+		get_raw(r, time);
+		get_raw(r, type);
+		get_raw(r, flags);
+		get_raw(r, value);
+		name = get_str(r);
+		ev = add_event(dc, time.seconds, type, flags, value, name ?: "");
+		free(name);
+		if (!ev) {
+			r->error = true;
+			break;
+		}
+		get_raw(r, ev->gas);
+		get_raw(r, ev->deleted);
+	}
+
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		char *key = get_str(r);
+		char *value = get_str(r);
+		add_extra_data(dc, key ?: "", value ?: "");
+		free(key);
+		free(value);
+	}
+}
+
+static int index_of_trip(const struct dive_trip *trip, const struct trip_table *trips)
+{
+	int i;
+
+	if (!trip)
+		return -1;
+	for (i = 0; i < trips->nr; i++) {
+		if (trips->trips[i] == trip)
+			return i;
+	}
+	return -1;
+}
+
+static void write_dive(struct membuffer *b, struct dive *dive, const struct trip_table *trips, struct dive_site_table *sites)
+{
+	struct tag_entry *tag;
+	struct divecomputer *dc;
+	int i, nr;
+
+	put_u32(b, index_of_trip(dive->divetrip, trips));
+	put_u32(b, dive->dive_site ? get_divesite_idx(dive->dive_site, sites) : -1);
+	put_raw(b, dive->when);
+	put_str(b, dive->notes);
+	put_str(b, dive->divemaster);
+	put_str(b, dive->buddy);
+	put_str(b, dive->suit);
+	put_raw(b, dive->number);
+	put_raw(b, dive->rating);
+	put_raw(b, dive->wavesize);
+	put_raw(b, dive->current);
+	put_raw(b, dive->visibility);
+	put_raw(b, dive->surge);
+	put_raw(b, dive->chill);
+	put_raw(b, dive->sac);
+	put_raw(b, dive->otu);
+	put_raw(b, dive->cns);
+	put_raw(b, dive->maxcns);
+	put_raw(b, dive->mintemp);
+	put_raw(b, dive->maxtemp);
+	put_raw(b, dive->watertemp);
+	put_raw(b, dive->airtemp);
+	put_raw(b, dive->maxdepth);
+	put_raw(b, dive->meandepth);
+	put_raw(b, dive->surface_pressure);
+	put_raw(b, dive->duration);
+	put_raw(b, dive->salinity);
+	put_raw(b, dive->user_salinity);
+	put_raw(b, dive->git_id);
+	put_raw(b, dive->notrip);
+	put_raw(b, dive->invalid);
+
+	/* The description pointers are written, but replaced when reading */
+	put_u32(b, dive->cylinders.nr);
+	for (i = 0; i < dive->cylinders.nr; i++) {
+		put_raw(b, dive->cylinders.cylinders[i]);
+		put_str(b, dive->cylinders.cylinders[i].type.description);
+	}
+	put_u32(b, dive->weightsystems.nr);
+	for (i = 0; i < dive->weightsystems.nr; i++) {
+		put_raw(b, dive->weightsystems.weightsystems[i]);
+		put_str(b, dive->weightsystems.weightsystems[i].description);
+	}
+	put_u32(b, dive->pictures.nr);
+	for (i = 0; i < dive->pictures.nr; i++) {
+		put_raw(b, dive->pictures.pictures[i]);
+		put_str(b, dive->pictures.pictures[i].filename);
+	}
+
+	for (nr = 0, tag = dive->tag_list; tag; tag = tag->next)
+		nr++;
+	put_u32(b, nr);
+	for (tag = dive->tag_list; tag; tag = tag->next)
+		put_str(b, tag->tag->source ?: tag->tag->name);
+
+	for (nr = 0, dc = &dive->dc; dc; dc = dc->next)
+		nr++;
+	put_u32(b, nr);
+	for_each_dc(dive, dc)
+		write_dc(b, dc);
+}
+
+static struct dive *read_dive(struct snapshot_reader *r, struct trip_table *trips, struct dive_site_table *sites,
+			      const char *samples_repo)
+{
+	struct dive *dive = alloc_dive();
+	struct divecomputer **dcp;
+	int trip_idx, site_idx;
+	int i, nr;
+
+	trip_idx = (int)get_u32(r);
+	site_idx = (int)get_u32(r);
+	get_raw(r, dive->when);
+	dive->notes = get_str(r);
+	dive->divemaster = get_str(r);
+	dive->buddy = get_str(r);
+	dive->suit = get_str(r);
+	get_raw(r, dive->number);
+	get_raw(r, dive->rating);
+	get_raw(r, dive->wavesize);
+	get_raw(r, dive->current);
+	get_raw(r, dive->visibility);
+	get_raw(r, dive->surge);
+	get_raw(r, dive->chill);
+	get_raw(r, dive->sac);
+	get_raw(r, dive->otu);
+	get_raw(r, dive->cns);
+	get_raw(r, dive->maxcns);
+	get_raw(r, dive->mintemp);
+	get_raw(r, dive->maxtemp);
+	get_raw(r, dive->watertemp);
+	get_raw(r, dive->airtemp);
+	get_raw(r, dive->maxdepth);
+	get_raw(r, dive->meandepth);
+	get_raw(r, dive->surface_pressure);
+	get_raw(r, dive->duration);
+	get_raw(r, dive->salinity);
+	get_raw(r, dive->user_salinity);
+	get_raw(r, dive->git_id);
+	get_raw(r, dive->notrip);
+	get_raw(r, dive->invalid);
+
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		cylinder_t cyl;
+		get_raw(r, cyl);
+		cyl.type.description = get_str(r);
+		add_cylinder(&dive->cylinders, i, cyl);
+		add_cylinder_description(&cyl.type);
+	}
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		weightsystem_t ws;
+		get_raw(r, ws);
+		ws.description = get_str(r);
+		add_to_weightsystem_table(&dive->weightsystems, i, ws);
+		add_weightsystem_description(&ws);
+	}
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		struct picture pic;
+		get_raw(r, pic);
+		pic.filename = get_str(r);
+		add_to_picture_table(&dive->pictures, i, pic);
+	}
+
+	nr = get_count(r);
+	for (i = 0; i < nr && !r->error; i++) {
+		char *tag = get_str(r);
+		taglist_add_tag(&dive->tag_list, tag ?: "");
+		free(tag);
+	}
+
+	nr = get_count(r);
+	dcp = &dive->dc.next;
+	for (i = 0; i < nr && !r->error; i++) {
+		struct divecomputer *dc = &dive->dc;
+		if (i > 0) {
+			dc = calloc(1, sizeof(*dc));
+			*dcp = dc;
+			dcp = &dc->next;
+		}
+		read_dc(r, dc, samples_repo);
+	}
+
+	if (trip_idx >= trips->nr || site_idx >= sites->nr)
+		r->error = true;
+	if (r->error)
+		return dive;
+	if (trip_idx >= 0)
+		add_dive_to_trip(dive, trips->trips[trip_idx]);
+	if (site_idx >= 0)
+		add_dive_to_dive_site(dive, sites->dive_sites[site_idx]);
+	return dive;
+}
+
+void save_snapshot(const char *source, const char *key,
+		   struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+		   struct device_table *devices, struct filter_preset_table *filter_presets)
+{
+	struct membuffer buf = { 0 };
+	struct snapshot_header header;
+	char *dir, *tmp, *final;
+	FILE *f;
+	int i;
+
+	if (nr_filter_presets(filter_presets))
+		return;
+
+	fill_header(&header, key);
+	put_raw(&buf, header);
+	write_settings(&buf);
+	write_devices(&buf, devices);
+	write_sites(&buf, sites);
+	write_trips(&buf, trips);
+	put_u32(&buf, table->nr);
+	for (i = 0; i < table->nr; i++)
+		write_dive(&buf, table->dives[i], trips, sites);
+
+	dir = format_string("%s/snapshots", system_default_directory());
+	subsurface_mkdir(dir);
+	free(dir);
+	final = snapshot_filename(source);
+	tmp = format_string("%s.tmp", final);
+	f = subsurface_fopen(tmp, "wb");
+	if (f) {
+		int error;
+
+		flush_buffer(&buf, f);
+		error = ferror(f);
+		if (fclose(f))
+			error = 1;
+		if (error || subsurface_rename(tmp, final))
+			unlink(tmp);
+	}
+	free(tmp);
+	free(final);
+	free_buffer(&buf);
+}
+
+static void free_snapshot_tables(struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites)
+{
+	int i;
+
+	for (i = 0; i < table->nr; i++)
+		free_dive(table->dives[i]);
+	for (i = 0; i < trips->nr; i++)
+		free_trip(trips->trips[i]);
+	for (i = 0; i < sites->nr; i++)
+		free_dive_site(sites->dive_sites[i]);
+	free(table->dives);
+	free(trips->trips);
+	free(sites->dive_sites);
+}
+
+int load_snapshot(const char *source, const char *key, const char *samples_repo,
+		  struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+		  struct device_table *devices)
+{
+	struct dive_table snapshot_dives = empty_dive_table;
+	struct trip_table snapshot_trips = { 0 };
+	struct dive_site_table snapshot_sites = empty_dive_site_table;
+	struct device_table *snapshot_devices;
+	struct snapshot_header header, expected;
+	struct snapshot_settings settings;
+	struct snapshot_reader r;
+	struct memblock mem;
+	char *filename;
+	int i, nr;
+
+	filename = snapshot_filename(source);
+	if (readfile(filename, &mem) <= 0) {
+		free(filename);
+		return -1;
+	}
+	free(filename);
+
+	r.p = mem.buffer;
+	r.end = r.p + mem.size;
+	r.error = false;
+	fill_header(&expected, key);
+	get_raw(&r, header);
+	if (r.error || memcmp(&header, &expected, sizeof(header))) {
+		free(mem.buffer);
+		return -1;
+	}
+
+	/* Read everything into our own tables, so that nothing leaks out if the snapshot is corrupt */
+	snapshot_devices = alloc_device_table();
+	read_settings(&r, &settings);
+	read_devices(&r, snapshot_devices);
+	read_sites(&r, &snapshot_sites);
+	read_trips(&r, &snapshot_trips);
+	nr = get_count(&r);
+	for (i = 0; i < nr && !r.error; i++)
+		add_to_dive_table(&snapshot_dives, snapshot_dives.nr, read_dive(&r, &snapshot_trips, &snapshot_sites, samples_repo));
+	free(mem.buffer);
+
+	if (r.error || r.p != r.end) {
+		free_snapshot_tables(&snapshot_dives, &snapshot_trips, &snapshot_sites);
+		free_device_table(snapshot_devices);
+		return -1;
+	}
+
+	apply_settings(&settings);
+	free(table->dives);
+	*table = snapshot_dives;
+	free(sites->dive_sites);
+	*sites = snapshot_sites;
+	for (i = 0; i < snapshot_trips.nr; i++)
+		insert_trip(snapshot_trips.trips[i], trips);
+	free(snapshot_trips.trips);
+	for (i = 0; i < nr_devices(snapshot_devices); i++)
+		add_to_device_table(devices, get_device(snapshot_devices, i));
+	free_device_table(snapshot_devices);
+	return 0;
+}
+
+void remove_snapshot(const char *source)
+{
+	char *filename = snapshot_filename(source);
+
+	unlink(filename);
+	free(filename);
+}
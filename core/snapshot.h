@@ -0,0 +1,45 @@
+// SPDX-License-Identifier: GPL-2.0
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dive_table;
+struct trip_table;
+struct dive_site_table;
+struct device_table;
+struct filter_preset_table;
+
+/*
+ * A snapshot is a binary dump of the fully fixed-up tables that
+ * a parser produced for a dive log, together with the global
+ * side effects of parsing (autogroup, git preferences, datafile
+ * version). It is tagged with a key identifying the content of
+ * the log (the commit id for git repositories, a hash of the file
+ * for everything else), so that it can be used instead of parsing
+ * the log as long as the log doesn't change.
+ */
+extern bool snapshot_cache;
+
+extern bool snapshot_applies(struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+			     struct device_table *devices, struct filter_preset_table *filter_presets);
+/* returns 0 if the tables were filled from the snapshot, -1 otherwise */
+extern int load_snapshot(const char *source, const char *key, const char *samples_repo,
+			 struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+			 struct device_table *devices);
+extern void save_snapshot(const char *source, const char *key,
+			  struct dive_table *table, struct trip_table *trips, struct dive_site_table *sites,
+			  struct device_table *devices, struct filter_preset_table *filter_presets);
+extern char *snapshot_key_from_buffer(const void *buffer, size_t size);
+extern void remove_snapshot(const char *source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SNAPSHOT_H
@@ -316,10 +316,11 @@ void calculate_stats_selected(stats_t *stats_selection)
 bool has_gaschange_event(const struct dive *dive, const struct divecomputer *dc, int idx)
 {
 	bool first_gas_explicit = false;
+	duration_t first_time;
+	bool has_samples = get_first_sample_time(dc, &first_time);
 	const struct event *event = get_next_event(dc->events, "gaschange");
 	while (event) {
-		if (dc->sample && (event->time.seconds == 0 ||
-				   (dc->samples && dc->sample[0].time.seconds == event->time.seconds)))
+		if (has_samples && (event->time.seconds == 0 || first_time.seconds == event->time.seconds))
 			first_gas_explicit = true;
 		if (get_cylinder_index(dive, event) == idx)
 			return true;
@@ -7,6 +7,7 @@
 #include "qthelper.h"
 #include "git-access.h"
 #include "pref.h"
+#include "snapshot.h"
 #include "libdivecomputer/version.h"
 
 #include <stdbool.h>
@@ -82,6 +83,7 @@ static void print_help()
 	printf("\n --help|-h             This help text");
 	printf("\n --ignore-bt           Don't enable Bluetooth support");
 	printf("\n --import logfile ...  Logs before this option is treated as base, everything after is imported");
+	printf("\n --snapshot-cache      Keep a binary snapshot of the dive log for faster startup");
 	printf("\n --verbose|-v          Verbose debug (repeat to increase verbosity)");
 	printf("\n --version             Prints current version");
 	printf("\n --user=<test>         Choose configuration space for user <test>");
@@ -137,6 +139,10 @@ void parse_argument(const char *arg)
 				imported = true; /* mark the dives so far as the base, * everything after is imported */
 				return;
 			}
+			if (strcmp(arg, "--snapshot-cache") == 0) {
+				snapshot_cache = true;
+				return;
+			}
 			if (strcmp(arg, "--verbose") == 0) {
 				print_version();
 				verbose++;
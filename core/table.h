@@ -23,39 +23,63 @@
 	}
 
 /* get the index where we want to insert an object so that everything stays
- * ordered according to a comparison function() */
+ * ordered according to a comparison function(). Objects that compare equal
+ * are inserted after the existing ones. */
 #define MAKE_GET_INSERTION_INDEX(table_type, item_type, array_name, fun)		\
 	int table_type##_get_insertion_index(struct table_type *table, item_type item)	\
 	{										\
-		/* we might want to use binary search here */				\
-		for (int i = 0; i < table->nr; i++) {					\
-			if (fun(item, table->array_name[i]))				\
-				return i;						\
+		int lo = 0, hi = table->nr;						\
+		while (lo < hi) {							\
+			int mid = lo + (hi - lo) / 2;					\
+			if (fun(item, table->array_name[mid]))				\
+				hi = mid;						\
+			else								\
+				lo = mid + 1;						\
 		}									\
-		return table->nr;							\
+		return lo;								\
 	}
 
 /* add object at the given index to a table. */
 #define MAKE_ADD_TO(table_type, item_type, array_name)					\
 	void add_to_##table_type(struct table_type *table, int idx, item_type item)	\
 	{										\
-		int i;									\
 		grow_##table_type(table);						\
+		memmove(&table->array_name[idx + 1], &table->array_name[idx],		\
+			(table->nr - idx) * sizeof(item_type));				\
+		table->array_name[idx] = item;						\
 		table->nr++;								\
-											\
-		for (i = idx; i < table->nr; i++) {					\
-			item_type tmp = table->array_name[i];				\
-			table->array_name[i] = item;					\
-			item = tmp;							\
-		}									\
+	}
+
+/* add all objects of a sorted table to a table ordered according to the same
+ * comparison function(). This gives the same result as inserting them one by
+ * one, but in linear time. The source table is empty after the call. */
+#define MAKE_ADD_BATCH_TO(table_type, item_type, array_name, fun)				\
+	void add_batch_to_##table_type(struct table_type *table, struct table_type *batch)	\
+	{											\
+		int i = table->nr - 1, j = batch->nr - 1, k = table->nr + batch->nr - 1;	\
+		if (table->nr + batch->nr > table->allocated) {					\
+			item_type *items;							\
+			table->allocated = (table->nr + batch->nr + 32) * 3 / 2;		\
+			items = realloc(table->array_name, table->allocated * sizeof(item_type)); \
+			if (!items)								\
+				exit(1);							\
+			table->array_name = items;						\
+		}										\
+		while (j >= 0) {								\
+			if (i >= 0 && fun(batch->array_name[j], table->array_name[i]))		\
+				table->array_name[k--] = table->array_name[i--];		\
+			else									\
+				table->array_name[k--] = batch->array_name[j--];		\
+		}										\
+		table->nr += batch->nr;								\
+		batch->nr = 0;									\
 	}
 
 #define MAKE_REMOVE_FROM(table_type, array_name)						\
 	void remove_from_##table_type(struct table_type *table, int idx)			\
 	{											\
-		int i;										\
-		for (i = idx; i < table->nr - 1; i++)						\
-			table->array_name[i] = table->array_name[i + 1];			\
+		memmove(&table->array_name[idx], &table->array_name[idx + 1],			\
+			(table->nr - idx - 1) * sizeof(table->array_name[0]));			\
 		memset(&table->array_name[--table->nr], 0, sizeof(table->array_name[0]));	\
 	}
 
@@ -50,6 +50,7 @@ static MAKE_GET_IDX(trip_table, struct dive_trip *, trips)
 static MAKE_GROW_TABLE(trip_table, struct dive_trip *, trips)
 static MAKE_GET_INSERTION_INDEX(trip_table, struct dive_trip *, trips, trip_less_than)
 static MAKE_ADD_TO(trip_table, struct dive_trip *, trips)
+static MAKE_ADD_BATCH_TO(trip_table, struct dive_trip *, trips, trip_less_than)
 static MAKE_REMOVE_FROM(trip_table, trips)
 MAKE_SORT(trip_table, struct dive_trip *, trips, comp_trips)
 MAKE_REMOVE(trip_table, struct dive_trip *, trip)
@@ -143,6 +144,16 @@ void insert_trip(dive_trip_t *dive_trip, struct trip_table *trip_table_arg)
 #endif
 }
 
+/* insert all trips of a table into the trip table, the source table is empty afterwards */
+void insert_trips(struct trip_table *trips, struct trip_table *trip_table_arg)
+{
+	sort_trip_table(trips);
+	add_batch_to_trip_table(trip_table_arg, trips);
+#ifdef DEBUG_TRIP
+	dump_trip_list();
+#endif
+}
+
 dive_trip_t *create_trip_from_dive(struct dive *dive)
 {
 	dive_trip_t *trip;
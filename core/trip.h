@@ -18,6 +18,9 @@ typedef struct dive_trip
 	bool saved;
 	bool autogen;
 	bool selected;
+	/* The git tree of the trip directory and a hash of what was written into it, see save-git.c */
+	unsigned char git_id[20];
+	unsigned char git_sig[20];
 } dive_trip_t;
 
 typedef struct trip_table {
@@ -32,6 +35,7 @@ extern struct dive_trip *unregister_dive_from_trip(struct dive *dive);
 extern void remove_dive_from_trip(struct dive *dive, struct trip_table *trip_table_arg);
 
 extern void insert_trip(dive_trip_t *trip, struct trip_table *trip_table_arg);
+extern void insert_trips(struct trip_table *trips, struct trip_table *trip_table_arg);
 extern int remove_trip(const dive_trip_t *trip, struct trip_table *trip_table_arg);
 extern void free_trip(dive_trip_t *trip);
 extern timestamp_t trip_date(const struct dive_trip *trip);
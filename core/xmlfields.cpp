@@ -0,0 +1,146 @@
+// SPDX-License-Identifier: GPL-2.0
+// Perfect hash tables of the field names of xmlfields.h. The tables are
+// built by the compiler: for every context a seed is searched for which
+// the hashes of all names fall into different slots, so that a lookup
+// takes one hash and one string comparison. The tables are constant and
+// can therefore be used by parsers running in different threads.
+
+#include "xmlfields.h"
+
+#include <array>
+#include <stdint.h>
+#include <string_view>
+
+namespace {
+
+constexpr uint32_t fieldHash(std::string_view name, uint32_t seed)
+{
+	uint32_t hash = 2166136261u ^ seed;
+	for (char c: name)
+		hash = (hash ^ (unsigned char)c) * 16777619u;
+	return hash ^ (hash >> 16);
+}
+
+// Same as match_name() in parse-xml.c
+constexpr bool matchesName(std::string_view pattern, std::string_view name)
+{
+	if (pattern.size() > name.size() || (pattern.size() < name.size() && name[pattern.size()] != '.'))
+		return false;
+	for (size_t i = 0; i < pattern.size(); ++i) {
+		if (pattern[i] != name[i])
+			return false;
+	}
+	return true;
+}
+
+// Sixteen slots per name make it likely to find a seed after a few tries
+constexpr size_t tableSize(size_t n)
+{
+	size_t size = 1;
+	while (size < 16 * n)
+		size *= 2;
+	return size;
+}
+
+template <size_t N>
+struct FieldTable {
+	static_assert(N < 128, "field index doesn't fit into a slot");
+	static constexpr size_t size = tableSize(N);
+	std::array<std::string_view, N> names;
+	std::array<xml_field_match, N> matches;
+	std::array<int8_t, size> slots; // index into names or -1
+	uint32_t seed;
+
+	const xml_field_match *find(std::string_view name) const
+	{
+		int idx = slots[fieldHash(name, seed) & (size - 1)];
+		return idx >= 0 && names[idx] == name ? &matches[idx] : nullptr;
+	}
+};
+
+// Throwing makes the compilation fail, since the tables are constexpr
+template <size_t N>
+constexpr FieldTable<N> makeFieldTable(const std::array<std::string_view, N> &names)
+{
+	FieldTable<N> table { names, {}, {}, 0 };
+	for (size_t i = 0; i < N; ++i) {
+		xml_field_match &match = table.matches[i];
+		for (size_t j = 0; j < N; ++j) {
+			if (!matchesName(names[j], names[i]))
+				continue;
+			if (j != i && names[j].size() == names[i].size())
+				throw "duplicate field name";
+			if (match.nr >= XML_MAX_FIELD_MATCHES)
+				throw "too many matching field names";
+			match.fields[match.nr++] = (int)j;
+		}
+	}
+
+	// Remember in which round a slot was used, so that it doesn't have
+	// to be cleared for every seed that is tried
+	std::array<uint32_t, FieldTable<N>::size> used {};
+	for (table.seed = 0; table.seed < 10000; ++table.seed) {
+		bool collision = false;
+		for (size_t i = 0; i < N && !collision; ++i) {
+			uint32_t &round = used[fieldHash(names[i], table.seed) & (table.size - 1)];
+			collision = round == table.seed + 1;
+			round = table.seed + 1;
+		}
+		if (!collision)
+			break;
+	}
+	if (table.seed == 10000)
+		throw "no perfect hash found";
+
+	for (size_t i = 0; i < table.size; ++i)
+		table.slots[i] = -1;
+	for (size_t i = 0; i < N; ++i)
+		table.slots[fieldHash(names[i], table.seed) & (table.size - 1)] = (int8_t)i;
+	return table;
+}
+
+#define FIELD_NAME(id, name) name,
+#define FIELD_TABLE(FIELDS, NR) makeFieldTable(std::array<std::string_view, NR> { FIELDS(FIELD_NAME) })
+
+constexpr auto sampleFields = FIELD_TABLE(XML_SAMPLE_FIELDS, XML_SAMPLE_FIELD_NR);
+constexpr auto dcFields = FIELD_TABLE(XML_DC_FIELDS, XML_DC_FIELD_NR);
+constexpr auto dcDataFields = FIELD_TABLE(XML_DC_DATA_FIELDS, XML_DC_DATA_FIELD_NR);
+constexpr auto diveFields = FIELD_TABLE(XML_DIVE_FIELDS, XML_DIVE_FIELD_NR);
+constexpr auto eventFields = FIELD_TABLE(XML_EVENT_FIELDS, XML_EVENT_FIELD_NR);
+constexpr auto divesiteFields = FIELD_TABLE(XML_DIVESITE_FIELDS, XML_DIVESITE_FIELD_NR);
+
+const xml_field_match *find(enum xml_field_context context, std::string_view name)
+{
+	switch (context) {
+	case XML_SAMPLE_CONTEXT:
+		return sampleFields.find(name);
+	case XML_DC_CONTEXT:
+		return dcFields.find(name);
+	case XML_DC_DATA_CONTEXT:
+		return dcDataFields.find(name);
+	case XML_DIVE_CONTEXT:
+		return diveFields.find(name);
+	case XML_EVENT_CONTEXT:
+		return eventFields.find(name);
+	case XML_DIVESITE_CONTEXT:
+		return divesiteFields.find(name);
+	}
+	return nullptr;
+}
+
+} // namespace
+
+// The matches of a field name include the names that it starts with,
+// therefore the longest name that is found is the answer.
+extern "C" const struct xml_field_match *xml_match_field(enum xml_field_context context, const char *name)
+{
+	std::string_view s(name);
+	for (;;) {
+		if (const xml_field_match *match = find(context, s))
+			return match;
+		size_t dot = s.rfind('.');
+		if (dot == std::string_view::npos)
+			return nullptr;
+		s = s.substr(0, dot);
+	}
+}
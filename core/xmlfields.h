@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: GPL-2.0
+// The names of the values that the XML parser understands in the most
+// frequently used contexts. A name in a list matches an attribute or
+// element if it is the same or if it is followed by a '.' in the node
+// name, e.g. "heartbeat" matches "heartbeat.sample". If more than one
+// name matches, the first one in the list wins, unless its handler
+// rejects the value (e.g. a weight without a weight system).
+//
+// The lists are turned into enums here and into perfect hash tables,
+// which are generated at compile time, in xmlfields.cpp.
+
+#ifndef XMLFIELDS_H
+#define XMLFIELDS_H
+
+#define XML_SAMPLE_FIELDS(X) \
+	X(SAMPLE_PRESSURE, "pressure.sample") \
+	X(SAMPLE_CYLPRESS, "cylpress.sample") \
+	X(SAMPLE_PDILUENT, "pdiluent.sample") \
+	X(SAMPLE_O2PRESSURE, "o2pressure.sample") \
+	X(SAMPLE_PRESSURE0, "pressure0.sample") \
+	X(SAMPLE_PRESSURE1, "pressure1.sample") \
+	X(SAMPLE_PRESSURE2, "pressure2.sample") \
+	X(SAMPLE_PRESSURE3, "pressure3.sample") \
+	X(SAMPLE_PRESSURE4, "pressure4.sample") \
+	X(SAMPLE_CYLINDERINDEX, "cylinderindex.sample") \
+	X(SAMPLE_SENSOR, "sensor.sample") \
+	X(SAMPLE_DEPTH, "depth.sample") \
+	X(SAMPLE_TEMP, "temp.sample") \
+	X(SAMPLE_TEMPERATURE, "temperature.sample") \
+	X(SAMPLE_SAMPLETIME, "sampletime.sample") \
+	X(SAMPLE_TIME, "time.sample") \
+	X(SAMPLE_NDL, "ndl.sample") \
+	X(SAMPLE_TTS, "tts.sample") \
+	X(SAMPLE_IN_DECO, "in_deco.sample") \
+	X(SAMPLE_STOPTIME, "stoptime.sample") \
+	X(SAMPLE_STOPDEPTH, "stopdepth.sample") \
+	X(SAMPLE_CNS, "cns.sample") \
+	X(SAMPLE_RBT, "rbt.sample") \
+	X(SAMPLE_SENSOR1, "sensor1.sample") \
+	X(SAMPLE_SENSOR2, "sensor2.sample") \
+	X(SAMPLE_SENSOR3, "sensor3.sample") \
+	X(SAMPLE_PO2, "po2.sample") \
+	X(SAMPLE_HEARTBEAT, "heartbeat") \
+	X(SAMPLE_BEARING, "bearing") \
+	X(SAMPLE_SETPOINT, "setpoint.sample") \
+	X(SAMPLE_PPO2, "ppo2.sample") \
+	X(SAMPLE_DECO, "deco.sample") \
+	X(SAMPLE_DECO_TIME, "time.deco") \
+	X(SAMPLE_DECO_DEPTH, "depth.deco")
+
+#define XML_DC_FIELDS(X) \
+	X(DC_DATE, "date") \
+	X(DC_TIME, "time") \
+	X(DC_MODEL, "model") \
+	X(DC_DEVICEID, "deviceid") \
+	X(DC_DIVEID, "diveid") \
+	X(DC_DCTYPE, "dctype") \
+	X(DC_NO_O2SENSORS, "no_o2sensors")
+
+/* Shared by dive computers and, for the legacy format, dives */
+#define XML_DC_DATA_FIELDS(X) \
+	X(DC_DATA_MAXDEPTH, "maxdepth") \
+	X(DC_DATA_MEANDEPTH, "meandepth") \
+	X(DC_DATA_MAX_DEPTH, "max.depth") \
+	X(DC_DATA_MEAN_DEPTH, "mean.depth") \
+	X(DC_DATA_DURATION, "duration") \
+	X(DC_DATA_DIVETIME, "divetime") \
+	X(DC_DATA_DIVETIMESEC, "divetimesec") \
+	X(DC_DATA_LAST_MANUAL_TIME, "last-manual-time") \
+	X(DC_DATA_SURFACETIME, "surfacetime") \
+	X(DC_DATA_AIRTEMP, "airtemp") \
+	X(DC_DATA_WATERTEMP, "watertemp") \
+	X(DC_DATA_AIR_TEMPERATURE, "air.temperature") \
+	X(DC_DATA_WATER_TEMPERATURE, "water.temperature") \
+	X(DC_DATA_SURFACE_PRESSURE, "pressure.surface") \
+	X(DC_DATA_SALINITY_WATER, "salinity.water") \
+	X(DC_DATA_EXTRADATA_KEY, "key.extradata") \
+	X(DC_DATA_EXTRADATA_VALUE, "value.extradata") \
+	X(DC_DATA_DIVEMODE, "divemode") \
+	X(DC_DATA_SALINITY, "salinity") \
+	X(DC_DATA_ATMOSPHERIC, "atmospheric")
+
+/* Includes the values of the last weight system and cylinder */
+#define XML_DIVE_FIELDS(X) \
+	X(DIVE_DIVESITEID, "divesiteid") \
+	X(DIVE_NUMBER, "number") \
+	X(DIVE_TAGS, "tags") \
+	X(DIVE_TRIPFLAG, "tripflag") \
+	X(DIVE_DATE, "date") \
+	X(DIVE_TIME, "time") \
+	X(DIVE_DATETIME, "datetime") \
+	X(DIVE_PICTURE_FILENAME, "filename.picture") \
+	X(DIVE_PICTURE_OFFSET, "offset.picture") \
+	X(DIVE_PICTURE_GPS, "gps.picture") \
+	X(DIVE_PICTURE_HASH, "hash.picture") \
+	X(DIVE_CYLINDERSTARTPRESSURE, "cylinderstartpressure") \
+	X(DIVE_CYLINDERENDPRESSURE, "cylinderendpressure") \
+	X(DIVE_GPS, "gps") \
+	X(DIVE_PLACE, "Place") \
+	X(DIVE_LATITUDE, "latitude") \
+	X(DIVE_SITELAT, "sitelat") \
+	X(DIVE_LAT, "lat") \
+	X(DIVE_LONGITUDE, "longitude") \
+	X(DIVE_SITELON, "sitelon") \
+	X(DIVE_LON, "lon") \
+	X(DIVE_LOCATION, "location") \
+	X(DIVE_NAME, "name.dive") \
+	X(DIVE_SUIT, "suit") \
+	X(DIVE_DIVESUIT, "divesuit") \
+	X(DIVE_NOTES, "notes") \
+	X(DIVE_DIVEMASTER, "divemaster") \
+	X(DIVE_BUDDY, "buddy") \
+	X(DIVE_WATERSALINITY, "watersalinity") \
+	X(DIVE_RATING, "rating.dive") \
+	X(DIVE_VISIBILITY, "visibility.dive") \
+	X(DIVE_WAVESIZE, "wavesize.dive") \
+	X(DIVE_CURRENT, "current.dive") \
+	X(DIVE_SURGE, "surge.dive") \
+	X(DIVE_CHILL, "chill.dive") \
+	X(DIVE_AIRPRESSURE, "airpressure.dive") \
+	X(DIVE_WS_DESCRIPTION, "description.weightsystem") \
+	X(DIVE_WS_WEIGHT, "weight.weightsystem") \
+	X(DIVE_WEIGHT, "weight") \
+	X(DIVE_CYL_SIZE, "size.cylinder") \
+	X(DIVE_CYL_WORKPRESSURE, "workpressure.cylinder") \
+	X(DIVE_CYL_DESCRIPTION, "description.cylinder") \
+	X(DIVE_CYL_START, "start.cylinder") \
+	X(DIVE_CYL_END, "end.cylinder") \
+	X(DIVE_CYL_USE, "use.cylinder") \
+	X(DIVE_CYL_DEPTH, "depth.cylinder") \
+	X(DIVE_CYL_O2, "o2") \
+	X(DIVE_CYL_O2PERCENT, "o2percent") \
+	X(DIVE_CYL_N2, "n2") \
+	X(DIVE_CYL_HE, "he") \
+	X(DIVE_AIRTEMP, "air.divetemperature") \
+	X(DIVE_WATERTEMP, "water.divetemperature") \
+	X(DIVE_INVALID, "invalid")
+
+#define XML_EVENT_FIELDS(X) \
+	X(EVENT_EVENT, "event") \
+	X(EVENT_NAME, "name") \
+	X(EVENT_TIME, "time") \
+	X(EVENT_TYPE, "type") \
+	X(EVENT_FLAGS, "flags") \
+	X(EVENT_VALUE, "value") \
+	X(EVENT_DIVEMODE, "divemode") \
+	X(EVENT_CYLINDER, "cylinder") \
+	X(EVENT_O2, "o2") \
+	X(EVENT_HE, "he")
+
+#define XML_DIVESITE_FIELDS(X) \
+	X(DIVESITE_UUID, "uuid") \
+	X(DIVESITE_NAME, "name") \
+	X(DIVESITE_DESCRIPTION, "description") \
+	X(DIVESITE_NOTES, "notes") \
+	X(DIVESITE_GPS, "gps") \
+	X(DIVESITE_TAXONOMY_CATEGORY, "cat.geo") \
+	X(DIVESITE_TAXONOMY_ORIGIN, "origin.geo") \
+	X(DIVESITE_TAXONOMY_VALUE, "value.geo")
+
+#define XML_FIELD_ENUM(id, name) XML_##id,
+enum xml_sample_field { XML_SAMPLE_FIELDS(XML_FIELD_ENUM) XML_SAMPLE_FIELD_NR };
+enum xml_dc_field { XML_DC_FIELDS(XML_FIELD_ENUM) XML_DC_FIELD_NR };
+enum xml_dc_data_field { XML_DC_DATA_FIELDS(XML_FIELD_ENUM) XML_DC_DATA_FIELD_NR };
+enum xml_dive_field { XML_DIVE_FIELDS(XML_FIELD_ENUM) XML_DIVE_FIELD_NR };
+enum xml_event_field { XML_EVENT_FIELDS(XML_FIELD_ENUM) XML_EVENT_FIELD_NR };
+enum xml_divesite_field { XML_DIVESITE_FIELDS(XML_FIELD_ENUM) XML_DIVESITE_FIELD_NR };
+#undef XML_FIELD_ENUM
+
+enum xml_field_context {
+	XML_SAMPLE_CONTEXT,
+	XML_DC_CONTEXT,
+	XML_DC_DATA_CONTEXT,
+	XML_DIVE_CONTEXT,
+	XML_EVENT_CONTEXT,
+	XML_DIVESITE_CONTEXT
+};
+
+#define XML_MAX_FIELD_MATCHES 4
+
+/* The fields matching a name, in the order of the list */
+struct xml_field_match {
+	int nr;
+	int fields[XML_MAX_FIELD_MATCHES];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returns NULL if no field of the context matches the name */
+extern const struct xml_field_match *xml_match_field(enum xml_field_context context, const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XMLFIELDS_H
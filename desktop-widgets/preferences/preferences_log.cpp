@@ -72,6 +72,8 @@ void PreferencesLog::refreshSettings()
 	ui->displayinvalid->setChecked(qPrefDisplay::display_invalid_dives());
 	ui->extraEnvironmentalDefault->setChecked(prefs.extraEnvironmentalDefault);
 	ui->salinityEditDefault->setChecked(prefs.salinityEditDefault);
+	ui->compact_samples->setChecked(prefs.compact_samples);
+	ui->lazy_samples->setChecked(prefs.lazy_samples);
 }
 
 void PreferencesLog::syncSettings()
@@ -92,6 +94,8 @@ void PreferencesLog::syncSettings()
 	qPrefDisplay::set_display_invalid_dives(ui->displayinvalid->isChecked());
 	qPrefLog::set_extraEnvironmentalDefault(ui->extraEnvironmentalDefault->isChecked());
 	qPrefLog::set_salinityEditDefault(ui->salinityEditDefault->isChecked());
+	qPrefLog::set_compact_samples(ui->compact_samples->isChecked());
+	qPrefLog::set_lazy_samples(ui->lazy_samples->isChecked());
 
 	// TODO: Move to preferences code?
 	if (displayinvalid_changed)
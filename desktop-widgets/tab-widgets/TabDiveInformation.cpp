@@ -108,6 +108,7 @@ void TabDiveInformation::updateWaterTypeWidget()
 // Update fields that depend on the dive profile
 void TabDiveInformation::updateProfile()
 {
+	load_dive_samples(current_dive);
 	ui->maxcnsText->setText(QString("%L1\%").arg(current_dive->maxcns));
 	ui->otuText->setText(QString("%L1").arg(current_dive->otu));
 	ui->maximumDepthText->setText(get_depth_string(current_dive->maxdepth, true));
@@ -2,6 +2,7 @@
 #include <QApplication>
 #include <QClipboard>
 #include <QDebug>
+#include <QSet>
 #include <QVector>
 
 #include "qmlmapwidgethelper.h"
@@ -162,15 +163,46 @@ void MapWidgetHelper::selectedLocationChanged(struct dive_site *ds_in)
 	emit selectedDivesChanged(selectedDiveIds);
 }
 
+static location_t mk_location(QGeoCoordinate coord)
+{
+	return create_location(coord.latitude(), coord.longitude());
+}
+
+static void appendDiveSite(struct dive_site *ds, void *data)
+{
+	static_cast<QVector<dive_site *> *>(data)->append(ds);
+}
+
 void MapWidgetHelper::selectVisibleLocations()
 {
 	int idx;
 	struct dive *dive;
 	QList<int> selectedDiveIds;
-	for_each_dive (idx, dive) {
-		struct dive_site *ds = get_dive_site_for_dive(dive);
-		if (!dive_site_has_gps_location(ds))
-			continue;
+
+	// Only the dive sites in the bounding box of the map can be visible
+	QGeoCoordinate topLeft, bottomRight;
+	QPointF corner(m_map->property("width").toReal(), m_map->property("height").toReal());
+	QMetaObject::invokeMethod(m_map, "toCoordinate", Q_RETURN_ARG(QGeoCoordinate, topLeft),
+	                          Q_ARG(QPointF, QPointF(0.0, 0.0)));
+	QMetaObject::invokeMethod(m_map, "toCoordinate", Q_RETURN_ARG(QGeoCoordinate, bottomRight),
+	                          Q_ARG(QPointF, corner));
+	QVector<dive_site *> candidates;
+	if (topLeft.isValid() && bottomRight.isValid()) {
+		location_t southWest = mk_location(QGeoCoordinate(bottomRight.latitude(), topLeft.longitude()));
+		location_t northEast = mk_location(QGeoCoordinate(topLeft.latitude(), bottomRight.longitude()));
+		struct dive_site_index *index = create_dive_site_index(&dive_site_table);
+		dive_site_index_for_each_in_area(index, &southWest, &northEast, appendDiveSite, &candidates);
+		free_dive_site_index(index);
+	} else {
+		// The corners are off the map, e.g. when zoomed out completely
+		for (int i = 0; i < dive_site_table.nr; ++i) {
+			if (dive_site_has_gps_location(dive_site_table.dive_sites[i]))
+				candidates.append(dive_site_table.dive_sites[i]);
+		}
+	}
+
+	QSet<dive_site *> visibleSites;
+	for (dive_site *ds: candidates) {
 		const qreal latitude = ds->location.lat.udeg * 0.000001;
 		const qreal longitude = ds->location.lon.udeg * 0.000001;
 		QGeoCoordinate dsCoord(latitude, longitude);
@@ -178,6 +210,12 @@ void MapWidgetHelper::selectVisibleLocations()
 		QMetaObject::invokeMethod(m_map, "fromCoordinate", Q_RETURN_ARG(QPointF, point),
 		                          Q_ARG(QGeoCoordinate, dsCoord));
 		if (!qIsNaN(point.x()))
+			visibleSites.insert(ds);
+	}
+
+	for_each_dive (idx, dive) {
+		struct dive_site *ds = get_dive_site_for_dive(dive);
+		if (visibleSites.contains(ds))
 #ifndef SUBSURFACE_MOBILE // indices on desktop
 			selectedDiveIds.append(idx);
 	}
@@ -218,11 +256,6 @@ void MapWidgetHelper::calculateSmallCircleRadius(QGeoCoordinate coord)
 	m_smallCircleRadius = coord2.distanceTo(coord);
 }
 
-static location_t mk_location(QGeoCoordinate coord)
-{
-	return create_location(coord.latitude(), coord.longitude());
-}
-
 void MapWidgetHelper::copyToClipboardCoordinates(QGeoCoordinate coord, bool formatTraditional)
 {
 	bool savep = prefs.coordinates_traditional;
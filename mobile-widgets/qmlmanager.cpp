@@ -1255,7 +1255,7 @@ void QMLManager::commitChanges(QString diveId, QString number, QString date, QSt
 		if (d->maxdepth.mm == d->dc.maxdepth.mm &&
 		    d->maxdepth.mm > 0 &&
 		    same_string(d->dc.model, "manually added dive") &&
-		    d->dc.samples == 0) {
+		    get_sample_count(&d->dc) == 0) {
 			// so we have depth > 0, a manually added dive and no samples
 			// let's create an actual profile so the desktop version can work it
 			// first clear out the mean depth (or the fake_dc() function tries
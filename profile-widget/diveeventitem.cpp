@@ -218,10 +218,10 @@ bool DiveEventItem::shouldBeHidden()
 	 * Some gas change events are special. Some dive computers just tell us the initial gas this way.
 	 * Don't bother showing those
 	 */
-	const struct sample *first_sample = &dc->sample[0];
+	duration_t first_time;
 	if (!strcmp(ev->name, "gaschange") &&
 	    (ev->time.seconds == 0 ||
-	     (first_sample && ev->time.seconds == first_sample->time.seconds) ||
+	     (get_first_sample_time(dc, &first_time) && ev->time.seconds == first_time.seconds) ||
 	     depthAtTime(ev->time.seconds) < SURFACE_THRESHOLD))
 		return true;
 
@@ -4,6 +4,7 @@
 #include "core/event.h"
 #include "core/subsurface-string.h"
 #include "core/qthelper.h"
+#include "core/plotinfocache.h"
 #include "core/profile.h"
 #include "core/settings/qPrefDisplay.h"
 #include "core/settings/qPrefTechnicalDetails.h"
@@ -14,6 +15,7 @@
 #include "profile-widget/divehandler.h"
 #include "core/planner.h"
 #include "core/device.h"
+#include "core/divelist.h"
 #include "profile-widget/ruleritem.h"
 #include "profile-widget/tankitem.h"
 #include "core/pref.h"
@@ -506,6 +508,7 @@ void ProfileWidget2::plotDive(const struct dive *dIn, int dcIn, bool doClearPict
 		setEmptyState();
 		return;
 	}
+	load_deco_dive_samples(d);
 
 	QElapsedTimer measureDuration; // let's measure how long this takes us (maybe we'll turn of TTL calculation later
 	measureDuration.start();
@@ -528,7 +531,7 @@ void ProfileWidget2::plotDive(const struct dive *dIn, int dcIn, bool doClearPict
 	}
 
 	const struct divecomputer *currentdc = get_dive_dc_const(d, dc);
-	if (!currentdc || !currentdc->samples) {
+	if (!currentdc || !get_sample_count(currentdc)) {
 		setEmptyState();
 		return;
 	}
@@ -565,12 +568,17 @@ void ProfileWidget2::plotDive(const struct dive *dIn, int dcIn, bool doClearPict
 	 */
 
 	// create_plot_info_new() automatically frees old plot data
+	// The tissue ceilings are only calculated when they are shown. The tooltip always shows the tissue percentages.
+	int columns = prefs.calcalltissues ? PLOT_TISSUE_CEILINGS : 0;
 #ifndef SUBSURFACE_MOBILE
+	columns |= PLOT_TISSUE_PERCENTAGES;
 	// A non-null planner_ds signals to create_plot_info_new that the dive is currently planned.
 	struct deco_state *planner_ds = currentState == PLAN && plannerModel ? &plannerModel->final_deco_state : nullptr;
-	create_plot_info_new(d, get_dive_dc_const(d, dc), &plotInfo, !shouldCalculateMaxDepth, planner_ds);
+	PlotInfoCache::instance()->createPlotInfo(d, dc, &plotInfo, !shouldCalculateMaxDepth, columns, planner_ds);
 #else
-	create_plot_info_new(d, get_dive_dc_const(d, dc), &plotInfo, !shouldCalculateMaxDepth, nullptr);
+	if (prefs.percentagegraph)
+		columns |= PLOT_TISSUE_PERCENTAGES;
+	PlotInfoCache::instance()->createPlotInfo(d, dc, &plotInfo, !shouldCalculateMaxDepth, columns, nullptr);
 #endif
 	int newMaxtime = get_maxtime(&plotInfo);
 	if (shouldCalculateMaxTime || newMaxtime > maxtime)
@@ -1358,7 +1366,7 @@ void ProfileWidget2::contextMenuEvent(QContextMenuEvent *event)
 		changeMode->addAction(gettextFromC::tr(divemode_text_ui[PSCR]),
 				      [this, seconds](){ addDivemodeSwitch(seconds, PSCR); });
 
-	if (same_string(get_dive_dc_const(d, dc)->model, "manually added dive") || !get_dive_dc_const(d, dc)->samples)
+	if (same_string(get_dive_dc_const(d, dc)->model, "manually added dive") || !get_sample_count(get_dive_dc_const(d, dc)))
 		m.addAction(tr("Edit the profile"), this, &ProfileWidget2::editCurrentDive);
 
 	if (DiveEventItem *item = dynamic_cast<DiveEventItem *>(sceneItem)) {
@@ -117,6 +117,7 @@ void DivePlannerPointsModel::loadFromDive(dive *dIn)
 	duration_t lastrecordedtime = {};
 	duration_t newtime = {};
 
+	unpack_dive_samples(d);
 	clear();
 	removeDeco();
 	free_dps(&diveplan);
@@ -246,12 +247,6 @@ void DivePlannerPointsModel::addCylinder_clicked()
 void DivePlannerPointsModel::setPlanMode(Mode m)
 {
 	mode = m;
-	// the planner may reset our GF settings that are used to show deco
-	// reset them to what's in the preferences
-	if (m != PLAN) {
-		set_gf(prefs.gflow, prefs.gfhigh);
-		set_vpmb_conservatism(prefs.vpmb_conservatism);
-	}
 }
 
 bool DivePlannerPointsModel::isPlanner() const
@@ -450,6 +445,8 @@ DivePlannerPointsModel::DivePlannerPointsModel(QObject *parent) : QAbstractTable
 	mode(NOTHING)
 {
 	memset(&diveplan, 0, sizeof(diveplan));
+	memset(&final_deco_state, 0, sizeof(final_deco_state));
+	get_deco_config(&final_deco_state.config, true);
 	startTime.setTimeSpec(Qt::UTC);
 	// use a Qt-connection to send the variations text across thread boundary (in case we
 	// are calculating the variations in a background thread).
@@ -1021,6 +1018,9 @@ void DivePlannerPointsModel::clear()
 
 void DivePlannerPointsModel::createTemporaryPlan()
 {
+	// The previous dives are taken into account, also by the variations calculated in the background
+	load_deco_dive_samples(d);
+
 	// Get the user-input and calculate the dive info
 	free_dps(&diveplan);
 	int lastIndex = -1;
@@ -1076,21 +1076,27 @@ void DivePlannerPointsModel::updateDiveProfile()
 	memset(&plan_deco_state, 0, sizeof(struct deco_state));
 	plan(&plan_deco_state, &diveplan, d, DECOTIMESTEP, stoptable, &cache, isPlanner(), false);
 	updateMaxDepth();
+	// The profile is calculated with the settings of the plan, which are stored in the deco state.
+	final_deco_state = plan_deco_state;
 
 	if (isPlanner() && shouldComputeVariations()) {
 		struct diveplan *plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
-		lock_planner();
 		cloneDiveplan(&diveplan, plan_copy);
-		unlock_planner();
+		// The dive is copied here, because the main thread may modify it while
+		// the variations are calculated.
+		struct dive *dive_copy = alloc_dive();
+		copy_dive(d, dive_copy);
+		// Supersede the variations of previous versions of the plan. Jobs of those
+		// that are still queued or running give up as soon as they notice.
+		int instance = ++instanceCounter;
 #ifdef VARIATIONS_IN_BACKGROUND
 		// Since we're calling computeVariations asynchronously and plan_deco_state is allocated
 		// on the stack, it must be copied and freed by the worker-thread.
 		struct deco_state *plan_deco_state_copy = new deco_state(plan_deco_state);
-		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, plan_deco_state_copy);
+		QtConcurrent::run(this, &DivePlannerPointsModel::computeVariationsFreeDeco, plan_copy, plan_deco_state_copy, dive_copy, instance);
 #else
-		computeVariations(plan_copy, &plan_deco_state);
+		computeVariations(plan_copy, &plan_deco_state, dive_copy, instance);
 #endif
-		final_deco_state = plan_deco_state;
 	}
 	emit calculatedPlanNotes(QString(d->notes));
 
@@ -1173,34 +1179,62 @@ int DivePlannerPointsModel::analyzeVariations(struct decostop *min, struct decos
 	return (leftsum + rightsum) / 2;
 }
 
-void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct deco_state *previous_ds)
+void DivePlannerPointsModel::computeVariationsFreeDeco(struct diveplan *original_plan, struct deco_state *previous_ds, struct dive *dive, int instance)
 {
-	computeVariations(original_plan, previous_ds);
+	computeVariations(original_plan, previous_ds, dive, instance);
 	delete previous_ds;
 }
 
-void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds)
-{
-	// nothing to do unless there's an original plan
-	if (!original_plan)
-		return;
+// The variations of a plan, which are calculated concurrently.
+enum Variation {
+	VARIATION_ORIGINAL,
+	VARIATION_DEEPER,
+	VARIATION_SHALLOWER,
+	VARIATION_LONGER,
+	VARIATION_SHORTER,
+	VARIATION_COUNT
+};
+
+struct VariationsJob {
+	int instance;
+	const std::atomic<int> *instanceCounter;
+	const struct deco_state *previous_ds;
+	struct diveplan plans[VARIATION_COUNT];
+	struct dive *dives[VARIATION_COUNT];
+	struct decostop stops[VARIATION_COUNT][60];
+};
+
+static void computeVariation(int begin, int end, void *data)
+{
+	VariationsJob *job = (VariationsJob *)data;
+	for (int i = begin; i < end; ++i) {
+		// Don't waste time on a plan that has been edited in the meantime
+		if (job->instance != *job->instanceCounter)
+			return;
+		struct deco_state ds = *job->previous_ds;
+		struct deco_state *cache = NULL;
+		plan(&ds, &job->plans[i], job->dives[i], 1, job->stops[i], &cache, true, false);
+		free(cache);
+	}
+}
 
-	struct dive *dive = alloc_dive();
-	copy_dive(d, dive);
-	struct decostop original[60], deeper[60], shallower[60], shorter[60], longer[60];
-	struct deco_state *cache = NULL, *save = NULL;
-	struct diveplan plan_copy;
+// Takes ownership of original_plan and dive. The variations are only reported if
+// instance is still the current instance when they are finished.
+void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, const struct deco_state *previous_ds, struct dive *dive, int instance)
+{
+	VariationsJob job;
 	struct divedatapoint *last_segment;
-	struct deco_state ds = *previous_ds;
-
-	int my_instance = ++instanceCounter;
-	cache_deco_state(&ds, &save);
+	int planned = 0;
 
 	duration_t delta_time = { .seconds = 60 };
 	QString time_units = tr("min");
 	depth_t delta_depth;
 	QString depth_units;
 
+	// nothing to do unless there's an original plan
+	if (!original_plan)
+		goto finish;
+
 	if (prefs.units.length == units::METERS) {
 		delta_depth.mm = 1000; // 1m
 		depth_units = tr("m");
@@ -1209,53 +1243,48 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 		depth_units = tr("ft");
 	}
 
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	if (!last_segment)
-		goto finish;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, 1, original, &cache, true, false);
-	free_dps(&plan_copy);
-	restore_deco_state(save, &ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->depth.mm += delta_depth.mm;
-	last_segment->next->depth.mm += delta_depth.mm;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, 1, deeper, &cache, true, false);
-	free_dps(&plan_copy);
-	restore_deco_state(save, &ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->depth.mm -= delta_depth.mm;
-	last_segment->next->depth.mm -= delta_depth.mm;
-	if (my_instance != instanceCounter)
-		goto finish;
-	plan(&ds, &plan_copy, dive, 1, shallower, &cache, true, false);
-	free_dps(&plan_copy);
-	restore_deco_state(save, &ds, false);
+	job.instance = instance;
+	job.instanceCounter = &instanceCounter;
+	job.previous_ds = previous_ds;
+	for (; planned < VARIATION_COUNT; ++planned) {
+		last_segment = cloneDiveplan(original_plan, &job.plans[planned]);
+		if (!last_segment) {
+			free_dps(&job.plans[planned]);
+			goto finish;
+		}
+		switch (planned) {
+		case VARIATION_DEEPER:
+			last_segment->depth.mm += delta_depth.mm;
+			last_segment->next->depth.mm += delta_depth.mm;
+			break;
+		case VARIATION_SHALLOWER:
+			last_segment->depth.mm -= delta_depth.mm;
+			last_segment->next->depth.mm -= delta_depth.mm;
+			break;
+		case VARIATION_LONGER:
+			last_segment->next->time += delta_time.seconds;
+			break;
+		case VARIATION_SHORTER:
+			last_segment->next->time -= delta_time.seconds;
+			break;
+		default:
+			break;
+		}
+		// Each plan writes its own dive
+		job.dives[planned] = alloc_dive();
+		copy_dive(dive, job.dives[planned]);
+	}
 
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->next->time += delta_time.seconds;
-	if (my_instance != instanceCounter)
+	if (instance != instanceCounter)
 		goto finish;
-	plan(&ds, &plan_copy, dive, 1, longer, &cache, true, false);
-	free_dps(&plan_copy);
-	restore_deco_state(save, &ds, false);
-
-	last_segment = cloneDiveplan(original_plan, &plan_copy);
-	last_segment->next->time -= delta_time.seconds;
-	if (my_instance != instanceCounter)
+	parallel_for_ranges(VARIATION_COUNT, &computeVariation, &job);
+	if (instance != instanceCounter)
 		goto finish;
-	plan(&ds, &plan_copy, dive, 1, shorter, &cache, true, false);
-	free_dps(&plan_copy);
-	restore_deco_state(save, &ds, false);
 
 	char buf[200];
 	sprintf(buf, ", %s: + %d:%02d /%s + %d:%02d /min", qPrintable(tr("Stop times")),
-		FRACTION(analyzeVariations(shallower, original, deeper, qPrintable(depth_units)), 60), qPrintable(depth_units),
-		FRACTION(analyzeVariations(shorter, original, longer, qPrintable(time_units)), 60));
+		FRACTION(analyzeVariations(job.stops[VARIATION_SHALLOWER], job.stops[VARIATION_ORIGINAL], job.stops[VARIATION_DEEPER], qPrintable(depth_units)), 60), qPrintable(depth_units),
+		FRACTION(analyzeVariations(job.stops[VARIATION_SHORTER], job.stops[VARIATION_ORIGINAL], job.stops[VARIATION_LONGER], qPrintable(time_units)), 60));
 
 	// By using a signal, we can transport the variations to the main thread.
 	emit variationsComputed(QString(buf));
@@ -1263,11 +1292,15 @@ void DivePlannerPointsModel::computeVariations(struct diveplan *original_plan, c
 	printf("\n\n");
 #endif
 finish:
-	free_dps(original_plan);
-	free(original_plan);
-	free(save);
-	free(cache);
-	free(dive);
+	for (int i = 0; i < planned; ++i) {
+		free_dps(&job.plans[i]);
+		free_dive(job.dives[i]);
+	}
+	if (original_plan) {
+		free_dps(original_plan);
+		free(original_plan);
+	}
+	free_dive(dive);
 }
 
 void DivePlannerPointsModel::computeVariationsDone(QString variations)
@@ -1292,10 +1325,10 @@ void DivePlannerPointsModel::createPlan(bool replanCopy)
 	if (shouldComputeVariations()) {
 		struct diveplan *plan_copy;
 		plan_copy = (struct diveplan *)malloc(sizeof(struct diveplan));
-		lock_planner();
 		cloneDiveplan(&diveplan, plan_copy);
-		unlock_planner();
-		computeVariations(plan_copy, &ds_after_previous_dives);
+		struct dive *dive_copy = alloc_dive();
+		copy_dive(d, dive_copy);
+		computeVariations(plan_copy, &ds_after_previous_dives, dive_copy, ++instanceCounter);
 	}
 
 	free(cache);
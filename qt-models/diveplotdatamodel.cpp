@@ -28,7 +28,7 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	if ((!index.isValid()) || (index.row() >= pInfo.nr) || pInfo.entry == 0)
 		return QVariant();
 
-	plot_data item = pInfo.entry[index.row()];
+	const plot_data &item = pInfo.entry[index.row()];
 	if (role == Qt::DisplayRole) {
 		switch (index.column()) {
 		case DEPTH:
@@ -75,11 +75,11 @@ QVariant DivePlotDataModel::data(const QModelIndex &index, int role) const
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= TISSUE_1 && index.column() <= TISSUE_16) {
-		return item.ceilings[index.column() - TISSUE_1];
+		return get_plot_tissue_ceiling(&pInfo, index.row(), index.column() - TISSUE_1);
 	}
 
 	if (role == Qt::DisplayRole && index.column() >= PERCENTAGE_1 && index.column() <= PERCENTAGE_16) {
-		return item.percentages[index.column() - PERCENTAGE_1];
+		return get_plot_tissue_percentage(&pInfo, index.row(), index.column() - PERCENTAGE_1);
 	}
 
 	if (role == Qt::BackgroundRole) {
@@ -176,13 +176,7 @@ void DivePlotDataModel::setDive(const plot_info &info)
 {
 	beginResetModel();
 	dcNr = dc_number;
-	free(pInfo.entry);
-	free(pInfo.pressures);
-	pInfo = info;
-	pInfo.entry = (plot_data *)malloc(sizeof(plot_data) * pInfo.nr);
-	memcpy(pInfo.entry, info.entry, sizeof(plot_data) * pInfo.nr);
-	pInfo.pressures = (plot_pressure_data *)malloc(sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
-	memcpy(pInfo.pressures, info.pressures, sizeof(plot_pressure_data) * pInfo.nr_cylinders * pInfo.nr);
+	copy_plot_info(&pInfo, &info);
 	endResetModel();
 }
 
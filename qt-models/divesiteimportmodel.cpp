@@ -64,10 +64,7 @@ QVariant DivesiteImportedModel::data(const QModelIndex &index, int role) const
 		case COUNTRY:
 			return taxonomy_get_country(&ds->taxonomy);
 		case NEAREST: {
-			// 40075000 is circumference of the earth in meters
-			struct dive_site *nearest_ds =
-				get_dive_site_by_gps_proximity(&ds->location,
-				40075000, &dive_site_table);
+			struct dive_site *nearest_ds = nearestSites[index.row() + firstIndex];
 			if (nearest_ds)
 				return nearest_ds->name;
 			else
@@ -75,9 +72,7 @@ QVariant DivesiteImportedModel::data(const QModelIndex &index, int role) const
 		}
 		case DISTANCE: {
 			unsigned int distance = 0;
-			struct dive_site *nearest_ds =
-				get_dive_site_by_gps_proximity(&ds->location,
-				40075000, &dive_site_table);
+			struct dive_site *nearest_ds = nearestSites[index.row() + firstIndex];
 			if (nearest_ds)
 				distance = get_distance(&ds->location,
 					&nearest_ds->location);
@@ -133,10 +128,16 @@ void DivesiteImportedModel::repopulate(struct dive_site_table *sites)
 	firstIndex = 0;
 	lastIndex = importedSitesTable->nr - 1;
 	checkStates.resize(importedSitesTable->nr);
-	for (int row = 0; row < importedSitesTable->nr; row++)
-		if (get_dive_site_by_gps(&importedSitesTable->dive_sites[row]->location, &dive_site_table))
-			checkStates[row] = false;
-		else
-			checkStates[row] = true;
+	nearestSites.resize(importedSitesTable->nr);
+
+	// Look up the existing sites for all imported sites at once
+	struct dive_site_index *siteIndex = create_dive_site_index(&dive_site_table);
+	for (int row = 0; row < importedSitesTable->nr; row++) {
+		const location_t *location = &importedSitesTable->dive_sites[row]->location;
+		checkStates[row] = !dive_site_index_find_gps(siteIndex, location);
+		// 40075000 is circumference of the earth in meters
+		nearestSites[row] = dive_site_index_find_gps_proximity(siteIndex, location, 40075000);
+	}
+	free_dive_site_index(siteIndex);
 	endResetModel();
 }
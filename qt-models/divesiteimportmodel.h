@@ -29,6 +29,7 @@ private:
 	int firstIndex;
 	int lastIndex;
 	std::vector<char> checkStates; // char instead of bool to avoid silly pessimization of std::vector.
+	std::vector<dive_site *> nearestSites; // closest existing site of each imported site
 	struct dive_site_table *importedSitesTable;
 };
 
@@ -15,4 +15,23 @@ void TestDiveSiteDuplication::testReadV2()
 	QCOMPARE(dive_site_table.nr, 2);
 }
 
+void TestDiveSiteDuplication::testSiteIndex()
+{
+	// the spatial index must find the same sites as the linear searches
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QVERIFY(dive_site_table.nr > 0);
+	struct dive_site_index *index = create_dive_site_index(&dive_site_table);
+	for (int i = 0; i < dive_site_table.nr; i++) {
+		location_t loc = dive_site_table.dive_sites[i]->location;
+		QCOMPARE(dive_site_index_find_gps(index, &loc), get_dive_site_by_gps(&loc, &dive_site_table));
+		QCOMPARE(dive_site_index_find_same(index, dive_site_table.dive_sites[i]), get_same_dive_site(dive_site_table.dive_sites[i]));
+		loc.lat.udeg += 1000;
+		for (int distance: { 20, 200, 20000, 40075000 })
+			QCOMPARE(dive_site_index_find_gps_proximity(index, &loc, distance),
+				 get_dive_site_by_gps_proximity(&loc, distance, &dive_site_table));
+	}
+	free_dive_site_index(index);
+}
+
 QTEST_GUILESS_MAIN(TestDiveSiteDuplication)
@@ -8,6 +8,7 @@ class TestDiveSiteDuplication : public QObject {
 	Q_OBJECT
 private slots:
 	void testReadV2();
+	void testSiteIndex();
 };
 
 #endif // TESTDIVESITEDUPLICATION_H
@@ -4,6 +4,7 @@
 
 #include "core/device.h"
 #include "core/dive.h"
+#include "core/divecomputer.h"
 #include "core/divesite.h"
 #include "core/file.h"
 #include "core/qthelper.h"
@@ -21,11 +22,16 @@
 #if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
 #include <QRandomGenerator>
 #endif
+#include <clocale>
+#include <vector>
 
 // provide declarations for two local helper functions in git-access.c
 extern "C" char *get_local_dir(const char *remote, const char *branch);
 extern "C" void delete_remote_branch(git_repository *repo, const char *remote, const char *branch);
 
+// Not in a header, only the tests switch the parallel save off
+extern "C" bool git_parallel_save;
+
 QString email;
 QString gitUrl;
 QString cloudTestRepo;
@@ -218,6 +224,274 @@ void TestGitStorage::testGitStorageLocal()
 	QCOMPARE(readin, written);
 }
 
+void TestGitStorage::testGitStorageLazySamples()
+{
+	// samples that are loaded on demand must be written out just the same
+	git_repository *repo;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QDir testDir("./gittestlazy");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestlazy"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestlazy", false), 0);
+	QCOMPARE(save_dives("./gittestlazy[test]"), 0);
+	QCOMPARE(save_dives("./SampleDivesV3.ssrf"), 0);
+	clear_dive_file_data();
+	prefs.lazy_samples = true;
+	QCOMPARE(parse_file("./gittestlazy[test]", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	prefs.lazy_samples = false;
+
+	// until they are loaded, the summary of the samples stands in for them
+	int i;
+	struct dive *d;
+	for_each_dive (i, d) {
+		struct divecomputer *dc;
+		QVector<int> summary;
+		for_each_dc (d, dc) {
+			duration_t first_time = { 0 };
+			QVERIFY(dc->samples_repo != NULL);
+			summary << get_sample_count(dc) << get_first_sample_time(dc, &first_time) << first_time.seconds << dc_totaltime(dc);
+		}
+		load_dive_samples(d);
+		QVector<int> loaded;
+		for_each_dc (d, dc) {
+			duration_t first_time = { 0 };
+			QVERIFY(dc->samples_repo == NULL);
+			loaded << dc->samples << get_first_sample_time(dc, &first_time) << first_time.seconds << dc_totaltime(dc);
+		}
+		QCOMPARE(summary, loaded);
+	}
+	QCOMPARE(save_dives("./SampleDivesV3lazy.ssrf"), 0);
+	QFile org("./SampleDivesV3.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3lazy.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+}
+
+// Start with the values of the previous sample, as the loader does
+static struct sample *add_test_sample(struct divecomputer *dc, int time)
+{
+	struct sample *s = prepare_sample(dc);
+	if (dc->samples)
+		*s = s[-1];
+	s->time.seconds = time;
+	s->pressure[0].mbar = s->pressure[1].mbar = 0;
+	return s;
+}
+
+static void compare_samples(const struct sample &a, const struct sample &b)
+{
+	QCOMPARE(a.time.seconds, b.time.seconds);
+	QCOMPARE(a.stoptime.seconds, b.stoptime.seconds);
+	QCOMPARE(a.ndl.seconds, b.ndl.seconds);
+	QCOMPARE(a.tts.seconds, b.tts.seconds);
+	QCOMPARE(a.rbt.seconds, b.rbt.seconds);
+	QCOMPARE(a.depth.mm, b.depth.mm);
+	QCOMPARE(a.stopdepth.mm, b.stopdepth.mm);
+	QCOMPARE(a.temperature.mkelvin, b.temperature.mkelvin);
+	for (int i = 0; i < MAX_SENSORS; i++) {
+		QCOMPARE(a.pressure[i].mbar, b.pressure[i].mbar);
+		QCOMPARE(a.sensor[i], b.sensor[i]);
+	}
+	QCOMPARE(a.setpoint.mbar, b.setpoint.mbar);
+	for (int i = 0; i < 3; i++)
+		QCOMPARE(a.o2sensor[i].mbar, b.o2sensor[i].mbar);
+	QCOMPARE(a.bearing.degrees, b.bearing.degrees);
+	QCOMPARE(a.cns, b.cns);
+	QCOMPARE(a.heartbeat, b.heartbeat);
+	QCOMPARE(a.in_deco, b.in_deco);
+}
+
+void TestGitStorage::testGitStorageSamples()
+{
+	// every key of a sample line has to survive saving and loading, whatever the locale
+	git_repository *repo;
+	struct dive *d = alloc_dive();
+	struct divecomputer *dc = &d->dc;
+	struct sample *s;
+
+	d->when = dc->when = 1600000000;
+	dc->model = strdup("Sample test");
+	dc->divemode = CCR;
+	add_empty_cylinder(&d->cylinders)->cylinder_use = DILUENT;
+	add_empty_cylinder(&d->cylinders)->cylinder_use = OXYGEN;
+	add_empty_cylinder(&d->cylinders)->cylinder_use = OC_GAS;
+
+	// The oxygen cylinder is written as "o2pressure", a change
+	// of the other cylinder as "sensor"
+	s = add_test_sample(dc, 10);
+	s->depth.mm = 1234;
+	s->temperature.mkelvin = ZERO_C_IN_MKELVIN + 20500;
+	s->sensor[0] = 0;
+	s->pressure[0].mbar = 200000;
+	s->sensor[1] = 1;
+	s->pressure[1].mbar = 150000;
+	s->setpoint.mbar = 700;
+	s->o2sensor[0].mbar = 690;
+	s->o2sensor[1].mbar = 710;
+	s->o2sensor[2].mbar = 705;
+	s->cns = 5;
+	s->heartbeat = 80;
+	s->bearing.degrees = 123;
+	s->ndl.seconds = 99 * 60 + 5;
+	s->rbt.seconds = 45 * 60;
+	finish_sample(dc);
+
+	s = add_test_sample(dc, 65);
+	s->depth.mm = 30000;
+	s->temperature.mkelvin = ZERO_C_IN_MKELVIN + 12375;
+	s->pressure[0].mbar = 180500;
+	s->pressure[1].mbar = 149870;
+	s->setpoint.mbar = 1300;
+	s->o2sensor[0].mbar = 1290;
+	s->o2sensor[1].mbar = 1310;
+	s->o2sensor[2].mbar = 1305;
+	s->cns = 12;
+	s->heartbeat = 95;
+	s->bearing.degrees = 270;
+	s->ndl.seconds = 0;
+	s->tts.seconds = 12 * 60 + 30;
+	s->stoptime.seconds = 120;
+	s->stopdepth.mm = 6000;
+	s->in_deco = true;
+	s->rbt.seconds = 0;
+	finish_sample(dc);
+
+	s = add_test_sample(dc, 61 * 60 + 1);
+	s->depth.mm = 6000;
+	s->temperature.mkelvin = ZERO_C_IN_MKELVIN - 1250;
+	s->sensor[0] = 2;
+	s->pressure[0].mbar = 190000;
+	s->setpoint.mbar = 0;
+	s->o2sensor[0].mbar = 1;
+	s->cns = 20;
+	s->heartbeat = 100;
+	s->bearing.degrees = 1;
+	s->ndl.seconds = 10 * 60;
+	s->tts.seconds = 0;
+	s->stoptime.seconds = 0;
+	s->stopdepth.mm = 0;
+	s->in_deco = false;
+	finish_sample(dc);
+
+	s = add_test_sample(dc, 62 * 60 + 5);
+	s->depth.mm = 0;
+	s->temperature.mkelvin = ZERO_C_IN_MKELVIN + 21000;
+	finish_sample(dc);
+
+	// What the loader does to the samples is done here, too
+	record_dive_to_table(d, &dive_table);
+	std::vector<sample> expected(dc->sample, dc->sample + dc->samples);
+
+	// If none of these is installed, this only tests the C locale
+	QByteArray oldLocale = setlocale(LC_NUMERIC, nullptr);
+	for (const char *locale: { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8" }) {
+		if (setlocale(LC_NUMERIC, locale))
+			break;
+	}
+	QDir testDir("./gittestsamples");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestsamples"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestsamples", false), 0);
+	git_repository_free(repo);
+	QCOMPARE(save_dives("./gittestsamples[test]"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestsamples[test]", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	setlocale(LC_NUMERIC, oldLocale.constData());
+
+	QCOMPARE(dive_table.nr, 1);
+	d = get_dive(0);
+	load_dive_samples(d);
+	QCOMPARE(d->dc.samples, (int)expected.size());
+	for (size_t i = 0; i < expected.size(); i++) {
+		compare_samples(d->dc.sample[i], expected[i]);
+		if (QTest::currentTestFailed())
+			return;
+	}
+}
+
+void TestGitStorage::testGitStorageIncremental()
+{
+	// saving on top of a loaded repository reuses the unchanged dives and trips
+	git_repository *repo;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QDir testDir("./gittestincr");
+	QCOMPARE(testDir.removeRecursively(), true);
+	QCOMPARE(QDir().mkdir("./gittestincr"), true);
+	QCOMPARE(git_repository_init(&repo, "./gittestincr", false), 0);
+	QCOMPARE(save_dives("./gittestincr[test]"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestincr[test]", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QVERIFY(dive_table.nr > 1);
+	struct dive *d = get_dive(1);
+	free(d->notes);
+	d->notes = strdup("changed after loading");
+	invalidate_dive_cache(d);
+	QCOMPARE(save_dives("./gittestincr[test]"), 0);
+	QCOMPARE(save_dives("./SampleDivesV3incr.ssrf"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file("./gittestincr[test]", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QCOMPARE(save_dives("./SampleDivesV3incr2.ssrf"), 0);
+	QFile org("./SampleDivesV3incr.ssrf");
+	org.open(QFile::ReadOnly);
+	QFile out("./SampleDivesV3incr2.ssrf");
+	out.open(QFile::ReadOnly);
+	QTextStream orgS(&org);
+	QTextStream outS(&out);
+	QString readin = orgS.readAll();
+	QString written = outS.readAll();
+	QCOMPARE(readin, written);
+	QVERIFY(readin.contains("changed after loading"));
+}
+
+static QString branch_tree_id(const char *path)
+{
+	git_repository *repo;
+	git_object *tree;
+	char hex[GIT_OID_HEXSZ + 1] = { 0 };
+
+	if (git_repository_open(&repo, path))
+		return QString();
+	if (!git_revparse_single(&tree, repo, "test^{tree}")) {
+		git_oid_fmt(hex, git_object_id(tree));
+		git_object_free(tree);
+	}
+	git_repository_free(repo);
+	return QString(hex);
+}
+
+void TestGitStorage::testGitStorageParallelSave()
+{
+	// the dives written by the worker threads have to end up in the same tree
+	git_repository *repo;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table,
+			    &dive_site_table, &device_table, &filter_preset_table), 0);
+	for (const char *path: { "./gittestserial", "./gittestparallel" }) {
+		QDir testDir(path);
+		QCOMPARE(testDir.removeRecursively(), true);
+		QCOMPARE(QDir().mkdir(path), true);
+		QCOMPARE(git_repository_init(&repo, path, false), 0);
+		git_repository_free(repo);
+	}
+	git_parallel_save = false;
+	QCOMPARE(save_dives("./gittestserial[test]"), 0);
+	git_parallel_save = true;
+	QCOMPARE(save_dives("./gittestparallel[test]"), 0);
+	QString serial = branch_tree_id("./gittestserial");
+	QVERIFY(!serial.isEmpty());
+	QCOMPARE(branch_tree_id("./gittestparallel"), serial);
+}
+
 void TestGitStorage::testGitStorageCloud()
 {
 	// test writing and reading back from cloud storage
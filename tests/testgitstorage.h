@@ -13,6 +13,10 @@ private slots:
 
 	void testGitStorageLocal_data();
 	void testGitStorageLocal();
+	void testGitStorageLazySamples();
+	void testGitStorageSamples();
+	void testGitStorageIncremental();
+	void testGitStorageParallelSave();
 	void testGitStorageCloud();
 	void testGitStorageCloudOfflineSync();
 	void testGitStorageCloudMerge();
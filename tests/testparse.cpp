@@ -2,17 +2,23 @@
 #include "testparse.h"
 #include "core/device.h"
 #include "core/dive.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/errorhelper.h"
+#include "core/filterpreset.h"
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/import-csv.h"
 #include "core/parse.h"
 #include "core/qthelper.h"
+#include "core/snapshot.h"
 #include "core/subsurface-string.h"
+#include "core/xmlfields.h"
 #include "core/xmlparams.h"
 #include <QTextStream>
 
+extern "C" bool xml_parallel_save;
+
 /* We have to use a macro since QCOMPARE
  * can only be called from a test method
  * invoked by the QTest framework
@@ -269,6 +275,151 @@ void TestParse::testParseMerge()
 		     SUBSURFACE_TEST_DATA "/dives/mergedVyperOstc.xml");
 }
 
+void TestParse::testParseCompactSamples()
+{
+	/*
+	 * check that packing and unpacking the samples doesn't change them
+	 */
+	int i;
+	struct dive *dive;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table,
+			    &device_table, &filter_preset_table), 0);
+	QCOMPARE(save_dives("./testunpacked.ssrf"), 0);
+	for_each_dive(i, dive)
+		pack_dive_samples(dive);
+	QCOMPARE(save_dives("./testpacked.ssrf"), 0);
+	FILE_COMPARE("./testpacked.ssrf",
+		     "./testunpacked.ssrf");
+}
+
+void TestParse::testParseSnapshot()
+{
+	/*
+	 * check that a log read back from its snapshot is identical to the parsed log
+	 */
+	const char *file = SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf";
+	snapshot_cache = true;
+	remove_snapshot(file);
+	QCOMPARE(parse_file(file, &dive_table, &trip_table, &dive_site_table, &device_table, &filter_preset_table), 0);
+	QCOMPARE(save_dives("./testparsed.ssrf"), 0);
+	clear_dive_file_data();
+	QCOMPARE(parse_file(file, &dive_table, &trip_table, &dive_site_table, &device_table, &filter_preset_table), 0);
+	QCOMPARE(save_dives("./testsnapshot.ssrf"), 0);
+	remove_snapshot(file);
+	snapshot_cache = false;
+	FILE_COMPARE("./testsnapshot.ssrf",
+		     "./testparsed.ssrf");
+}
+
+void TestParse::testParseBrokenXml()
+{
+	/*
+	 * a file that breaks off after a number of good dives must not add any of them
+	 */
+	QByteArray xml("<divelog program='subsurface' version='3'>\n<dives>\n");
+	for (int i = 1; i <= 200; i++)
+		xml += QString("<dive number='%1' date='2020-01-01' time='10:00:00' duration='30:00 min'>\n"
+			       "  <divecomputer model='manually added dive'>\n"
+			       "  <sample time='15:00 min' depth='10.0 m' />\n"
+			       "  </divecomputer>\n"
+			       "</dive>\n").arg(i).toUtf8();
+	xml += "</dives>\n<filterpresets>\n<filterpreset name='broken'>\n</filterpreset>\n</filterpresets>\n";
+	xml += "<dive number='201' <broken";
+	QVERIFY(parse_xml_buffer("broken.ssrf", xml.constData(), xml.size(), &dive_table, &trip_table,
+				 &dive_site_table, &device_table, &filter_preset_table, NULL) != 0);
+	QCOMPARE(dive_table.nr, 0);
+	QCOMPARE(trip_table.nr, 0);
+	QCOMPARE(dive_site_table.nr, 0);
+	QCOMPARE(filter_presets_count(), 0);
+}
+
+void TestParse::testDiveIdLookup()
+{
+	/*
+	 * check that dives are found by their id while the dive table changes
+	 */
+	int i;
+	struct dive *dive;
+	QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table, &dive_site_table,
+			    &device_table, &filter_preset_table), 0);
+	process_loaded_dives();
+	QVERIFY(dive_table.nr > 2);
+	for_each_dive(i, dive) {
+		QCOMPARE(get_dive_by_uniq_id(dive->id), dive);
+		QCOMPARE(get_idx_by_uniq_id(dive->id), i);
+	}
+
+	/* removing the first dive shifts all the others */
+	dive = unregister_dive(0);
+	QVERIFY(get_dive_by_uniq_id(dive->id) == NULL);
+	QCOMPARE(get_idx_by_uniq_id(dive->id), dive_table.nr);
+	QCOMPARE(get_idx_by_uniq_id(dive_table.dives[1]->id), 1);
+
+	/* and adding it back, too */
+	insert_dive(&dive_table, dive);
+	QCOMPARE(get_dive_by_uniq_id(dive->id), dive);
+	QCOMPARE(get_idx_by_uniq_id(dive->id), 0);
+	QCOMPARE(get_divenr(dive_table.dives[2]), 2);
+
+	/* copies of dives are found by their id */
+	struct dive copy = *dive_table.dives[2];
+	QCOMPARE(get_divenr(&copy), 2);
+
+	/* changes behind the back of the index are noticed */
+	dive = dive_table.dives[0];
+	dive_table.dives[0] = dive_table.dives[1];
+	dive_table.dives[1] = dive;
+	QCOMPARE(get_idx_by_uniq_id(dive->id), 1);
+	sort_dive_table(&dive_table);
+	QCOMPARE(get_idx_by_uniq_id(dive->id), 0);
+}
+
+void TestParse::testFieldMatch()
+{
+	const struct xml_field_match *match;
+
+	match = xml_match_field(XML_SAMPLE_CONTEXT, "depth.sample");
+	QVERIFY(match != NULL);
+	QCOMPARE(match->nr, 1);
+	QCOMPARE(match->fields[0], (int)XML_SAMPLE_DEPTH);
+
+	/* names without a '.' match any node */
+	match = xml_match_field(XML_SAMPLE_CONTEXT, "heartbeat.sample");
+	QVERIFY(match != NULL);
+	QCOMPARE(match->nr, 1);
+	QCOMPARE(match->fields[0], (int)XML_SAMPLE_HEARTBEAT);
+
+	/* all matching names are returned in the order of the list */
+	match = xml_match_field(XML_DIVE_CONTEXT, "weight.weightsystem");
+	QVERIFY(match != NULL);
+	QCOMPARE(match->nr, 2);
+	QCOMPARE(match->fields[0], (int)XML_DIVE_WS_WEIGHT);
+	QCOMPARE(match->fields[1], (int)XML_DIVE_WEIGHT);
+
+	QVERIFY(xml_match_field(XML_SAMPLE_CONTEXT, "depth") == NULL);
+	QVERIFY(xml_match_field(XML_SAMPLE_CONTEXT, "deptha.sample") == NULL);
+	QVERIFY(xml_match_field(XML_EVENT_CONTEXT, "") == NULL);
+}
+
+void TestParse::testParallelSave()
+{
+	/*
+	 * formatting the dives concurrently has to give the same file as
+	 * formatting them one after another - load enough dives to fill
+	 * more than one batch of the parallel save
+	 */
+	for (int i = 0; i < 10; i++)
+		QCOMPARE(parse_file(SUBSURFACE_TEST_DATA "/dives/SampleDivesV2.ssrf", &dive_table, &trip_table,
+				    &dive_site_table, &device_table, &filter_preset_table), 0);
+	QVERIFY(dive_table.nr > 256);
+	xml_parallel_save = false;
+	QCOMPARE(save_dives("./testserialsave.ssrf"), 0);
+	xml_parallel_save = true;
+	QCOMPARE(save_dives("./testparallelsave.ssrf"), 0);
+	FILE_COMPARE("./testparallelsave.ssrf",
+		     "./testserialsave.ssrf");
+}
+
 int TestParse::parseCSVmanual(int units, std::string file)
 {
 	verbose = 1;
@@ -24,6 +24,12 @@ private slots:
 	void testParseNewFormat();
 	void testParseDLD();
 	void testParseMerge();
+	void testParseCompactSamples();
+	void testParseSnapshot();
+	void testParseBrokenXml();
+	void testDiveIdLookup();
+	void testFieldMatch();
+	void testParallelSave();
 
 	int parseCSVmanual(int, std::string);
 	void exportSubsurfaceCSV();
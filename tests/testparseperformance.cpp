@@ -1,16 +1,26 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testparseperformance.h"
 #include "core/device.h"
+#include "core/dive.h"
+#include "core/divecomputer.h"
+#include "core/divelist.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
+#include "core/filterconstraint.h"
+#include "core/fulltext.h"
 #include "core/git-access.h"
+#include "core/membuffer.h"
+#include "core/parse.h"
+#include "core/snapshot.h"
 #include "core/settings/qPrefProxy.h"
 #include "core/settings/qPrefCloudStorage.h"
 #include <QFile>
 #include <QDebug>
 #include <QNetworkProxy>
 
+extern "C" bool xml_parallel_save;
+
 #define LARGE_TEST_REPO "https://github.com/Subsurface/large-anonymous-sample-data"
 
 void TestParsePerformance::initTestCase()
@@ -63,12 +73,72 @@ void TestParsePerformance::parseSsrf()
 		qDebug() << "clone the repo, uncompress the file and copy it to " SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf";
 		return;
 	}
+
+	// compare the tree walk with the streaming parser
+	xml_stream_parse = false;
+	parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table,
+		   &dive_site_table, &device_table, &filter_preset_table);
+	int treeDives = dive_table.nr;
+	cleanup();
+
+	xml_stream_parse = true;
+	parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table,
+		   &dive_site_table, &device_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, treeDives);
+	cleanup();
+
 	QBENCHMARK {
 		parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table,
 			   &dive_site_table, &device_table, &filter_preset_table);
 	}
 }
 
+void TestParsePerformance::saveSsrf()
+{
+	QFile largeSsrfFile(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf");
+	if (!largeSsrfFile.exists()) {
+		qDebug() << "missing large sample data file - available at " LARGE_TEST_REPO;
+		qDebug() << "clone the repo, uncompress the file and copy it to " SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf";
+		return;
+	}
+	parse_file(SUBSURFACE_TEST_DATA "/dives/large-anon.ssrf", &dive_table, &trip_table,
+		   &dive_site_table, &device_table, &filter_preset_table);
+
+	// both the serial writer and the one that formats the dives in parallel
+	xml_parallel_save = false;
+	QCOMPARE(save_dives("./large-anon-serial.ssrf"), 0);
+	xml_parallel_save = true;
+	QCOMPARE(save_dives("./large-anon-parallel.ssrf"), 0);
+
+	QBENCHMARK {
+		save_dives("./large-anon-parallel.ssrf");
+	}
+}
+
+void TestParsePerformance::saveSamples()
+{
+	// a long dive with values that change in every sample
+	struct dive *d = alloc_dive();
+	struct divecomputer *dc = &d->dc;
+	for (int i = 0; i < 100000; i++) {
+		struct sample *s = prepare_sample(dc);
+		s->time.seconds = i * 2;
+		s->depth.mm = 10000 + i % 30000;
+		s->temperature.mkelvin = ZERO_C_IN_MKELVIN + 20000 + i % 1000;
+		s->pressure[0].mbar = 200000 - i;
+		s->ndl.seconds = i % 600;
+		s->heartbeat = 60 + i % 100;
+		finish_sample(dc);
+	}
+
+	QBENCHMARK {
+		struct membuffer mb = { 0 };
+		save_one_dive_to_mb(&mb, d, false);
+		free_buffer(&mb);
+	}
+	free_dive(d);
+}
+
 void TestParsePerformance::parseGit()
 {
 	// some more necessary setup
@@ -81,10 +151,252 @@ void TestParsePerformance::parseGit()
 
 	cleanup();
 
+	// the serial loader and the one that parses the divecomputers in parallel have to agree
+	git_parallel_load = false;
+	parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
+		   &device_table, &filter_preset_table);
+	int serialDives = dive_table.nr;
+	cleanup();
+
+	git_parallel_load = true;
+	parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
+		   &device_table, &filter_preset_table);
+	QCOMPARE(dive_table.nr, serialDives);
+	cleanup();
+
+	QBENCHMARK {
+		parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
+			   &device_table, &filter_preset_table);
+	}
+}
+
+void TestParsePerformance::parseGitLazy()
+{
+	// the cache was populated by parseGit()
+	prefs.lazy_samples = true;
 	QBENCHMARK {
 		parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
 			   &device_table, &filter_preset_table);
 	}
+	prefs.lazy_samples = false;
+}
+
+void TestParsePerformance::parseGitSnapshot()
+{
+	// the cache was populated by parseGit(). The first load writes the snapshot, the second one reads it
+	snapshot_cache = true;
+	remove_snapshot(LARGE_TEST_REPO "[git]");
+	parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
+		   &device_table, &filter_preset_table);
+	int parsedDives = dive_table.nr;
+	int parsedTrips = trip_table.nr;
+	int parsedSites = dive_site_table.nr;
+	cleanup();
+
+	QBENCHMARK_ONCE {
+		parse_file(LARGE_TEST_REPO "[git]", &dive_table, &trip_table, &dive_site_table,
+			   &device_table, &filter_preset_table);
+	}
+	QCOMPARE(dive_table.nr, parsedDives);
+	QCOMPARE(trip_table.nr, parsedTrips);
+	QCOMPARE(dive_site_table.nr, parsedSites);
+	cleanup();
+	snapshot_cache = false;
+}
+
+void TestParsePerformance::importDives()
+{
+	// importing a large number of unsorted dives into an empty log
+	const int nr = 50000;
+	struct dive_table import_table = empty_dive_table;
+	struct dive_site_table import_sites = empty_dive_site_table;
+	struct device_table *import_devices = alloc_device_table();
+
+	for (int i = 0; i < nr; i++) {
+		struct dive *d = alloc_dive();
+		d->when = (timestamp_t)((i * 7919) % nr) * 86400;
+		d->dc.when = d->when;
+		d->dc.duration.seconds = d->duration.seconds = 3600;
+		add_to_dive_table(&import_table, import_table.nr, d);
+	}
+	// the import takes the dives out of the table, so it can only be run once
+	QBENCHMARK_ONCE {
+		add_imported_dives(&import_table, NULL, &import_sites, import_devices, 0);
+	}
+	QCOMPARE(dive_table.nr, nr);
+	for (int i = 1; i < dive_table.nr; i++)
+		QVERIFY(dive_less_than(dive_table.dives[i - 1], dive_table.dives[i]));
+	free_device_table(import_devices);
+}
+
+// A synthetic log of one dive per day for the search and filter tests. Dive i
+// has the buddy names[i % 8], the divemaster names[i / 8 % 8] and the notes
+// "Dive number <i % 1000>".
+static const int syntheticDives = 50000;
+
+static void createSyntheticLog()
+{
+	const char *names[] = { "Alice", "Bob", "Carol", "Dave", "Eve", "Frank", "Grace", "Heidi" };
+	for (int i = 0; i < syntheticDives; i++) {
+		struct dive *d = alloc_dive();
+		d->when = (timestamp_t)i * 86400;
+		d->buddy = strdup(names[i % 8]);
+		d->divemaster = strdup(names[i / 8 % 8]);
+		d->notes = strdup(qPrintable(QString("Dive number %1").arg(i % 1000)));
+		add_to_dive_table(&dive_table, dive_table.nr, d);
+	}
+}
+
+void TestParsePerformance::fullTextSearch()
+{
+	// searching the synthetic log for two buddies: Alice and Bob
+	const int nr = syntheticDives;
+	int expected = 0;
+	createSyntheticLog();
+	for (int i = 0; i < nr; i++) {
+		if ((i % 8 == 0 && i / 8 % 8 == 1) || (i % 8 == 1 && i / 8 % 8 == 0))
+			++expected;
+	}
+	fulltext_populate();
+
+	FullTextQuery query;
+	query = "alice bob";
+	FullTextResult res = fulltext_find_dives(query, StringFilterMode::SUBSTRING);
+	int matches = 0;
+	for (int i = 0; i < dive_table.nr; i++) {
+		if (res.dive_matches(dive_table.dives[i]))
+			++matches;
+	}
+	QCOMPARE(matches, expected);
+	QBENCHMARK {
+		fulltext_find_dives(query, StringFilterMode::SUBSTRING);
+	}
+}
+
+void TestParsePerformance::substringSearch_data()
+{
+	// substrings of at least three characters go through the trigram index,
+	// shorter ones through a scan of all words
+	QTest::addColumn<QString>("substring");
+	QTest::addColumn<int>("expected");
+
+	auto withName = [](int name1, int name2) {
+		int res = 0;
+		for (int i = 0; i < syntheticDives; i++) {
+			int buddy = i % 8, divemaster = i / 8 % 8;
+			if (buddy == name1 || buddy == name2 || divemaster == name1 || divemaster == name2)
+				++res;
+		}
+		return res;
+	};
+	QTest::newRow("trigrams") << "ice" << withName(0, 0); // "Alice"
+	QTest::newRow("scan") << "ce" << withName(0, 6); // "Alice" and "Grace"
+	QTest::newRow("all dives") << "umb" << syntheticDives; // "number"
+	QTest::newRow("no dive") << "xyz" << 0;
+}
+
+void TestParsePerformance::substringSearch()
+{
+	QFETCH(QString, substring);
+	QFETCH(int, expected);
+	createSyntheticLog();
+	fulltext_populate();
+
+	FullTextQuery query;
+	query = substring;
+	FullTextResult res = fulltext_find_dives(query, StringFilterMode::SUBSTRING);
+	int matches = 0;
+	for (int i = 0; i < dive_table.nr; i++) {
+		// same result as checking the words of every dive
+		const dive *d = dive_table.dives[i];
+		QCOMPARE(res.dive_matches(d), fulltext_dive_matches(d, query, StringFilterMode::SUBSTRING));
+		if (res.dive_matches(d))
+			++matches;
+	}
+	QCOMPARE(matches, expected);
+
+	QBENCHMARK {
+		fulltext_find_dives(query, StringFilterMode::SUBSTRING);
+	}
+}
+
+void TestParsePerformance::filterConstraints_data()
+{
+	// without and with the normalized strings of the fulltext cache
+	QTest::addColumn<bool>("cached");
+	QTest::newRow("uncached") << false;
+	QTest::newRow("cached") << true;
+}
+
+void TestParsePerformance::filterConstraints()
+{
+	// matching a people and a notes constraint against the synthetic log: Eve and "number 99"
+	QFETCH(bool, cached);
+	const int nr = syntheticDives;
+	int expected = 0;
+	createSyntheticLog();
+	for (int i = 0; i < nr; i++) {
+		if ((i % 8 == 4 || i / 8 % 8 == 4) && (i % 1000 == 99 || i % 1000 >= 990))
+			++expected;
+	}
+	if (cached)
+		fulltext_populate();
+
+	filter_constraint people(FILTER_CONSTRAINT_PEOPLE);
+	filter_constraint_set_stringlist(people, "eve");
+	filter_constraint notes(FILTER_CONSTRAINT_NOTES);
+	notes.string_mode = FILTER_CONSTRAINT_SUBSTRING;
+	filter_constraint_set_stringlist(notes, "NUMBER 99");
+	std::vector<compiled_filter_constraint> constraints { people, notes };
+
+	auto count = [&constraints]() {
+		int res = 0;
+		for (int i = 0; i < dive_table.nr; i++) {
+			const dive *d = dive_table.dives[i];
+			if (std::all_of(constraints.begin(), constraints.end(),
+					[d](const compiled_filter_constraint &c) { return filter_constraint_match_dive(c, d); }))
+				++res;
+		}
+		return res;
+	};
+
+	QCOMPARE(count(), expected);
+	QBENCHMARK {
+		count();
+	}
+}
+
+void TestParsePerformance::filterAllDives()
+{
+	// the dive list filter checks the dives on all cores, which must give the same
+	// result as checking them one by one: buddy or divemaster Alice and "number 9"
+	createSyntheticLog();
+	for (int i = 0; i < dive_table.nr; i += 7)
+		dive_table.dives[i]->invalid = true;
+	fulltext_populate();
+
+	FullTextQuery query;
+	query = "alice";
+	FullTextResult ft = fulltext_find_dives(query, StringFilterMode::STARTSWITH);
+	filter_constraint notes(FILTER_CONSTRAINT_NOTES);
+	notes.string_mode = FILTER_CONSTRAINT_SUBSTRING;
+	filter_constraint_set_stringlist(notes, "number 9");
+	std::vector<compiled_filter_constraint> constraints { notes };
+
+	for (bool show_invalid: { false, true }) {
+		std::vector<char> serial(dive_table.nr);
+		for (int i = 0; i < dive_table.nr; i++) {
+			const dive *d = dive_table.dives[i];
+			serial[i] = (show_invalid || !d->invalid) && ft.dive_matches(d) &&
+				    filter_constraint_match_dive(constraints[0], d);
+		}
+		QVERIFY(std::count(serial.begin(), serial.end(), 1) > 0);
+		QVERIFY(filter_constraints_match_dives(constraints, &ft, show_invalid) == serial);
+	}
+
+	QBENCHMARK {
+		filter_constraints_match_dives(constraints, &ft, false);
+	}
 }
 
 QTEST_GUILESS_MAIN(TestParsePerformance)
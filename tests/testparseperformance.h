@@ -12,7 +12,18 @@ private slots:
 	void cleanup();
 
 	void parseSsrf();
+	void saveSsrf();
+	void saveSamples();
 	void parseGit();
+	void parseGitLazy();
+	void parseGitSnapshot();
+	void importDives();
+	void fullTextSearch();
+	void substringSearch_data();
+	void substringSearch();
+	void filterConstraints_data();
+	void filterConstraints();
+	void filterAllDives();
 };
 
 #endif
@@ -4,10 +4,15 @@
 #include "core/dive.h"
 #include "core/event.h"
 #include "core/planner.h"
+#include "core/profile.h"
 #include "core/qthelper.h"
 #include "core/subsurfacestartup.h"
 #include "core/units.h"
 #include <QDebug>
+#include <cmath>
+
+// Not in a header, only the tests switch the cache off
+extern "C" bool deco_factor_cache;
 
 #define DEBUG 1
 
@@ -885,4 +890,256 @@ void TestPlan::testVpmbMetricRepeat()
 	QCOMPARE(finalDiveRunTimeSeconds, firstDiveRunTimeSeconds);
 }
 
+// The settings that the tests below vary
+struct PlanKnobs {
+	void (*setup)(struct diveplan *) = setupPlan;
+	int gflow = 0, gfhigh = 0;	// 0 keeps the gradient factors of setup
+	bool factorCache = true;
+	int extraBottomTime = 0;	// added to the last waypoint of setup
+};
+
+// A plan of a copy of displayed_dive. Setting up the plan changes displayed_dive,
+// so setupTestPlan() must be called on the main thread. calculateTestPlan() only
+// changes the test plan and can be called on any thread.
+struct TestDivePlan {
+	struct diveplan plan;
+	struct dive *dive;
+	struct deco_state ds;
+};
+
+static void setupTestPlan(TestDivePlan &p, const PlanKnobs &knobs)
+{
+	p.plan = {};
+	knobs.setup(&p.plan);
+	if (knobs.gflow)
+		p.plan.gflow = knobs.gflow;
+	if (knobs.gfhigh)
+		p.plan.gfhigh = knobs.gfhigh;
+	struct divedatapoint *last = p.plan.dp;
+	while (last->next)
+		last = last->next;
+	last->time += knobs.extraBottomTime;
+	p.dive = alloc_dive();
+	copy_dive(&displayed_dive, p.dive);
+}
+
+static void calculateTestPlan(TestDivePlan &p)
+{
+	struct deco_state *cache = NULL;
+	struct decostop stops[60];
+	plan(&p.ds, &p.plan, p.dive, 60, stops, &cache, true, false);
+	free(cache);
+}
+
+static void freeTestPlan(TestDivePlan &p)
+{
+	free_dps(&p.plan);
+	free_dive(p.dive);
+}
+
+// Set up and calculate a plan on the main thread
+static void planTestDive(TestDivePlan &p, const PlanKnobs &knobs)
+{
+	setupTestPlan(p, knobs);
+	deco_factor_cache = knobs.factorCache;
+	calculateTestPlan(p);
+	deco_factor_cache = true;
+}
+
+// Plans with different gradient factors, calculated on separate threads
+static void planConcurrently(int begin, int end, void *data)
+{
+	TestDivePlan *plans = (TestDivePlan *)data;
+	for (int i = begin; i < end; ++i)
+		calculateTestPlan(plans[i]);
+}
+
+static void setupConcurrentPlans(TestDivePlan plans[2])
+{
+	PlanKnobs knobs;
+	setupTestPlan(plans[0], knobs);
+	knobs.gflow = 30;
+	knobs.gfhigh = 70;
+	setupTestPlan(plans[1], knobs);
+}
+
+void TestPlan::testConcurrentPlans()
+{
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+
+	TestDivePlan serial[2], concurrent[2];
+	setupConcurrentPlans(serial);
+	planConcurrently(0, 2, serial);
+
+	setupConcurrentPlans(concurrent);
+	parallel_for_ranges(2, &planConcurrently, concurrent);
+
+	// the gradient factors are kept in the deco state and don't interfere
+	QVERIFY(serial[0].dive->dc.duration.seconds < serial[1].dive->dc.duration.seconds);
+	for (int i = 0; i < 2; ++i)
+		QCOMPARE(concurrent[i].dive->dc.duration.seconds, serial[i].dive->dc.duration.seconds);
+
+	for (int i = 0; i < 2; ++i) {
+		freeTestPlan(serial[i]);
+		freeTestPlan(concurrent[i]);
+	}
+}
+
+// The compartment loop of add_segment() as it was before the factors were
+// cached and the loop was vectorized, as reference for testFactorCache().
+// Only for Bühlmann outside the planner, with satmult = desatmult = 1.0, and
+// periods longer than one second, which are tabulated in both versions.
+static const double referenceHeHalflife[] = { 1.88, 3.02, 4.72, 6.99,
+					      10.21, 14.48, 20.53, 29.11,
+					      41.20, 55.19, 70.69, 90.34,
+					      115.29, 147.42, 188.24, 240.03 };
+
+static void referenceAddSegment(struct deco_state *ds, double pressure, struct gasmix gasmix, int period_in_seconds)
+{
+	struct gas_pressures pressures;
+	bool icd = false;
+	fill_pressures(&pressures, pressure - 0.0627, gasmix, 0.0, OC);
+
+	for (int ci = 0; ci < 16; ci++) {
+		double pn2_oversat = pressures.n2 - ds->tissue_n2_sat[ci];
+		double phe_oversat = pressures.he - ds->tissue_he_sat[ci];
+		double n2_f = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / buehlmann_N2_t_halflife[ci]);
+		double he_f = 1.0 - exp(-period_in_seconds * 1.155245301e-02 / referenceHeHalflife[ci]);
+		double n2_satmult = 1.0;
+		double he_satmult = 1.0;
+
+		if (ci == ds->ci_pointing_to_guiding_tissue && pn2_oversat > 0.0 && phe_oversat < 0.0 &&
+		    pn2_oversat * n2_satmult * n2_f + phe_oversat * he_satmult * he_f > 0)
+			icd = true;
+
+		ds->tissue_n2_sat[ci] += n2_satmult * pn2_oversat * n2_f;
+		ds->tissue_he_sat[ci] += he_satmult * phe_oversat * he_f;
+		ds->tissue_inertgas_saturation[ci] = ds->tissue_n2_sat[ci] + ds->tissue_he_sat[ci];
+	}
+	ds->icd_warning = icd;
+}
+
+void TestPlan::testFactorCache()
+{
+	enum deco_mode modes[] = { BUEHLMANN, VPMB };
+
+	for (enum deco_mode mode: modes) {
+		setupPrefsVpmb();
+		prefs.unit_system = METRIC;
+		prefs.units.length = units::METERS;
+		prefs.planner_deco_mode = mode;
+
+		PlanKnobs knobs;
+		knobs.setup = setupPlanSeveralGases;
+		TestDivePlan cachedPlan, uncachedPlan;
+		planTestDive(cachedPlan, knobs);
+		knobs.factorCache = false;
+		planTestDive(uncachedPlan, knobs);
+		const struct deco_state &cached = cachedPlan.ds;
+		const struct deco_state &uncached = uncachedPlan.ds;
+
+		// the cached factors must give bit-identical tissue loadings
+		QCOMPARE(cachedPlan.dive->dc.duration.seconds, uncachedPlan.dive->dc.duration.seconds);
+		QVERIFY(memcmp(cached.tissue_n2_sat, uncached.tissue_n2_sat, sizeof(cached.tissue_n2_sat)) == 0);
+		QVERIFY(memcmp(cached.tissue_he_sat, uncached.tissue_he_sat, sizeof(cached.tissue_he_sat)) == 0);
+		QVERIFY(memcmp(cached.tolerated_by_tissue, uncached.tolerated_by_tissue, sizeof(cached.tolerated_by_tissue)) == 0);
+		QCOMPARE(cached.ci_pointing_to_guiding_tissue, uncached.ci_pointing_to_guiding_tissue);
+
+		freeTestPlan(cachedPlan);
+		freeTestPlan(uncachedPlan);
+	}
+
+	// every step must be bit-identical to the scalar loop, also when the periods
+	// are cached or share a slot of the cache and when the leading tissue is in ICD
+	struct deco_config config;
+	struct deco_state ds;
+	init_deco_config(&config, BUEHLMANN, 40, 85, 0);
+	clear_deco(&ds, 1.013, &config, false);
+	const struct gasmix gases[] = { {{210}, {0}}, {{180}, {450}}, {{500}, {0}}, {{1000}, {0}} };
+	const int periods[] = { 2, 10, 60, 60, 90, 60 + DECO_FACTOR_CACHE_SIZE, 600, 60, 3600 };
+	for (int i = 0; i < 200; i++) {
+		double pressure = 1.013 + (i % 50) * 0.1;
+		struct gasmix gasmix = gases[i / 10 % 4];
+		int period = periods[i % 9];
+		ds.ci_pointing_to_guiding_tissue = i % 16;
+		struct deco_state reference = ds;
+		referenceAddSegment(&reference, pressure, gasmix, period);
+		add_segment(&ds, pressure, gasmix, period, 0, OC, 0, false);
+		QVERIFY(memcmp(ds.tissue_n2_sat, reference.tissue_n2_sat, sizeof(ds.tissue_n2_sat)) == 0);
+		QVERIFY(memcmp(ds.tissue_he_sat, reference.tissue_he_sat, sizeof(ds.tissue_he_sat)) == 0);
+		QVERIFY(memcmp(ds.tissue_inertgas_saturation, reference.tissue_inertgas_saturation,
+			       sizeof(ds.tissue_inertgas_saturation)) == 0);
+		QCOMPARE(ds.icd_warning, reference.icd_warning);
+	}
+}
+
+static bool sameDecoInformation(const struct plot_info &pa, const struct plot_info &pb, int idx)
+{
+	const struct plot_data &a = pa.entry[idx];
+	const struct plot_data &b = pb.entry[idx];
+	for (int i = 0; i < 16; ++i) {
+		if (get_plot_tissue_ceiling(&pa, idx, i) != get_plot_tissue_ceiling(&pb, idx, i) ||
+		    get_plot_tissue_percentage(&pa, idx, i) != get_plot_tissue_percentage(&pb, idx, i))
+			return false;
+	}
+	return a.ceiling == b.ceiling &&
+	       a.in_deco_calc == b.in_deco_calc &&
+	       a.ndl_calc == b.ndl_calc &&
+	       a.tts_calc == b.tts_calc &&
+	       a.stoptime_calc == b.stoptime_calc &&
+	       a.stopdepth_calc == b.stopdepth_calc &&
+	       a.gfline == b.gfline &&
+	       a.surface_gf == b.surface_gf &&
+	       a.current_gf == b.current_gf;
+}
+
+void TestPlan::testIncrementalProfile()
+{
+	setupPrefs();
+	prefs.unit_system = METRIC;
+	prefs.units.length = units::METERS;
+	prefs.planner_deco_mode = BUEHLMANN;
+	prefs.calcndltts = true;
+
+	const int columns = PLOT_TISSUE_CEILINGS | PLOT_TISSUE_PERCENTAGES;
+	PlanKnobs knobs;
+	TestDivePlan shortPlan, longPlan;
+	struct dive *copy = alloc_dive();
+	struct plot_info incremental, full;
+	init_plot_info(&incremental);
+	init_plot_info(&full);
+
+	planTestDive(shortPlan, knobs);
+	create_plot_info_new(shortPlan.dive, &shortPlan.dive->dc, &incremental, false, columns, &shortPlan.ds);
+	QCOMPARE(get_deco_resume_entry(&incremental), 1);
+
+	// Only the end of the profile changes, so the deco information of the
+	// start is reused. It must be the same as when calculated from scratch.
+	knobs.extraBottomTime = 5 * 60;
+	planTestDive(longPlan, knobs);
+	copy_dive(longPlan.dive, copy);
+	create_plot_info_new(longPlan.dive, &longPlan.dive->dc, &incremental, false, columns, &longPlan.ds);
+	create_plot_info_new(copy, &copy->dc, &full, false, columns, &longPlan.ds);
+
+	QVERIFY(get_deco_resume_entry(&incremental) > 1);
+	QCOMPARE(get_deco_resume_entry(&full), 1);
+	QCOMPARE(incremental.nr, full.nr);
+	for (int i = 0; i < full.nr; ++i)
+		QVERIFY(sameDecoInformation(incremental, full, i));
+
+	// The checkpoints of a different dive must not be used
+	copy->id = longPlan.dive->id + 1;
+	create_plot_info_new(copy, &copy->dc, &incremental, false, columns, &longPlan.ds);
+	QCOMPARE(get_deco_resume_entry(&incremental), 1);
+
+	free_plot_info_data(&incremental);
+	free_plot_info_data(&full);
+	freeTestPlan(shortPlan);
+	freeTestPlan(longPlan);
+	free_dive(copy);
+}
+
 QTEST_GUILESS_MAIN(TestPlan)
@@ -19,6 +19,9 @@ private slots:
 	void testVpmbMetric100m10min();
 	void testVpmbMetricRepeat();
 	void testMultipleGases();
+	void testConcurrentPlans();
+	void testFactorCache();
+	void testIncrementalProfile();
 };
 
 #endif // TESTPLAN_H
@@ -1,11 +1,15 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testprofile.h"
 #include "core/device.h"
+#include "core/dive.h"
 #include "core/divesite.h"
 #include "core/trip.h"
 #include "core/file.h"
 #include "core/save-profiledata.h"
 #include "core/pref.h"
+#include "core/plotinfocache.h"
+#include "core/profile.h"
+#include "core/subsurface-qt/divelistnotifier.h"
 
 // This test compares the content of struct profile against a known reference version for a list
 // of dives to prevent accidental regressions. Thus is you change anything in the profile this
@@ -64,4 +68,37 @@ void TestProfile::testProfileExportVPMB()
 
 }
 
+void TestProfile::testPlotInfoCache()
+{
+	/*
+	 * edits of fields that are not part of the profile must keep the cached plot infos
+	 */
+	PlotInfoCache *cache = PlotInfoCache::instance();
+	struct plot_info pi;
+	QVector<dive *> dives;
+
+	parse_file(SUBSURFACE_TEST_DATA "/dives/abitofeverything.ssrf", &dive_table, &trip_table, &dive_site_table, &device_table, &filter_preset_table);
+	QVERIFY(dive_table.nr > 0);
+	dives.push_back(get_dive(0));
+	init_plot_info(&pi);
+	cache->clear();
+	cache->createPlotInfo(dives[0], 0, &pi, false, 0, nullptr);
+	free_plot_info_data(&pi);
+	QCOMPARE(cache->size(), 1);
+
+	emit diveListNotifier.divesChanged(dives, DiveField(DiveField::NOTES | DiveField::BUDDY));
+	QCOMPARE(cache->size(), 1);
+
+	emit diveListNotifier.divesChanged(dives, DiveField(DiveField::DEPTH));
+	QCOMPARE(cache->size(), 0);
+
+	// A change of both kinds of fields affects the profile
+	init_plot_info(&pi);
+	cache->createPlotInfo(dives[0], 0, &pi, false, 0, nullptr);
+	free_plot_info_data(&pi);
+	QCOMPARE(cache->size(), 1);
+	emit diveListNotifier.divesChanged(dives, DiveField(DiveField::NOTES | DiveField::WATER_TEMP));
+	QCOMPARE(cache->size(), 0);
+}
+
 QTEST_GUILESS_MAIN(TestProfile)
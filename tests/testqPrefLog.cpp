@@ -28,12 +28,16 @@ void TestQPrefLog::test_struct_get()
 	prefs.use_default_file = true;
 	prefs.show_average_depth = true;
 	prefs.extraEnvironmentalDefault = true;
+	prefs.lazy_samples = true;
+	prefs.compact_samples = true;
 
 	QCOMPARE(tst->default_filename(), QString(prefs.default_filename));
 	QCOMPARE(tst->default_file_behavior(), prefs.default_file_behavior);
 	QCOMPARE(tst->use_default_file(), prefs.use_default_file);
 	QCOMPARE(tst->show_average_depth(), prefs.show_average_depth);
 	QCOMPARE(tst->extraEnvironmentalDefault(), prefs.extraEnvironmentalDefault);
+	QCOMPARE(tst->lazy_samples(), prefs.lazy_samples);
+	QCOMPARE(tst->compact_samples(), prefs.compact_samples);
 }
 
 void TestQPrefLog::test_set_struct()
@@ -47,12 +51,16 @@ void TestQPrefLog::test_set_struct()
 	tst->set_use_default_file(false);
 	tst->set_show_average_depth(false);
 	tst->set_extraEnvironmentalDefault(false);
+	tst->set_lazy_samples(false);
+	tst->set_compact_samples(false);
 
 	QCOMPARE(QString(prefs.default_filename), QString("new base22"));
 	QCOMPARE(prefs.default_file_behavior, LOCAL_DEFAULT_FILE);
 	QCOMPARE(prefs.use_default_file, false);
 	QCOMPARE(prefs.show_average_depth, false);
 	QCOMPARE(prefs.extraEnvironmentalDefault, false);
+	QCOMPARE(prefs.lazy_samples, false);
+	QCOMPARE(prefs.compact_samples, false);
 }
 
 void TestQPrefLog::test_set_load_struct()
@@ -66,12 +74,16 @@ void TestQPrefLog::test_set_load_struct()
 	tst->set_use_default_file(true);
 	tst->set_show_average_depth(true);
 	tst->set_extraEnvironmentalDefault(true);
+	tst->set_lazy_samples(true);
+	tst->set_compact_samples(true);
 
 	prefs.default_filename = copy_qstring("error");
 	prefs.default_file_behavior = UNDEFINED_DEFAULT_FILE;
 	prefs.use_default_file = false;
 	prefs.show_average_depth = false;
 	prefs.extraEnvironmentalDefault = false;
+	prefs.lazy_samples = false;
+	prefs.compact_samples = false;
 
 	tst->load();
 	QCOMPARE(QString(prefs.default_filename), QString("new base32"));
@@ -79,6 +91,8 @@ void TestQPrefLog::test_set_load_struct()
 	QCOMPARE(prefs.use_default_file, true);
 	QCOMPARE(prefs.show_average_depth, true);
 	QCOMPARE(prefs.extraEnvironmentalDefault, true);
+	QCOMPARE(prefs.lazy_samples, true);
+	QCOMPARE(prefs.compact_samples, true);
 }
 
 void TestQPrefLog::test_struct_disk()
@@ -92,6 +106,8 @@ void TestQPrefLog::test_struct_disk()
 	prefs.use_default_file = true;
 	prefs.show_average_depth = true;
 	prefs.extraEnvironmentalDefault = true;
+	prefs.lazy_samples = true;
+	prefs.compact_samples = true;
 
 	tst->sync();
 	prefs.default_filename = copy_qstring("error");
@@ -99,6 +115,8 @@ void TestQPrefLog::test_struct_disk()
 	prefs.use_default_file = false;
 	prefs.show_average_depth = false;
 	prefs.extraEnvironmentalDefault = false;
+	prefs.lazy_samples = false;
+	prefs.compact_samples = false;
 
 	tst->load();
 	QCOMPARE(QString(prefs.default_filename), QString("base42"));
@@ -106,6 +124,8 @@ void TestQPrefLog::test_struct_disk()
 	QCOMPARE(prefs.use_default_file, true);
 	QCOMPARE(prefs.show_average_depth, true);
 	QCOMPARE(prefs.extraEnvironmentalDefault, true);
+	QCOMPARE(prefs.lazy_samples, true);
+	QCOMPARE(prefs.compact_samples, true);
 }
 
 void TestQPrefLog::test_multiple()
@@ -174,6 +194,8 @@ void TestQPrefLog::test_signals()
 	prefs.show_average_depth = false;
 	qPrefLog::set_show_average_depth(true);
 	prefs.extraEnvironmentalDefault = true;
+	prefs.lazy_samples = true;
+	prefs.compact_samples = true;
 	qPrefLog::set_extraEnvironmentalDefault(false);
 
 	QCOMPARE(spy1.count(), 1);
@@ -1,8 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0
 #include "testunitconversion.h"
 #include "core/dive.h"
+#include "core/membuffer.h"
 #include "core/subsurface-string.h"
 
+#include <climits>
+
 void TestUnitConversion::testUnitConversions()
 {
 	QCOMPARE(IS_FP_SAME(grams_to_lbs(1000), 2.204586), true);
@@ -24,4 +27,49 @@ void TestUnitConversion::testUnitConversions()
 	QCOMPARE(mbar_to_PSI(1013), (int)15);
 }
 
+static QString formatted(struct membuffer *b)
+{
+	QString res(mb_cstring(b));
+	b->len = 0;
+	return res;
+}
+
+void TestUnitConversion::testFormatters()
+{
+	struct membuffer b = { 0 };
+
+	// the number formatters have to give the same as the printf() formats they replace
+	const int values[] = { 0, 1, -1, 9, 10, 59, 60, 61, 999, 1000, 1001, 1010, 1100, -1500, 3599, 3600, 123456, -123456, INT_MAX, INT_MIN };
+	for (int v: values) {
+		put_int(&b, v);
+		QCOMPARE(formatted(&b), QString::asprintf("%d", v));
+		put_uint(&b, v);
+		QCOMPARE(formatted(&b), QString::asprintf("%u", (unsigned)v));
+		put_padded_uint(&b, v, 3, ' ');
+		QCOMPARE(formatted(&b), QString::asprintf("%3u", (unsigned)v));
+		put_padded_uint(&b, v, 2, '0');
+		QCOMPARE(formatted(&b), QString::asprintf("%02u", (unsigned)v));
+		put_min_sec(&b, "<", v, ">");
+		QCOMPARE(formatted(&b), QString::asprintf("<%u:%02u>", (unsigned)v / 60, (unsigned)v % 60));
+	}
+
+	put_milli(&b, "", 0, "");
+	QCOMPARE(formatted(&b), QString("0.0"));
+	put_milli(&b, "depth='", 12000, " m'");
+	QCOMPARE(formatted(&b), QString("depth='12.0 m'"));
+	put_milli(&b, "", 1010, "");
+	QCOMPARE(formatted(&b), QString("1.01"));
+	put_milli(&b, "", 1001, "");
+	QCOMPARE(formatted(&b), QString("1.001"));
+	put_milli(&b, "", -1500, "");
+	QCOMPARE(formatted(&b), QString("-1.5"));
+	put_milli(&b, "", -1, "");
+	QCOMPARE(formatted(&b), QString("-0.001"));
+	put_degrees(&b, degrees_t{ 47123456 }, "", "");
+	QCOMPARE(formatted(&b), QString("47.123456"));
+	put_degrees(&b, degrees_t{ -1000 }, "", "");
+	QCOMPARE(formatted(&b), QString("-0.001000"));
+	free_buffer(&b);
+}
+
 QTEST_GUILESS_MAIN(TestUnitConversion)
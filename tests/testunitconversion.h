@@ -8,6 +8,7 @@ class TestUnitConversion : public QObject {
 	Q_OBJECT
 private slots:
 	void testUnitConversions();
+	void testFormatters();
 };
 
 #endif